@@ -7,6 +7,7 @@
 
 #include "ssl_ext/attestation_ext_structs.hpp"
 #include "ssl_ext/evidence_ext_structs.hpp"
+#include "ssl_ext/handshake_arena.hpp"
 
 namespace seats{
 
@@ -15,9 +16,13 @@ public:
     attester();
 	virtual ~attester();
     virtual void set_cred_kind(CredentialKind cred_kind);
-	virtual void set_data(uint8_t* data) = 0;
+    // Evidence buffers are allocated from a, valid until the handshake is done
+	virtual int set_data(const uint8_t* data, size_t len, arena* a) = 0;
+    // Signs the request of set_data, only needed before evidence is sent.
+    // Resumed handshakes send none and skip it.
+    virtual int sign_request() = 0;
 	virtual int attest() = 0;
-	AttestationExtension* getResult();  
+	void getResult(AttestationExtension* ax);  
     virtual int configure_ssl_ctx(SSL_CTX* ctx) = 0;
 protected:
     EvidencePayload* evidence_payload; 
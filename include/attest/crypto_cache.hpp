@@ -0,0 +1,32 @@
+#ifndef __CRYPTO_CACHE_H__
+#define __CRYPTO_CACHE_H__
+
+#include <openssl/evp.h>
+
+// Signing keys with a ready context, per thread
+#define SEATS_CRYPTO_CTX_SLOTS 4
+
+namespace seats{
+
+// OpenSSL objects that are expensive to set up per call. Algorithms are
+// fetched once for the process, contexts are owned by the calling thread
+// and must not be freed or shared by the caller.
+class crypto_cache{
+public:
+    static EVP_MD* sha256();
+
+    // Digest context, reinitialize it with EVP_DigestInit_ex2 before use
+    static EVP_MD_CTX* md_ctx();
+    // RSA PKCS#1 v1.5 over SHA-256 context already initialized for pkey,
+    // meant for the long lived local signing key. The context holds a
+    // reference on pkey until it is evicted.
+    static EVP_PKEY_CTX* sign_ctx(EVP_PKEY* pkey);
+    // Same for verifying, but a new context every call for the caller to
+    // free. Peer keys live for one handshake, a cached context would never
+    // be hit again.
+    static EVP_PKEY_CTX* new_verify_ctx(EVP_PKEY* pkey);
+};
+
+}
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef __EVIDENCE_CORPUS_HPP__
+#define __EVIDENCE_CORPUS_HPP__
+
+#include "ssl_ext/cbor.hpp"
+#include "ssl_ext/evidence_ext_structs.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <openssl/evp.h>
+#include <span>
+#include <vector>
+
+// Clients append every verified handshake to this file when it is set
+#define SEATS_EVIDENCE_CAPTURE_ENV "SEATS_EVIDENCE_CAPTURE"
+#define SEATS_CORPUS_VERSION 1
+
+namespace seats{
+
+// One captured handshake as the client saw it:
+// [SEATS_CORPUS_VERSION, bstr evidence request, bstr attestation extension,
+//  bstr server public key (DER SubjectPublicKeyInfo), int verify result].
+// A corpus file is a CBOR sequence of records, appending never rewrites
+// what is already there. Spans point into the loaded file.
+struct evidence_record{
+    std::span<const unsigned char> erq;
+    std::span<const unsigned char> extension;
+    std::span<const unsigned char> pubkey;
+    int64_t result;
+};
+
+class evidence_recorder{
+public:
+    explicit evidence_recorder(const char* path);
+    ~evidence_recorder();
+
+    bool is_open();
+    // result is what the verifier returned for the handshake
+    int append(const EvidenceRequestClient* erq, std::span<const unsigned char> extension,
+               EVP_PKEY* pkey, int result);
+
+    // Recorder of SEATS_EVIDENCE_CAPTURE, NULL if the variable is not set
+    static evidence_recorder* from_env();
+
+private:
+    std::mutex lock;
+    FILE* fp;
+};
+
+// Reads a whole corpus into data, records point into it. Loading stops at
+// the first incomplete record (writer killed while appending). Returns 1 if
+// the file can not be read.
+int load_evidence_corpus(const char* path, std::vector<unsigned char>* data,
+                         std::vector<evidence_record>* records);
+
+}
+
+namespace seats::cbor{
+
+template<> struct codec<seats::evidence_record>{
+    static size_t size(const seats::evidence_record& m);
+    static void write(writer& w, const seats::evidence_record& m);
+    static bool read(reader& r, seats::evidence_record& m);
+};
+
+}
+
+#endif // !__EVIDENCE_CORPUS_HPP__
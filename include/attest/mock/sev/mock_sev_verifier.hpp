@@ -9,10 +9,10 @@ namespace seats{
 class mock_sev_verifier: public sev_verifier{
 public:
     mock_sev_verifier();
-	void set_data(uint8_t* data) override;
-	int verify(EVP_PKEY* pkey) override;
 protected:
-    int result;
+    int verify_certs(SevEvidencePayload* sep) override;
+    int verify_report(SevEvidencePayload* sep, EvidenceRequestClient* erq, EVP_PKEY* pkey) override;
+
     CredentialKind cred_kind;
 };
 
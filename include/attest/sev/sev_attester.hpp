@@ -5,6 +5,7 @@
 #include "ssl_ext/attestation_ext_structs.hpp"
 #include <cstdint>
 #include <openssl/crypto.h>
+#include <openssl/evp.h>
 
 namespace seats{
 
@@ -13,18 +14,21 @@ public:
 	sev_attester();
 	~sev_attester() = default;
     int configure_ssl_ctx(SSL_CTX* ctx) override;
-    void set_data(uint8_t *data) override; 
+    int set_data(const uint8_t *data, size_t len, arena* a) override; 
+    int sign_request() override;
 protected: 
     static void generate_and_save_cert();
-    EvidenceRequestClient* erq;
+    // Sends the cert hash instead of the blob if the client has it cached
+    void set_cert_reference();
+    EvidenceRequestClient erq;
+    // Serialized request of set_data and the arena it is copied to
+    const unsigned char* req;
+    size_t req_len;
+    arena* req_arena;
 
     // KEY ATTESTATION TOKEN
-    char* kat;
-    uint katlen;
-
-    // SIGNATURE
-    char* sig;
-    size_t siglen;
+    unsigned char kat[EVP_MAX_MD_SIZE];
+    unsigned int katlen;
 private:
     static EVP_PKEY* pkey;
 };
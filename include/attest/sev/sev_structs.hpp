@@ -3,27 +3,49 @@
 
 #include "attest/sev/tool_attest/sev_tool_attest_utils.hpp"
 #include "ssl_ext/attestation_ext_structs.hpp"
+#include "ssl_ext/cached_info.hpp"
 #include "ssl_ext/evidence_ext_structs.hpp"
+#include "ssl_ext/handshake_arena.hpp"
 
 #include <cstdint>
 #include <openssl/crypto.h>
 
-int get_sha256_digest(char* m, size_t mlen, char** dig, unsigned int* diglen);
-int digest_and_sign(EVP_PKEY* pkey, char* m, size_t mlen, char** sig, size_t* siglen); 
-int verify_signature(EVP_PKEY* pkey, char* sig, size_t siglen, char* orig, size_t origlen);
+// dig has to hold EVP_MAX_MD_SIZE bytes
+int get_sha256_digest(const char* m, size_t mlen, unsigned char* dig, unsigned int* diglen);
+// sig is allocated from the handshake arena
+int digest_and_sign(EVP_PKEY* pkey, const char* m, size_t mlen, char** sig, size_t* siglen, seats::arena* a); 
+int verify_signature(EVP_PKEY* pkey, const char* sig, size_t siglen, const unsigned char* orig, size_t origlen);
 
+// [bstr attestation report, bstr AMD cert blob / [bstr cert hash], bstr signature]
+// The report keeps the little endian layout defined by the SNP firmware.
+// The cert blob is replaced by its hash when the client has it cached.
 struct SevEvidencePayload: EvidencePayload{
-    int serialize(const unsigned char**) override;
-    int deserialize(const unsigned char*) override;
+    size_t serialized_size() const override;
+    int serialize(unsigned char* buff, size_t bufflen) const override;
+    // amd_cert_data and sig point into the parsed buffer afterwards
+    int deserialize(std::span<const unsigned char> in) override;
 
     attestation_report_t attestation_report;
     uint64_t amd_cert_data_len;
     char* amd_cert_data;
+    bool amd_cert_cached = false;
+    cert_hash amd_cert_hash;
     size_t siglen;
     char* sig;
     EVP_PKEY* pkey;
 };
 
+namespace seats::cbor{
+
+template<> struct codec<SevEvidencePayload>{
+    static constexpr size_t fixed_size = head_size(3) + bstr_size(sizeof(attestation_report_t));
+    static size_t size(const SevEvidencePayload& m);
+    static void write(writer& w, const SevEvidencePayload& m);
+    static bool read(reader& r, SevEvidencePayload& m);
+};
+
+}
+
 bool verify_kat(EVP_PKEY* pkey, SevEvidencePayload* sep, EvidenceRequestClient* erq);
 
 #endif
@@ -9,11 +9,20 @@ namespace seats{
 class sev_verifier: public verifier{
 public:
 	sev_verifier();
-	~sev_verifier();
-    void set_data(uint8_t *data) override;
+	~sev_verifier() = default;
+    int set_data(const uint8_t *data, size_t len) override;
+    int verify(EVP_PKEY* pkey) override;
+    std::vector<int> verify_batch(std::span<evidence> batch, verify_batch_cb cb = nullptr) override;
 
 protected:
-    SevEvidencePayload* sep;
+    // AMD cert chain checks, done once for every report carrying the same blob
+    virtual int verify_certs(SevEvidencePayload* sep) = 0;
+    // Per report checks, called from the work pool threads during verify_batch
+    virtual int verify_report(SevEvidencePayload* sep, EvidenceRequestClient* erq, EVP_PKEY* pkey) = 0;
+
+    SevEvidencePayload sep;
+    // Cached cert blob sep points into
+    cert_blob blob;
 };
 
 }
@@ -9,12 +9,12 @@ namespace seats{
 class sev_tool_verifier:public sev_verifier{
 public:
     sev_tool_verifier();
-	void set_data(uint8_t* data) override;
-	int verify(EVP_PKEY* pkey) override;
     
 
 protected:
-    int result;
+    int verify_certs(SevEvidencePayload* sep) override;
+    int verify_report(SevEvidencePayload* sep, EvidenceRequestClient* erq, EVP_PKEY* pkey) override;
+
     CredentialKind cred_kind;
 };
 
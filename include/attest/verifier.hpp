@@ -4,22 +4,47 @@
 #include "ssl_ext/evidence_ext_structs.hpp"
 
 #include <cstdint>
+#include <functional>
+#include <memory>
 #include <openssl/crypto.h>
+#include <span>
+#include <vector>
 
 namespace seats{
 
+// One report for verify_batch, same inputs as set_erq + set_data + verify.
+struct evidence{
+    const uint8_t* data;
+    size_t len;
+    EvidenceRequestClient* erq;
+    EVP_PKEY* pkey;
+};
+
+// Result of verify_batch for evidence that could not be parsed.
+#define VERIFY_MALFORMED_EVIDENCE -1
+
+// Called on the caller thread for every report, in batch order.
+typedef std::function<void(size_t idx, int result)> verify_batch_cb;
+
 class verifier{
 public:
     verifier() = default;
 	virtual ~verifier() = default;
     virtual void set_erq(EvidenceRequestClient* erq);
-	virtual void set_data(uint8_t* data) = 0;
+    // AMD cert blobs of the endpoint being verified, cached references are
+    // resolved from it and verified blobs added. Without one every blob
+    // has to be sent in full.
+    void set_cert_cache(std::shared_ptr<cert_cache> certs);
+    // Parses the evidence payload, data has to outlive the verification
+	virtual int set_data(const uint8_t* data, size_t len) = 0;
 	virtual int verify(EVP_PKEY*) = 0;
-	int getResult();	
+    virtual std::vector<int> verify_batch(std::span<evidence> batch, verify_batch_cb cb = nullptr);
+	int getResult();
 
 protected:
     int result;
     EvidenceRequestClient* erq;
+    std::shared_ptr<cert_cache> certs;
 };
 
 }
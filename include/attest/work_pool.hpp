@@ -0,0 +1,67 @@
+#ifndef __WORK_POOL_H__
+#define __WORK_POOL_H__
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace seats{
+
+// Fixed size thread pool running indexed jobs. Every worker gets a
+// contiguous slice of the indices of a job and, once it runs dry, steals
+// from the back of the other workers queues. Jobs of concurrent callers
+// share the workers, each one completes on its own.
+class work_pool{
+public:
+    struct job{
+        std::function<void(size_t)> fn;
+        size_t pending;
+    };
+
+    explicit work_pool(unsigned nthreads = 0);
+    ~work_pool();
+
+    // Runs fn(i) for every i in [0, n) on the workers, returns immediately.
+    // Called from one of the workers the job runs inline instead, so a task
+    // can submit to its own pool without waiting on itself.
+    std::shared_ptr<job> submit(size_t n, std::function<void(size_t)> fn);
+    // Waits for one job, or for every job submitted so far
+    void wait(const std::shared_ptr<job>& j);
+    void wait();
+    unsigned size();
+
+    static work_pool& shared();
+
+private:
+    struct task{
+        std::shared_ptr<job> owner;
+        size_t index;
+    };
+
+    struct worker_queue{
+        std::mutex lock;
+        std::deque<task> tasks;
+    };
+
+    void worker_loop(unsigned id);
+    bool pop_or_steal(unsigned id, task* t);
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<worker_queue>> queues;
+
+    std::mutex state_lock;
+    std::condition_variable work_cv;
+    std::condition_variable done_cv;
+    size_t pending;
+    unsigned long generation;
+    bool stopping;
+};
+
+}
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef __BUFFER_POOL_HPP__
+#define __BUFFER_POOL_HPP__
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#define SEATS_POOL_BUFFER_SIZE (256 * 1024)
+// Buffers kept around for reuse, the rest is freed on release
+#define SEATS_POOL_MAX_FREE 64
+
+namespace seats{
+
+// Process wide free list of large receive buffers, connections come and
+// go much more often than the buffers need to be allocated.
+class buffer_pool{
+public:
+    static buffer_pool& instance();
+    ~buffer_pool();
+
+    // SEATS_POOL_BUFFER_SIZE bytes, uninitialized
+    char* acquire();
+    void release(char* buff);
+
+private:
+    buffer_pool() = default;
+
+    std::mutex lock;
+    std::vector<char*> free_buffers;
+};
+
+}
+
+#endif // !__BUFFER_POOL_HPP__
@@ -2,31 +2,72 @@
 #ifndef __SEATS_CLIENT_SOCKET_HPP__
 #define __SEATS_CLIENT_SOCKET_HPP__
 
+#include "attest/verifier.hpp"
 #include "seats/seats_socket.hpp"
 #include "ssl_ext/attestation_ext_structs.hpp"
 #include "ssl_ext/evidence_ext_structs.hpp"
 
+#include <chrono>
+#include <memory>
+#include <openssl/ssl.h>
+#include <string>
+
+// Unused tickets kept per host and port, each resumes one connection
+#define SEATS_TICKETS_PER_PEER 4
+
 namespace seats{
 
 class seats_client_socket: public seats_socket{	
 public:
-    seats_client_socket(bool mock_t = false);
+    seats_client_socket(bool mock_t = false, const seats_socket_options& opts = seats_socket_options());
 	~seats_client_socket();
 
 	seats_status connect(const char* host, int port) override;
+    // Sends len bytes of data with the ClientHello (0-RTT) when a resumed
+    // session allows it, right after the handshake otherwise. early is set
+    // when it went out as early data. Early data can be replayed, only
+    // send requests that are safe to repeat.
+    seats_status connect(const char* host, int port, const char* data, size_t len, bool* early = NULL);
+    seats_status create_memory_session() override;
+
+    // Later connects to the same host and port resume a session instead of
+    // attesting again, as long as the attestation the session goes back to
+    // is younger than max_age. The tickets are shared by all client
+    // sockets of the process with the same verifier (mock or not) and
+    // max_age. Tickets arrive after the handshake and are collected by
+    // recv, a connection nothing is read from leaves none behind.
+    void enable_resumption(std::chrono::seconds max_age = std::chrono::seconds(SEATS_ATTESTATION_MAX_AGE_S));
     
     friend int client_hello_ext_add_cb(SSL *s, unsigned int ext_type, unsigned int context, const unsigned char **out, size_t *outlen, X509 *x, size_t chainidx, int *al, void *add_arg);
     friend void client_hello_ext_free_cb(SSL *s, unsigned int ext_type, unsigned int context, const unsigned char *out, void *add_arg);
     friend int server_certificate_ext_parse_cb(SSL *s, unsigned int ext_type, unsigned int context, const unsigned char *in, size_t inlen, X509 *x, size_t chainidx, int *al, void *parse_arg);
 
 private:
+    void new_request(std::shared_ptr<cert_cache> certs);
+    static int new_session_cb(SSL* s, SSL_SESSION* session);
+
     bool mock;
     seats_status verify(AttestationExtension*, EVP_PKEY*);
+    // Why the last handshake was rejected, connect reports it instead of
+    // the generic CONNECTION_ERROR
+    seats_status verify_status = seats_status::OK;
     EvidenceRequestClient* erq;
+    verifier* m_verifier;
+
+    bool resumption = false;
+    std::chrono::seconds max_age{SEATS_ATTESTATION_MAX_AGE_S};
+    // Tickets are only shared with sockets of the same peer, verifier and
+    // max_age
+    std::string ticket_key;
+    // Attestation of the session in use and the one the offered ticket
+    // goes back to, zero while unattested
+    std::chrono::steady_clock::time_point attested_at;
+    std::chrono::steady_clock::time_point ticket_attested_at;
 
 protected:
 	seats_status create_context();
 	seats_status create_socket();
+    seats_status create_secure_socket() override;
 };
 
 }
@@ -0,0 +1,93 @@
+#ifndef __SEATS_CONNECTION_POOL_HPP__
+#define __SEATS_CONNECTION_POOL_HPP__
+
+#include "seats/seats_client_socket.hpp"
+#include "seats/seats_types.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+// Idle connections kept per endpoint, more are closed on release
+#define SEATS_CONN_POOL_MAX_IDLE 16
+// Connections older than this are attested again before they are reused
+#define SEATS_CONN_POOL_MAX_AGE_S 300
+// How often the background thread checks idle connections and refills
+#define SEATS_CONN_POOL_MAINTAIN_MS 1000
+
+namespace seats{
+
+// Attested client connections keyed by endpoint. acquire hands out an idle
+// connection after a non-blocking liveness check (no round trip) and only
+// connects when none is left. A background thread keeps prewarmed
+// endpoints at their minimum and re-attests connections past max_age by
+// reconnecting the same socket. All calls are thread safe, handshakes run
+// outside the pool lock.
+class seats_connection_pool{
+public:
+    seats_connection_pool(bool mock = false, size_t max_idle = SEATS_CONN_POOL_MAX_IDLE,
+            std::chrono::seconds max_age = std::chrono::seconds(SEATS_CONN_POOL_MAX_AGE_S),
+            const seats_socket_options& opts = seats_socket_options());
+    // Closes the idle connections, ones still lent out are left to the
+    // caller to delete
+    ~seats_connection_pool();
+    seats_connection_pool(const seats_connection_pool&) = delete;
+    seats_connection_pool& operator=(const seats_connection_pool&) = delete;
+
+    // Keeps at least min_idle attested connections to the endpoint ready,
+    // they are created in the background
+    void prewarm(const char* host, int port, size_t min_idle);
+
+    // An attested connection owned by the caller until release, NULL if
+    // connecting failed (the reason goes to result)
+    seats_client_socket* acquire(const char* host, int port, seats_status* result = NULL);
+    // Pass reusable = false after an error, such connections are closed
+    void release(seats_client_socket* s, bool reusable = true);
+
+    size_t idle(const char* host, int port);
+
+private:
+    struct connection{
+        std::unique_ptr<seats_client_socket> s;
+        std::chrono::steady_clock::time_point attested;
+    };
+    struct endpoint{
+        std::string host;
+        int port;
+        size_t min_idle = 0;
+        // Handshakes the background thread has in progress
+        size_t connecting = 0;
+        std::deque<connection> idle;
+    };
+    struct lent{
+        endpoint* ep;
+        std::chrono::steady_clock::time_point attested;
+    };
+
+    endpoint& get_endpoint(const char* host, int port);
+    bool expired(std::chrono::steady_clock::time_point attested);
+    static bool alive(seats_client_socket* s);
+    void maintain();
+
+    bool mock;
+    seats_socket_options opts;
+    size_t max_idle;
+    std::chrono::seconds max_age;
+
+    std::mutex lock;
+    std::condition_variable cv;
+    bool stopping = false;
+    std::unordered_map<std::string, std::unique_ptr<endpoint>> endpoints;
+    std::unordered_map<seats_client_socket*, lent> out;
+    std::thread maintainer;
+};
+
+}
+
+#endif // !__SEATS_CONNECTION_POOL_HPP__
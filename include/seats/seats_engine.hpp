@@ -0,0 +1,103 @@
+#ifndef __SEATS_ENGINE_HPP__
+#define __SEATS_ENGINE_HPP__
+
+#include "attest/attester.hpp"
+#include "seats/seats_socket.hpp"
+#include "seats/seats_types.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace seats{
+
+enum class engine_role{ CLIENT, SERVER };
+
+enum class engine_state{
+    // Handshake waits for bytes from the peer
+    NEED_INPUT,
+    // Records to put on the transport, pull them
+    HAVE_OUTPUT,
+    // A handshake step (attestation or verification) runs on the executor
+    ATTESTATION_PENDING,
+    ESTABLISHED,
+    // The peer sent close_notify or close was called
+    CLOSED,
+    FAILED,
+};
+
+// Runs a task on some worker thread of the caller's choosing
+using engine_executor = std::function<void(std::function<void()>)>;
+
+// The attested handshake and record layer without any I/O, on memory BIOs.
+// The caller moves bytes between its transport and the engine (feed what
+// was received, pull what has to be sent) and drives it from any event
+// loop. The attestation extensions are the ones of seats_client_socket and
+// seats_stc_socket, the engine only replaces the socket underneath.
+//
+// Not thread safe, except that with offload() the handshake steps run on
+// the executor while feed/pull/get_state stay callable.
+class seats_engine{
+public:
+    seats_engine(engine_role role, bool mock = false);
+    ~seats_engine();
+    seats_engine(const seats_engine&) = delete;
+    seats_engine& operator=(const seats_engine&) = delete;
+
+    // Attestation and verification can take long (the SEV tools, RSA-4096),
+    // with an executor every handshake step runs there and notify is
+    // called from the executor thread once the step is done. Set before
+    // start/feed.
+    void offload(engine_executor executor, std::function<void()> notify);
+
+    // Client: queues the ClientHello. Server: nothing to do, the handshake
+    // starts with the first feed.
+    seats_status start();
+    // Bytes received from the transport, advances the handshake
+    seats_status feed(const char* data, size_t len);
+    // Copies up to len bytes that have to be sent, returns how many
+    size_t pull(char* out, size_t len);
+    size_t pending_output();
+
+    // Plaintext after ESTABLISHED. write queues records for pull, read
+    // returns 0 if nothing complete was fed yet, -1 on errors.
+    ssize_t write(const char* data, size_t len);
+    ssize_t read(char* data, size_t len);
+    // Queues close_notify
+    void close();
+
+    engine_state get_state();
+    seats_status get_status();
+    SSL* get_ssl_session();
+
+private:
+    void step();
+    void handshake();
+
+    std::unique_ptr<attester> m_attester;
+    std::unique_ptr<seats_socket> sock;
+    SSL* ssl = NULL;
+    BIO* rbio = NULL;
+    BIO* wbio = NULL;
+    // Written by the executor during a step, read by the caller meanwhile
+    std::atomic<seats_status> status{seats_status::OK};
+    std::atomic<bool> established{false};
+    bool closed = false;
+
+    engine_executor executor;
+    std::function<void()> notify;
+    std::mutex lock;
+    std::condition_variable idle;
+    // While a step runs on the executor the SSL belongs to it, fed bytes
+    // wait in inbox
+    std::atomic<bool> running{false};
+    std::vector<char> inbox;
+};
+
+}
+
+#endif // !__SEATS_ENGINE_HPP__
@@ -0,0 +1,59 @@
+#ifndef __SEATS_FRAMER_HPP__
+#define __SEATS_FRAMER_HPP__
+
+#include "seats/seats_socket.hpp"
+#include "seats/seats_types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <sys/uio.h>
+#include <vector>
+
+// Big endian length in front of every message
+#define SEATS_FRAME_HEADER_LEN 4
+#define SEATS_FRAME_MAX_DEFAULT (64 * 1024)
+// Buffers one send_msg can gather
+#define SEATS_FRAME_MAX_IOV 15
+
+namespace seats{
+
+// Length prefixed messages over a connected seats_socket. Reads go into
+// one large receive buffer (from the buffer_pool when it is big enough)
+// and messages are handed out as views into it, so a single SSL_read can
+// deliver many messages without copying them again.
+class seats_framer{
+public:
+    seats_framer(seats_socket* s, size_t max_msg = SEATS_FRAME_MAX_DEFAULT);
+    ~seats_framer();
+    seats_framer(const seats_framer&) = delete;
+    seats_framer& operator=(const seats_framer&) = delete;
+
+    // One message from the concatenated buffers, header and payload go
+    // out in the same record
+    seats_status send_msg(const char* data, size_t len);
+    seats_status send_msg(const struct iovec* iov, int iovcnt);
+
+    // Views stay valid until the next recv_msg/recv_msgs call
+    seats_status recv_msg(std::span<const char>* msg);
+    // All complete messages already received, reads only if there are none
+    seats_status recv_msgs(std::vector<std::span<const char>>& msgs);
+
+private:
+    bool next(std::span<const char>* msg);
+    seats_status fill();
+
+    seats_socket* s;
+    size_t max_msg;
+    char* buff;
+    size_t cap;
+    bool pooled;
+    // Parsed up to rpos, received up to wpos
+    size_t rpos;
+    size_t wpos;
+    seats_status error;
+};
+
+}
+
+#endif // !__SEATS_FRAMER_HPP__
@@ -0,0 +1,104 @@
+#ifndef __SEATS_METRICS_HPP__
+#define __SEATS_METRICS_HPP__
+
+#include "seats/seats_trace.hpp"
+#include "seats/seats_types.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Upper bounds of the phase histogram buckets in microseconds, the last
+// bucket takes everything above
+#define SEATS_METRICS_BUCKETS_US 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, \
+    25000, 50000, 100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000
+#define SEATS_METRICS_BUCKETS 20
+
+// Serves the Prometheus endpoint on 127.0.0.1 from the first metric
+// recorded on when set, same as calling metrics::serve
+#define SEATS_METRICS_PORT_ENV "SEATS_METRICS_PORT"
+
+namespace seats{
+
+enum class metric_phase{
+    // SERVER
+    // ClientHello evidence request deserialization
+    REQUEST_PARSE,
+    // Digest and signature over the request (set_data)
+    REQUEST_SIGN,
+    ATTEST,
+    EVIDENCE_SERIALIZE,
+    HANDSHAKE_SERVER,
+    // CLIENT
+    // Certificate extension and evidence payload deserialization
+    EVIDENCE_PARSE,
+    VERIFY_CERTS,
+    VERIFY_REPORT,
+    HANDSHAKE_CLIENT,
+    COUNT
+};
+
+struct metrics_snapshot{
+    struct histogram{
+        // Not cumulative, buckets[i] counts values in (bound i-1, bound i]
+        uint64_t buckets[SEATS_METRICS_BUCKETS];
+        uint64_t count;
+        uint64_t sum_ns;
+    };
+
+    histogram phases[(size_t)metric_phase::COUNT];
+    uint64_t failures[SEATS_STATUS_COUNT];
+    uint64_t connections_opened;
+    uint64_t connections_closed;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+
+    int64_t active_connections() const{ return connections_opened - connections_closed; }
+};
+
+// Process wide counters for the handshake phases, failures, connections
+// and traffic. Every thread writes its own block with plain relaxed stores,
+// nothing is shared on the hot path, snapshot() adds all blocks up.
+class metrics{
+public:
+    static void observe(metric_phase phase, uint64_t ns);
+    static void failure(seats_status status);
+    static void connection_opened();
+    static void connection_closed();
+    static void bytes_in(size_t n);
+    static void bytes_out(size_t n);
+
+    static metrics_snapshot snapshot();
+    // Prometheus text exposition format 0.0.4
+    static std::string prometheus();
+
+    // GET /metrics on 127.0.0.1:port from a background thread
+    static seats_status serve(int port);
+    static void stop_serving();
+
+    static const char* phase_name(metric_phase phase);
+};
+
+// Observes the time until it goes out of scope, a span of the connection
+// trace too
+class metric_timer{
+public:
+    explicit metric_timer(metric_phase phase):
+        phase(phase), span(metrics::phase_name(phase)), start(std::chrono::steady_clock::now()){}
+    ~metric_timer(){
+        metrics::observe(phase, std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+    metric_timer(const metric_timer&) = delete;
+    metric_timer& operator=(const metric_timer&) = delete;
+
+private:
+    metric_phase phase;
+    trace_span span;
+    std::chrono::steady_clock::time_point start;
+};
+
+}
+
+#endif // !__SEATS_METRICS_HPP__
@@ -0,0 +1,93 @@
+#ifndef __SEATS_MUX_HPP__
+#define __SEATS_MUX_HPP__
+
+#include "seats/seats_socket.hpp"
+#include "seats/seats_types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <thread>
+
+// type (1) | stream id (4) | length or window increment (4), big endian
+#define SEATS_MUX_FRAME_HEADER_LEN 9
+// Largest DATA payload, a frame fits one TLS record
+#define SEATS_MUX_FRAME_MAX (16 * 1024 - SEATS_MUX_FRAME_HEADER_LEN)
+// Bytes a stream may have in flight before the peer reads them
+#define SEATS_MUX_WINDOW (256 * 1024)
+// Frames encoded per write before the I/O thread reads again
+#define SEATS_MUX_WRITE_BATCH (64 * 1024)
+#define SEATS_MUX_READ_BUFFER (64 * 1024)
+
+namespace seats{
+
+struct mux_state;
+
+// One logical, bidirectional byte stream of a seats_mux. Handles stay
+// usable after the mux is gone, every call then fails.
+class seats_stream{
+public:
+    uint32_t get_id();
+
+    // Blocks until everything is queued for sending (bounded by the flow
+    // control window), returns len or -1 if the stream or mux is gone
+    ssize_t write(const char* data, size_t len);
+    // Blocks until data arrives, returns 0 after the peer closed its side
+    // and everything was read, -1 on reset or a dead connection
+    ssize_t read(char* data, size_t len);
+    // Half close, the peer reads 0 once it got everything written before
+    void close();
+    // Drops both directions without delivering pending data
+    void reset();
+
+private:
+    friend class seats_mux;
+    friend struct mux_state;
+
+    std::shared_ptr<mux_state> m;
+    uint32_t id;
+
+    std::deque<char> sbuf;
+    std::deque<char> rbuf;
+    size_t send_window = SEATS_MUX_WINDOW;
+    size_t recv_window = SEATS_MUX_WINDOW;
+    size_t consumed = 0;
+
+    bool scheduled = false;
+    bool fin_requested = false;
+    bool fin_sent = false;
+    bool remote_fin = false;
+    bool is_reset = false;
+};
+
+// Many independent streams over one attested connection. Takes over the
+// connected socket: from construction until destruction the socket is
+// driven only by the mux I/O thread, which writes frames of all streams
+// round robin (one frame per stream per turn) and dispatches what it
+// reads. Streams opened by the client get odd ids, by the server even.
+class seats_mux{
+public:
+    explicit seats_mux(seats_socket* s);
+    // Waits until everything written to the streams is sent (as the peer
+    // grants window), then hands the socket back
+    ~seats_mux();
+    seats_mux(const seats_mux&) = delete;
+    seats_mux& operator=(const seats_mux&) = delete;
+
+    std::shared_ptr<seats_stream> open();
+    // Blocks until the peer opens a stream, NULL once the connection is gone
+    std::shared_ptr<seats_stream> accept();
+    seats_status get_status();
+
+private:
+    void io_loop();
+
+    seats_socket* s;
+    std::shared_ptr<mux_state> m;
+    std::thread io;
+};
+
+}
+
+#endif // !__SEATS_MUX_HPP__
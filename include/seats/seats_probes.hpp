@@ -0,0 +1,41 @@
+#ifndef __SEATS_PROBES_HPP__
+#define __SEATS_PROBES_HPP__
+
+// USDT (SystemTap SDT) probes of provider "seats" for bpftrace, perf and
+// stap. A probe is a single nop in the code plus an ELF note, nothing runs
+// until a tracer attaches. Built in when <sys/sdt.h> is available
+// (systemtap-sdt-dev / systemtap-sdt-devel), -DSEATS_NO_PROBES leaves
+// them out. List them with: bpftrace -l 'usdt:<binary>:seats:*'
+//
+//   handshake_start(fd, server)           handshake_end(fd, server, status)
+//   client_hello_parse_start(len)         client_hello_parse_end(ok)
+//   certificate_add_start()               certificate_add_end(len, -1 on error)
+//   attest_start()                        attest_end(result)
+//   verify_start()                        verify_end(result)
+//   send(fd, bytes)                       recv(fd, bytes, 0 closed, -1 error)
+
+#if !defined(SEATS_NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define SEATS_PROBES_ENABLED 1
+#endif
+#endif
+
+#ifdef SEATS_PROBES_ENABLED
+
+#define SEATS_PROBE0(name) STAP_PROBE(seats, name)
+#define SEATS_PROBE1(name, a) STAP_PROBE1(seats, name, a)
+#define SEATS_PROBE2(name, a, b) STAP_PROBE2(seats, name, a, b)
+#define SEATS_PROBE3(name, a, b, c) STAP_PROBE3(seats, name, a, b, c)
+
+#else
+
+#define SEATS_PROBES_ENABLED 0
+#define SEATS_PROBE0(name) do{}while(0)
+#define SEATS_PROBE1(name, a) do{ (void)(a); }while(0)
+#define SEATS_PROBE2(name, a, b) do{ (void)(a); (void)(b); }while(0)
+#define SEATS_PROBE3(name, a, b, c) do{ (void)(a); (void)(b); (void)(c); }while(0)
+
+#endif
+
+#endif // !__SEATS_PROBES_HPP__
@@ -0,0 +1,83 @@
+#ifndef __SEATS_RESOLVER_HPP__
+#define __SEATS_RESOLVER_HPP__
+
+#include "seats/seats_types.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <sys/socket.h>
+#include <unordered_map>
+#include <vector>
+
+// getaddrinfo does not report record TTLs, answers are kept this long
+#define SEATS_DNS_TTL_S 30
+#define SEATS_DNS_NEGATIVE_TTL_S 5
+// Names kept, the least recently used one goes first
+#define SEATS_DNS_MAX_NAMES 1024
+// Threads running getaddrinfo, shared by all names
+#define SEATS_DNS_LOOKUP_THREADS 4
+
+namespace seats{
+
+struct seats_address{
+    struct sockaddr_storage addr;
+    socklen_t len;
+};
+
+// Host name cache in front of getaddrinfo. Lookups are queued for a few
+// lookup threads, callers wait at most their timeout and concurrent
+// callers share one lookup. An expired answer is still returned while a background
+// lookup refreshes it, so only the first connect to a name waits for DNS.
+// Literal addresses never reach the cache.
+class seats_resolver{
+public:
+    static seats_resolver& instance();
+
+    // Addresses of host with port set, IPv6 and IPv4 interleaved starting
+    // with the family getaddrinfo prefers (RFC 8305 section 4)
+    seats_status resolve(const char* host, int port, std::vector<seats_address>* out,
+                         std::chrono::milliseconds timeout);
+
+    void set_ttl(std::chrono::seconds ttl, std::chrono::seconds negative_ttl);
+    // Every name is looked up again on its next use
+    void flush();
+
+private:
+    struct entry{
+        std::vector<seats_address> addrs;
+        seats_status status = seats_status::OK;
+        std::chrono::steady_clock::time_point expires;
+        bool lookup = false;
+        bool done = false;
+        uint64_t generation = 0;
+        uint64_t used = 0;
+        // Callers waiting for the lookup, the entry is not evicted meanwhile
+        unsigned waiters = 0;
+    };
+
+    seats_resolver() = default;
+    void start(const std::string& host, entry& e);
+    void evict(const entry* keep);
+    void lookup_loop();
+    void lookup(const std::string& host);
+
+    std::mutex lock;
+    std::condition_variable cv;
+    std::unordered_map<std::string, entry> cache;
+    uint64_t uses = 0;
+
+    std::condition_variable queue_cv;
+    std::deque<std::string> queue;
+    unsigned lookup_threads = 0;
+    unsigned idle_threads = 0;
+    std::chrono::seconds ttl{SEATS_DNS_TTL_S};
+    std::chrono::seconds negative_ttl{SEATS_DNS_NEGATIVE_TTL_S};
+};
+
+}
+
+#endif // !__SEATS_RESOLVER_HPP__
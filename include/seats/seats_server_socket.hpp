@@ -3,6 +3,10 @@
 
 #include "attest/attester.hpp"
 #include "seats/seats_socket.hpp"
+#include "seats/seats_socket_options.hpp"
+#include "seats/seats_stc_socket.hpp"
+
+#include <cstdint>
 
 #include <sys/types.h>
 
@@ -10,19 +14,35 @@ namespace seats{
 
 class seats_server_socket{	
 public:
-    seats_server_socket(uint port, bool mock_t = false);
+    // With reuse_port several server sockets (one per event loop) can
+    // listen on the same port, the kernel spreads connections over them.
+    // Listens on IPv6 and IPv4 (dual stack), IPv4 only without IPv6.
+    // Accepted connections inherit the listener's opts.
+    seats_server_socket(uint port, bool mock_t = false, bool reuse_port = false,
+            const seats_socket_options& opts = seats_socket_options());
     ~seats_server_socket();
+    // NULL on error, also when a non-blocking listener has nothing pending
     seats_socket* accept();
     seats_status get_status();
+    int get_fd();
+    // kTLS for every connection accepted from now on
+    void enable_ktls(bool on = true);
+    // Resumed clients may send up to max bytes with their ClientHello
+    // (0-RTT), accept() reads them ahead of the rest. Early data can be
+    // replayed by an attacker, a ticket is accepted once per process.
+    void enable_early_data(uint32_t max = SEATS_MAX_EARLY_DATA);
 private:
-    seats_status create_socket(uint port);
+    seats_status create_socket(uint port, bool reuse_port, const seats_socket_options& opts);
     seats_status create_attester();
 
     bool mock;
+    bool ktls = false;
     seats_status status;
-    int socket_handle;
-    struct sockaddr_in addr;
+    int socket_handle = -1;
+    struct sockaddr_storage addr;
     attester* m_attester;
+    // Shared by the accepted connections
+    SSL_CTX* ssl_context = NULL;
 };
 
 }
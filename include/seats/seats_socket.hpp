@@ -1,11 +1,30 @@
 #ifndef __SEATS_SOCKET_HPP__
 #define __SEATS_SOCKET_HPP__
 
+#include "seats/seats_socket_options.hpp"
 #include "seats/seats_types.hpp"
 
+#include <chrono>
+#include <memory>
 #include <netinet/in.h>
 #include <openssl/crypto.h>
 #include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <vector>
+
+// Records at the start of a burst fit in one TCP segment so the peer can
+// decrypt the first bytes without waiting for more segments
+#define SEATS_TCP_MSS_ESTIMATE 1208
+#define SEATS_TLS_RECORD_OVERHEAD 22
+#define SEATS_RECORD_SMALL (SEATS_TCP_MSS_ESTIMATE - SEATS_TLS_RECORD_OVERHEAD)
+// Full 16 KB records once this much was sent in the burst
+#define SEATS_RECORD_BOOST_BYTES (128 * 1024)
+// A pause this long starts a new burst
+#define SEATS_RECORD_IDLE_RESET_MS 1000
+// Session tickets, and with them resumption and early data, are valid this
+// long. Clients do not resume sessions whose attestation is older.
+#define SEATS_ATTESTATION_MAX_AGE_S 300
 
 namespace seats{
 class seats_socket{
@@ -14,27 +33,90 @@ public:
 	virtual ~seats_socket();
 	
 	SSL_CTX* get_ssl_context();
+    SSL* get_ssl_session();
+    int get_fd();
 
 	virtual seats_status connect(const char* host, int port);
     virtual seats_status accept();
 	virtual seats_status close();
 
-	virtual int send(const char* data, int datalen);
-	virtual int recv(char* data, int datalen);	
+	// Return the number of bytes transferred, 0 on a closed connection
+	// (recv) and -1 on error
+	virtual ssize_t send(const char* data, size_t datalen);
+	virtual ssize_t recv(char* data, size_t datalen);	
+
+    // Writes the buffers as if they were one, packed into records of the
+    // adaptive record size instead of one record per buffer
+    ssize_t sendv(const struct iovec* iov, int iovcnt);
+    // While corked send/sendv only fill records, partial records are sent
+    // by flush, uncork, recv or close
+    void cork(bool on = true);
+    seats_status flush();
+
+    // Hands the record layer to the kernel (kTLS) once the handshake is
+    // done. Has to be called before connect/accept, without kernel or
+    // cipher support the session stays in user space.
+    void enable_ktls(bool on = true);
+    bool ktls_send_active();
+    bool ktls_recv_active();
+
+    // Sends len bytes of fd from offset. Zero copy through SSL_sendfile
+    // when kTLS send is active, pread + SSL_write_ex otherwise.
+    // Returns the number of bytes sent or -1.
+    ssize_t send_file(int fd, off_t offset, size_t len);
 
     seats_status get_status();
 
+    // Client: the early data of connect went out as 0-RTT data.
+    // Server: the client's early data was accepted, recv returns it first.
+    bool early_data_accepted();
+    // The handshake resumed a session, without certificate and attestation
+    bool session_resumed();
+
+    // Session on memory BIOs instead of the socket, for seats_engine
+    virtual seats_status create_memory_session();
+
 protected:
     virtual seats_status create_secure_socket();
+    seats_status new_session();
+    // Resolves host and races its addresses (Happy Eyeballs), the winner
+    // becomes socket_handle
+    seats_status connect_tcp(const char* host, int port);
+    size_t record_size();
+    int write_out(const char* data, size_t len);
+    // Server side 0-RTT data into early_in, 0 on error
+    int read_early_data();
 
     seats_status status;
 
-    struct sockaddr_in addr;
+    struct sockaddr_storage addr;
     socklen_t addr_len;
-	int socket_handle;
+	int socket_handle = -1;
+    bool ktls = false;
+    seats_socket_options options;
+    // Counted as an active connection in the metrics
+    bool established = false;
+    // From the accepted TCP connection to a ready session, traced by accept
+    uint64_t accepted_ns = 0;
+    uint64_t ready_ns = 0;
+
+    // Client: sent with the ClientHello when the session allows it, after
+    // the handshake otherwise. Server: early data read by accept.
+    const char* early_data = NULL;
+    size_t early_len = 0;
+    bool early_accepted = false;
+    std::vector<char> early_in;
+    size_t early_off = 0;
+
+	SSL_CTX* ssl_context = NULL;
+	SSL* ssl_session = NULL;	
 
-	SSL_CTX* ssl_context;
-	SSL* ssl_session;	
+    // Plaintext of the record being filled
+    std::unique_ptr<char[]> wbuf;
+    size_t wlen = 0;
+    bool corked = false;
+    size_t burst_bytes = 0;
+    std::chrono::steady_clock::time_point last_write;
 };
 
 }
@@ -0,0 +1,56 @@
+#ifndef __SEATS_SOCKET_OPTIONS_HPP__
+#define __SEATS_SOCKET_OPTIONS_HPP__
+
+#include "seats/seats_types.hpp"
+
+#define SEATS_KEEPALIVE_IDLE_S 60
+#define SEATS_KEEPALIVE_INTERVAL_S 10
+#define SEATS_KEEPALIVE_COUNT 6
+// Connections a listener may have in the SYN+data state
+#define SEATS_FASTOPEN_QUEUE 256
+// Name resolution and TCP connect together
+#define SEATS_CONNECT_TIMEOUT_MS 10000
+// Happy Eyeballs: the next address is tried when the previous one did not
+// connect within this (RFC 8305 recommends 250 ms)
+#define SEATS_CONNECT_ATTEMPT_DELAY_MS 250
+
+namespace seats{
+
+// TCP settings of client and server sockets, applied before connect and
+// before listen. Accepted connections inherit them from the listener.
+struct seats_socket_options{
+    // Nagle off, the handshake flights and small messages are not held
+    // back waiting for ACKs
+    bool nodelay = true;
+
+    // TCP Fast Open. Clients use TCP_FASTOPEN_CONNECT, the ClientHello
+    // rides on the SYN once the server's cookie is cached, so reconnects
+    // save a round trip. Servers accept SYN data with a queue of
+    // fastopen_queue. Also needs net.ipv4.tcp_fastopen (1 client, 2
+    // server), without kernel support the connection is a plain one.
+    bool fastopen = false;
+    int fastopen_queue = SEATS_FASTOPEN_QUEUE;
+
+    // Detects dead peers of idle (pooled) connections
+    bool keepalive = false;
+    int keepalive_idle_s = SEATS_KEEPALIVE_IDLE_S;
+    int keepalive_interval_s = SEATS_KEEPALIVE_INTERVAL_S;
+    int keepalive_count = SEATS_KEEPALIVE_COUNT;
+
+    // SO_SNDBUF / SO_RCVBUF in bytes, 0 keeps the kernel's autotuning
+    int send_buffer = 0;
+    int recv_buffer = 0;
+
+    int connect_timeout_ms = SEATS_CONNECT_TIMEOUT_MS;
+    int attempt_delay_ms = SEATS_CONNECT_ATTEMPT_DELAY_MS;
+
+    seats_status apply_client(int fd) const;
+    seats_status apply_listener(int fd) const;
+
+private:
+    seats_status apply(int fd) const;
+};
+
+}
+
+#endif // !__SEATS_SOCKET_OPTIONS_HPP__
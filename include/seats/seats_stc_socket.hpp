@@ -7,18 +7,41 @@
 #include "ssl_ext/evidence_ext_structs.hpp"
 #include "ssl_ext/server_ext_cbs.hpp"
 
+#include <cstdint>
+
+// Early data a server accepts when enabled
+#define SEATS_MAX_EARLY_DATA 16384
+// Only tickets issued this recently may carry early data
+#define SEATS_EARLY_DATA_WINDOW_S 60
+// Tickets remembered against replayed early data, early data is rejected
+// while the store is full
+#define SEATS_EARLY_DATA_REPLAY_MAX 65536
+
 namespace seats{
 
 class seats_stc_socket: public seats_socket{
 public:
-    seats_stc_socket(int sock_fd, struct sockaddr_in addr, socklen_t addrlen, attester* t_attester);
-	seats_status connect(const char* host, int port);
+    // Connections of a server share its context (tickets, certificate)
+    seats_stc_socket(int sock_fd, const struct sockaddr_storage& addr, socklen_t addrlen, attester* t_attester,
+                     SSL_CTX* shared_ctx);
+    // Without a socket, the session comes from create_memory_session
+    explicit seats_stc_socket(attester* t_attester);
+    seats_status create_memory_session() override;
+ 	seats_status connect(const char* host, int port);
+
+    // Server context with the attestation extensions, the certificate of
+    // the attester and session tickets. max_early_data 0 rejects 0-RTT
+    // data, otherwise every ticket is good for one early data attempt
+    // within its lifetime.
+    static seats_status new_context(attester* t_attester, SSL_CTX** ctx);
+    static void set_max_early_data(SSL_CTX* ctx, uint32_t max_early_data);
+    static seats_stc_socket* from_session(SSL* s);
  
     friend int server_certificate_ext_add_cb(SSL *s, unsigned int ext_type, unsigned int context, const unsigned char **out, size_t *outlen, X509 *x, size_t chainidx, int *al, void *add_arg);
     friend void server_certificate_ext_free_cb(SSL *s, unsigned int ext_type, unsigned int context, const unsigned char *out, void *add_arg);
     friend int client_hello_ext_parse_cb(SSL *s, unsigned int ext_type, unsigned int context, const unsigned char *in, size_t inlen, X509 *x, size_t chainidx, int *al, void *parse_arg);
 private:
-    AttestationExtension* attest();
+    int attest(AttestationExtension* ax);
 
     seats::attester* m_attester;
 protected:
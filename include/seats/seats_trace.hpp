@@ -0,0 +1,81 @@
+#ifndef __SEATS_TRACE_HPP__
+#define __SEATS_TRACE_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Tracing starts with the process when set, the kept spans are written to
+// this file at exit
+#define SEATS_TRACE_FILE_ENV "SEATS_TRACE_FILE"
+// "chrome" (default, chrome://tracing and Perfetto) or "otlp" (OTLP/JSON)
+#define SEATS_TRACE_FORMAT_ENV "SEATS_TRACE_FORMAT"
+// Keep one of every N connection traces, 100 by default
+#define SEATS_TRACE_SAMPLE_ENV "SEATS_TRACE_SAMPLE"
+// Also keep every trace at least this long, whether sampled or not
+#define SEATS_TRACE_SLOW_US_ENV "SEATS_TRACE_SLOW_US"
+
+// Spans kept in the ring, the oldest are overwritten
+#define SEATS_TRACE_RING_SPANS 16384
+// Spans of one connection trace above this are dropped
+#define SEATS_TRACE_MAX_SPANS 256
+
+namespace seats{
+
+enum class trace_format{ CHROME, OTLP };
+
+struct trace_span_record{
+    uint64_t trace_hi;
+    uint64_t trace_lo;
+    // 1 based within the trace, parent 0 is the root
+    uint32_t span;
+    uint32_t parent;
+    const char* name;
+    // steady_clock
+    uint64_t start_ns;
+    uint64_t end_ns;
+    uint32_t tid;
+};
+
+// Span tree per connection. A root span (connection.accept,
+// connection.connect) starts a trace on its thread, every span opened on
+// that thread until the root ends is its descendant. The spans of a trace
+// are buffered by the thread and only reach the shared ring when the trace
+// is kept: head sampled (one of every sample_every) or slower than slow_us.
+// Spans outside of a trace, like the ones on work pool threads, cost a
+// branch. Span names must be string literals.
+class trace{
+public:
+    static void enable(uint32_t sample_every, uint64_t slow_us = 0);
+    static void disable();
+    static bool enabled();
+
+    // Kept spans, oldest trace first
+    static std::vector<trace_span_record> collect();
+    static void clear();
+    // Returns 1 if the file can not be written
+    static int write(const char* path, trace_format format);
+
+    // Adds an already finished span under the current span
+    static void record(const char* name, uint64_t start_ns, uint64_t end_ns);
+    static uint64_t now();
+};
+
+class trace_span{
+public:
+    // A root at start_ns (now when 0) or a child of the current span
+    explicit trace_span(const char* name, bool root = false, uint64_t start_ns = 0);
+    ~trace_span();
+    trace_span(const trace_span&) = delete;
+    trace_span& operator=(const trace_span&) = delete;
+
+private:
+    // In the thread's trace, -1 when not recorded
+    int32_t index = -1;
+    int32_t parent = -1;
+    bool root = false;
+};
+
+}
+
+#endif // !__SEATS_TRACE_HPP__
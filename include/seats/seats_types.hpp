@@ -49,8 +49,24 @@ enum seats_status{
     RECEIVING_FAILED,
 	ATTESTATION_INVALID,
 	SENDING_FAILED, 
+
+    // FRAMING RELATED ERRORS
+    MESSAGE_TOO_LARGE,
+    CONNECTION_CLOSED,
+
+    // SOCKET OPTION ERRORS
+    UNABLE_TO_SET_SOCKET_OPTION,
+
+    // NAME RESOLUTION ERRORS
+    UNABLE_TO_RESOLVE_HOST,
+
     NOT_IMPLEMENTED_ERROR
 };
 
+#define SEATS_STATUS_COUNT (seats::seats_status::NOT_IMPLEMENTED_ERROR + 1)
+
+// Enumerator name, "OK" for OK
+const char* seats_status_name(seats_status status);
+
 }
 #endif // !__SEATS_TYPES_HPP__
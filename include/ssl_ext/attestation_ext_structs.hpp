@@ -10,19 +10,39 @@ enum AttestationType {
 };
 
 struct EvidencePayload {
-    virtual int serialize(const unsigned char**) = 0;
-    virtual int deserialize(const unsigned char *) = 0;
+    virtual size_t serialized_size() const = 0;
+    virtual int serialize(unsigned char* buff, size_t bufflen) const = 0;
+    virtual int deserialize(std::span<const unsigned char> in) = 0;
     virtual ~EvidencePayload() = default;
 };
 
-// Used in extension of certificate message 
+// Used in extension of certificate message, encoded as a CMW record
+// [SEATS_CMW_CONTENT_FORMAT_BASE + attestation_type, bstr evidence]
 struct AttestationExtension{
     EvidenceRequestServer erq;
     AttestationType attestation_type;
+    // Set on the sending side
     EvidencePayload* evidence_payload;
-    int serialize(const unsigned char**);
-    int deserialize(const unsigned char*);
+    // Set by deserialize, points into the parsed buffer
+    std::span<const unsigned char> evidence_data;
+
+    size_t serialized_size() const;
+    int serialize(unsigned char* buff, size_t bufflen) const;
+    int deserialize(std::span<const unsigned char> in);
 };
 
+namespace seats::cbor{
+
+template<> struct codec<AttestationExtension>{
+    static constexpr uint64_t cmw_type(AttestationType t){
+        return SEATS_CMW_CONTENT_FORMAT_BASE + t;
+    }
+    static size_t size(const AttestationExtension& m);
+    static void write(writer& w, const AttestationExtension& m);
+    static bool read(reader& r, AttestationExtension& m);
+};
+
+}
+
 
 #endif
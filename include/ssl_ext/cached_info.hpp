@@ -0,0 +1,61 @@
+#ifndef __CACHED_INFO_HPP__
+#define __CACHED_INFO_HPP__
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+
+// Cached info for the AMD cert blob, similar to RFC 7924. The client lists
+// the SHA-256 of every blob it already verified in the evidence request and
+// the server answers with the hash instead of the blob when one matches.
+// Caches are per server endpoint, a server only learns about blobs it sent
+// itself, not which other platforms the client talked to.
+
+#define SEATS_CERT_HASH_LEN 32
+// Blobs per endpoint and endpoints, the least recently used ones go first
+#define SEATS_CERT_CACHE_MAX_ENTRIES 8
+#define SEATS_CERT_CACHE_MAX_PEERS 256
+
+typedef std::array<unsigned char, SEATS_CERT_HASH_LEN> cert_hash;
+
+int get_cert_hash(std::span<const unsigned char> blob, cert_hash* hash);
+
+namespace seats{
+
+typedef std::shared_ptr<const std::string> cert_blob;
+
+class cert_cache{
+public:
+    // Cache of one endpoint ("host:port")
+    static std::shared_ptr<cert_cache> for_peer(const std::string& peer);
+    // Bytes saved by all caches
+    static uint64_t bytes_saved();
+
+    void put(std::span<const unsigned char> blob);
+    // The blob stays valid while the caller holds it, also when evicted
+    cert_blob get(const cert_hash& hash);
+    void hashes(std::vector<cert_hash>& out);
+    void clear();
+
+    void add_bytes_saved(uint64_t n);
+
+private:
+    struct entry{
+        cert_blob blob;
+        uint64_t used;
+    };
+
+    std::mutex lock;
+    std::map<cert_hash, entry> blobs;
+    uint64_t uses = 0;
+};
+
+}
+
+#endif // !__CACHED_INFO_HPP__
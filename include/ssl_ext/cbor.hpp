@@ -0,0 +1,98 @@
+#ifndef __CBOR_HPP__
+#define __CBOR_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+// Minimal deterministic CBOR (RFC 8949, preferred serialization) used for
+// the attestation extensions. Only what the extensions need is supported:
+// integers, byte/text strings and definite length arrays.
+
+// Version of the evidence request encoding, first element of the array
+#define SEATS_EXT_VERSION 1
+
+// CMW (draft-ietf-rats-msg-wrap) types of the evidence, CoAP content
+// formats from the experimental range, AttestationType is added to the base
+#define SEATS_CMW_CONTENT_FORMAT_BASE 65000
+
+namespace seats::cbor{
+
+enum major_type : uint8_t{
+    UINT = 0,
+    NINT = 1,
+    BSTR = 2,
+    TSTR = 3,
+    ARRAY = 4,
+};
+
+constexpr size_t head_size(uint64_t v){
+    return v < 24 ? 1 : v <= 0xff ? 2 : v <= 0xffff ? 3 : v <= 0xffffffff ? 5 : 9;
+}
+
+constexpr size_t int_size(int64_t v){
+    return head_size(v < 0 ? ~(uint64_t)v : (uint64_t)v);
+}
+
+constexpr size_t bstr_size(size_t len){ return head_size(len) + len; }
+
+struct writer{
+    unsigned char* p;
+    unsigned char* end;
+    bool ok;
+
+    writer(unsigned char* buff, size_t bufflen): p(buff), end(buff + bufflen), ok(true){}
+
+    void head(major_type mt, uint64_t v);
+    void uint(uint64_t v){ head(UINT, v); }
+    void sint(int64_t v);
+    void bytes(std::span<const unsigned char> b);
+    void text(const char* s, size_t len);
+    void array(size_t n){ head(ARRAY, n); }
+};
+
+// Strings are returned as views into the input, nothing is copied.
+// Any malformed, truncated or non preferred encoding clears ok.
+struct reader{
+    const unsigned char* p;
+    const unsigned char* end;
+    bool ok;
+
+    reader(std::span<const unsigned char> in): p(in.data()), end(in.data() + in.size()), ok(true){}
+
+    major_type peek();
+    bool head(major_type mt, uint64_t* v);
+    bool uint(uint64_t* v){ return head(UINT, v); }
+    bool sint(int64_t* v);
+    bool bytes(std::span<const unsigned char>* b);
+    bool text(const char** s, size_t* len);
+    bool array(size_t* n);
+};
+
+// Specialised for every message that goes on the wire:
+//   static size_t size(const T&);
+//   static void write(writer&, const T&);
+//   static bool read(reader&, T&);
+template<typename T> struct codec;
+
+template<typename T>
+size_t encoded_size(const T& m){ return codec<T>::size(m); }
+
+template<typename T>
+int encode(const T& m, unsigned char* buff, size_t bufflen){
+    if(codec<T>::size(m) > bufflen) return -1;
+    writer w(buff, bufflen);
+    codec<T>::write(w, m);
+    return w.ok ? (int)(w.p - buff) : -1;
+}
+
+template<typename T>
+int decode(T& m, std::span<const unsigned char> in){
+    reader r(in);
+    if(!codec<T>::read(r, m) || !r.ok) return -1;
+    return r.p - in.data();
+}
+
+}
+
+#endif // !__CBOR_HPP__
@@ -1,7 +1,12 @@
 #ifndef __EVIDENCE_STRUCTS_H__
 #define __EVIDENCE_STRUCTS_H__
 
+#include "ssl_ext/cached_info.hpp"
+#include "ssl_ext/cbor.hpp"
+
+#include <cstddef>
 #include <cstdint>
+#include <span>
 #include <vector>
 
 void print_string_hex(const unsigned char* s, int len);
@@ -21,28 +26,61 @@ enum ContentFormat{
     BINARY_FORMAT
 };
 
+// serialize() writes the CBOR encoding into the caller buffer and returns
+// the number of bytes written, or -1 if it does not fit. deserialize()
+// returns the number of bytes consumed, or -1 if the input is malformed or
+// truncated.
+
+// [credential_kind, content_format / media_type], the encoding follows
+// from the CBOR type of the second element
 struct EvidenceType{
     CredentialKind credential_kind;
     TypeEncoding type_encoding;
     union PayloadUnion{
         ContentFormat content_format;
+        // Points into the parsed buffer after deserialize, not terminated
         char* media_type;
     } supported_content;
+    size_t media_type_len;
 
-    int serialize(const unsigned char**);
-    int deserialize(char*); 
+    size_t serialized_size() const;
+    int serialize(unsigned char* buff, size_t bufflen) const;
+    int deserialize(std::span<const unsigned char> in); 
 };
 
+// [SEATS_EXT_VERSION, nonce, [* EvidenceType], ? [* bstr cert hash]]
 struct EvidenceRequestClient{
     std::vector<EvidenceType> supported_evidence_types;
     int64_t nonce;
+    // AMD cert blobs the client already holds, see cached_info.hpp
+    std::vector<cert_hash> cached_cert_hashes;
 
-    int serialize(const unsigned char**);
-    int deserialize(const unsigned char *);
+    size_t serialized_size() const;
+    int serialize(unsigned char* buff, size_t bufflen) const;
+    int deserialize(std::span<const unsigned char> in);
 };
 
 struct EvidenceRequestServer{
     EvidenceType selected_evidence_types;
 };
 
+namespace seats::cbor{
+
+template<> struct codec<EvidenceType>{
+    static constexpr size_t content_format_size(CredentialKind ck, ContentFormat cf){
+        return head_size(2) + head_size(ck) + head_size(cf);
+    }
+    static size_t size(const EvidenceType& m);
+    static void write(writer& w, const EvidenceType& m);
+    static bool read(reader& r, EvidenceType& m);
+};
+
+template<> struct codec<EvidenceRequestClient>{
+    static size_t size(const EvidenceRequestClient& m);
+    static void write(writer& w, const EvidenceRequestClient& m);
+    static bool read(reader& r, EvidenceRequestClient& m);
+};
+
+}
+
 #endif
@@ -0,0 +1,52 @@
+#ifndef __HANDSHAKE_ARENA_HPP__
+#define __HANDSHAKE_ARENA_HPP__
+
+#include <cstddef>
+#include <openssl/ssl.h>
+
+#define SEATS_ARENA_CHUNK_SIZE 4096
+
+namespace seats{
+
+// Bump allocator for the transient buffers of one handshake (extension
+// buffers, signatures). Nothing is freed on its own, the whole arena is
+// reset at once when the handshake is done.
+class arena{
+public:
+    typedef void (*info_cb)(const SSL*, int, int);
+
+    explicit arena(size_t chunk_size = SEATS_ARENA_CHUNK_SIZE);
+    ~arena();
+
+    void* alloc(size_t len, size_t align = alignof(std::max_align_t));
+    // Frees all chunks, the next chunk is sized so that a handshake of the
+    // same size fits in a single allocation
+    void reset();
+
+    size_t allocated(){ return total; }
+
+    // Creates the arena of the session, it lives as long as the SSL object
+    // and is reset on SSL_CB_HANDSHAKE_DONE. Installs an info callback that
+    // chains to the previous one, a callback set after attach replaces it
+    // and the arena is then only freed with the SSL object.
+    static int attach(SSL* s);
+    static arena* get(const SSL* s);
+
+    // Info callback that was set on the SSL object before attach
+    info_cb prev_info;
+
+private:
+    struct chunk{
+        chunk* next;
+        size_t size;
+        size_t used;
+    };
+
+    chunk* head;
+    size_t chunk_size;
+    size_t total;
+};
+
+}
+
+#endif // !__HANDSHAKE_ARENA_HPP__
@@ -2,7 +2,74 @@
 #define __LOG_HPP__
 
 #include <openssl/crypto.h>
+#include <openssl/ssl.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
 
 void SSL_keylog_cb(const SSL *ssl, const char *line);
 
+// LOG LEVELS
+#define SEATS_LOG_TRACE 0
+#define SEATS_LOG_DEBUG 1
+#define SEATS_LOG_INFO  2
+#define SEATS_LOG_WARN  3
+#define SEATS_LOG_ERROR 4
+#define SEATS_LOG_OFF   5
+
+// Messages below SEATS_LOG_LEVEL are compiled out, messages below the
+// runtime level (SEATS_LOG env var, logger::set_level) cost one branch.
+#ifndef SEATS_LOG_LEVEL
+#define SEATS_LOG_LEVEL SEATS_LOG_TRACE
+#endif
+
+// Per thread ring of fixed size records, full rings drop messages
+#define SEATS_LOG_RING_SLOTS 256
+#define SEATS_LOG_MSG_MAX 232
+
+// How often the background thread flushes when nobody wakes it up
+#define SEATS_LOG_FLUSH_MS 50
+
+namespace seats{
+
+// Asynchronous leveled logger. Callers format into a lock free ring owned
+// by their thread, a background thread drains all rings and writes them
+// out in one batch. Use the seats_log_* macros instead of write directly.
+class logger{
+public:
+    static std::atomic<int> level;
+
+    static void write(int lvl, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+    // Drains the openssl error queue into the log
+    static void openssl_errors(int lvl);
+
+    static void set_level(int lvl);
+    // Defaults to stderr, the FILE is not closed by the logger
+    static void set_output(FILE* fp);
+    // Synchronously writes out everything logged so far
+    static void flush();
+    static uint64_t dropped();
+};
+
+}
+
+#define seats_log(lvl, ...) do{ \
+    if constexpr((lvl) >= SEATS_LOG_LEVEL) \
+        if((lvl) >= seats::logger::level.load(std::memory_order_relaxed)) \
+            seats::logger::write((lvl), __VA_ARGS__); \
+}while(0)
+
+#define seats_log_trace(...) seats_log(SEATS_LOG_TRACE, __VA_ARGS__)
+#define seats_log_debug(...) seats_log(SEATS_LOG_DEBUG, __VA_ARGS__)
+#define seats_log_info(...)  seats_log(SEATS_LOG_INFO, __VA_ARGS__)
+#define seats_log_warn(...)  seats_log(SEATS_LOG_WARN, __VA_ARGS__)
+#define seats_log_error(...) seats_log(SEATS_LOG_ERROR, __VA_ARGS__)
+
+#define seats_log_ssl_errors() do{ \
+    if constexpr(SEATS_LOG_ERROR >= SEATS_LOG_LEVEL) \
+        if(SEATS_LOG_ERROR >= seats::logger::level.load(std::memory_order_relaxed)) \
+            seats::logger::openssl_errors(SEATS_LOG_ERROR); \
+}while(0)
+
 #endif
@@ -0,0 +1,74 @@
+// Heap allocation counters shared by the benchmarks: replaces the global
+// operator new/delete and hands OpenSSL counting allocators, so both are
+// counted the same way. allocs/alloc_bytes count every allocation (a
+// realloc counts as one), live/live_bytes are what is still held, bytes
+// as reported by malloc_usable_size. Include it from exactly one file of
+// a program and call alloc_counter::install() before OpenSSL allocates.
+#ifndef __ALLOC_COUNTER_HPP__
+#define __ALLOC_COUNTER_HPP__
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <malloc.h>
+#include <new>
+#include <openssl/crypto.h>
+
+struct alloc_counter{
+    int64_t allocs, alloc_bytes, live, live_bytes;
+
+    static inline std::atomic<int64_t> total_allocs{0};
+    static inline std::atomic<int64_t> total_bytes{0};
+    static inline std::atomic<int64_t> live_allocs{0};
+    static inline std::atomic<int64_t> live_usable{0};
+
+    static alloc_counter now(){
+        return {total_allocs.load(), total_bytes.load(), live_allocs.load(), live_usable.load()};
+    }
+
+    static void* counted(void* p, size_t n){
+        if(p){
+            total_allocs.fetch_add(1, std::memory_order_relaxed);
+            total_bytes.fetch_add(n, std::memory_order_relaxed);
+            live_allocs.fetch_add(1, std::memory_order_relaxed);
+            live_usable.fetch_add(malloc_usable_size(p), std::memory_order_relaxed);
+        }
+        return p;
+    }
+
+    static void uncounted(void* p){
+        if(!p) return;
+        live_allocs.fetch_sub(1, std::memory_order_relaxed);
+        live_usable.fetch_sub(malloc_usable_size(p), std::memory_order_relaxed);
+        free(p);
+    }
+
+    static void* crypto_malloc(size_t n, const char*, int){ return counted(malloc(n), n); }
+    static void crypto_free(void* p, const char*, int){ uncounted(p); }
+
+    static void* crypto_realloc(void* p, size_t n, const char*, int){
+        if(!p) return counted(malloc(n), n);
+        size_t old = malloc_usable_size(p);
+        void* np = realloc(p, n);
+        if(np){
+            total_allocs.fetch_add(1, std::memory_order_relaxed);
+            total_bytes.fetch_add(n, std::memory_order_relaxed);
+            live_usable.fetch_add((int64_t)malloc_usable_size(np) - (int64_t)old, std::memory_order_relaxed);
+        }
+        return np;
+    }
+
+    static bool install(){
+        return CRYPTO_set_mem_functions(crypto_malloc, crypto_realloc, crypto_free);
+    }
+};
+
+void* operator new(size_t n){
+    if(void* p = alloc_counter::counted(malloc(n ? n : 1), n)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept{ alloc_counter::uncounted(p); }
+void operator delete(void* p, size_t) noexcept{ alloc_counter::uncounted(p); }
+
+#endif
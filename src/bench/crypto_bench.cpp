@@ -0,0 +1,111 @@
+// ns per digest/sign/verify with a fresh OpenSSL context and an implicit
+// EVP_sha256() fetch per call (how sev_structs did it before) and with the
+// prefetched SHA-256 and per thread signing contexts of crypto_cache. The
+// key is RSA-4096 like the attester identity key, messages have the sizes
+// used in a handshake.
+#include "attest/crypto_cache.hpp"
+#include "attest/sev/sev_structs.hpp"
+#include "ssl_ext/handshake_arena.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+#include <vector>
+
+using namespace seats;
+using bench_clock = std::chrono::steady_clock;
+
+static int legacy_digest(const char* m, size_t mlen, unsigned char* dig, unsigned int* diglen){
+    EVP_MD_CTX* mdctx = EVP_MD_CTX_new();
+    int ok = EVP_DigestInit_ex2(mdctx, EVP_sha256(), NULL)
+        && EVP_DigestUpdate(mdctx, m, mlen)
+        && EVP_DigestFinal_ex(mdctx, dig, diglen);
+    EVP_MD_CTX_free(mdctx);
+    return !ok;
+}
+
+static EVP_PKEY_CTX* legacy_pkey_ctx(EVP_PKEY* pkey, bool sign){
+    EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new(pkey, NULL);
+    if((sign ? EVP_PKEY_sign_init(ctx) : EVP_PKEY_verify_init(ctx)) <= 0
+            || EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_PKCS1_PADDING) <= 0
+            || EVP_PKEY_CTX_set_signature_md(ctx, EVP_sha256()) <= 0){
+        EVP_PKEY_CTX_free(ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+static int legacy_sign(EVP_PKEY* pkey, const unsigned char* md, size_t mdlen, unsigned char* sig, size_t* siglen){
+    EVP_PKEY_CTX* ctx = legacy_pkey_ctx(pkey, true);
+    int ok = ctx && EVP_PKEY_sign(ctx, NULL, siglen, md, mdlen) > 0
+        && EVP_PKEY_sign(ctx, sig, siglen, md, mdlen) > 0;
+    EVP_PKEY_CTX_free(ctx);
+    return !ok;
+}
+
+static int legacy_verify(EVP_PKEY* pkey, const unsigned char* sig, size_t siglen, const unsigned char* md, size_t mdlen){
+    EVP_PKEY_CTX* ctx = legacy_pkey_ctx(pkey, false);
+    int ok = ctx && EVP_PKEY_verify(ctx, sig, siglen, md, mdlen) > 0;
+    EVP_PKEY_CTX_free(ctx);
+    return !ok;
+}
+
+template<typename F>
+static double ns_per_op(size_t iters, F fn){
+    auto t0 = bench_clock::now();
+    for(size_t i = 0; i < iters; i++)
+        fn();
+    auto t1 = bench_clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / iters;
+}
+
+static void row(const char* name, double before, double after){
+    printf("%-24s %12.1f %12.1f %8.2fx\n", name, before, after, before / after);
+}
+
+int main(int argc, char** argv){
+    size_t iters = argc > 1 ? strtoul(argv[1], NULL, 10) : 200000;
+    size_t rsa_iters = iters / 1000 ? iters / 1000 : 1;
+    EVP_PKEY* pkey = EVP_RSA_gen(4096);
+    unsigned char dig[EVP_MAX_MD_SIZE], sigdig[EVP_MAX_MD_SIZE];
+    unsigned int diglen, sigdiglen;
+    std::vector<char> erq(11, 'e');
+    std::vector<char> sigmsg(512, 's');
+    unsigned char sig[512];
+    size_t siglen = sizeof(sig);
+    arena a;
+
+    if(!pkey) return EXIT_FAILURE;
+    get_sha256_digest(erq.data(), erq.size(), sigdig, &sigdiglen);
+    legacy_sign(pkey, sigdig, sigdiglen, sig, &siglen);
+
+    printf("%-24s %12s %12s %9s\n", "op", "before ns", "after ns", "speedup");
+    row("sha256 11 B",
+        ns_per_op(iters, [&]{ legacy_digest(erq.data(), erq.size(), dig, &diglen); }),
+        ns_per_op(iters, [&]{ get_sha256_digest(erq.data(), erq.size(), dig, &diglen); }));
+    row("sha256 512 B",
+        ns_per_op(iters, [&]{ legacy_digest(sigmsg.data(), sigmsg.size(), dig, &diglen); }),
+        ns_per_op(iters, [&]{ get_sha256_digest(sigmsg.data(), sigmsg.size(), dig, &diglen); }));
+    row("verify RSA-4096",
+        ns_per_op(iters / 10, [&]{ legacy_verify(pkey, sig, siglen, sigdig, sigdiglen); }),
+        ns_per_op(iters / 10, [&]{ verify_signature(pkey, (const char*)sig, siglen, sigdig, sigdiglen); }));
+    row("digest+sign RSA-4096",
+        ns_per_op(rsa_iters, [&]{
+            unsigned char md[EVP_MAX_MD_SIZE];
+            unsigned int mdlen;
+            size_t len = sizeof(sig);
+            legacy_digest(erq.data(), erq.size(), md, &mdlen);
+            legacy_sign(pkey, md, mdlen, sig, &len);
+        }),
+        ns_per_op(rsa_iters, [&]{
+            char* s;
+            size_t len;
+            digest_and_sign(pkey, erq.data(), erq.size(), &s, &len, &a);
+            a.reset();
+        }));
+
+    EVP_PKEY_free(pkey);
+    return EXIT_SUCCESS;
+}
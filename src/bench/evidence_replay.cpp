@@ -0,0 +1,172 @@
+// Replays a captured evidence corpus (SEATS_EVIDENCE_CAPTURE on a client)
+// through the verifier without any server: on one thread, on -t threads
+// with a verifier each, and through verify_batch on the work pool. Every
+// result is compared with the one recorded at capture time, so the same
+// run is a regression test of the verification pipeline, it exits with
+// an error on any mismatch.
+//
+//   evidence_replay [-m] [-t threads] [-n passes] <corpus>
+//
+// -m verifies with the mock backend, otherwise with the SEV tools.
+#include "attest/evidence_corpus.hpp"
+#include "attest/mock/sev/mock_sev_verifier.hpp"
+#include "attest/sev/tool_attest/sev_tool_verifier.hpp"
+#include "attest/verifier.hpp"
+#include "seats/seats_types.hpp"
+#include "ssl_ext/attestation_ext_structs.hpp"
+#include "ssl_ext/cached_info.hpp"
+#include "ssl_ext/log.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <openssl/x509.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace seats;
+using bench_clock = std::chrono::steady_clock;
+
+struct replay_item{
+    EvidenceRequestClient erq;
+    AttestationExtension ax;
+    EVP_PKEY* pkey;
+    bool expect_ok;
+};
+
+static bool mock = false;
+// Shared by every verifier, like the cache of the captured endpoint
+static std::shared_ptr<cert_cache> certs = std::make_shared<cert_cache>();
+
+static std::unique_ptr<verifier> make_verifier(){
+    std::unique_ptr<verifier> v;
+    if(mock) v = std::make_unique<mock_sev_verifier>();
+    else v = std::make_unique<sev_tool_verifier>();
+    v->set_cert_cache(certs);
+    return v;
+}
+
+// Same decision as seats_client_socket::verify
+static bool verify_one(verifier* v, replay_item& it){
+    if(it.ax.attestation_type != AMD_SEV_SNP) return false;
+    v->set_erq(&it.erq);
+    if(v->set_data(it.ax.evidence_data.data(), it.ax.evidence_data.size())) return false;
+    return !v->verify(it.pkey);
+}
+
+static void report(const char* name, size_t ops, size_t mismatches, bench_clock::time_point t0){
+    double s = std::chrono::duration<double>(bench_clock::now() - t0).count();
+    printf("%-24s %10zu %12.1f %10.1f %10zu\n", name, ops, ops / s, s * 1e6 / ops, mismatches);
+}
+
+int main(int argc, char** argv){
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t passes = 10;
+    int opt;
+
+    while((opt = getopt(argc, argv, "mt:n:")) != -1){
+        switch (opt) {
+            case 'm': mock = true; break;
+            case 't': threads = std::max(1, atoi(optarg)); break;
+            case 'n': passes = std::max(1, atoi(optarg)); break;
+            default:
+                fprintf(stderr, "Usage: evidence_replay [-m] [-t threads] [-n passes] <corpus>\n");
+                return EXIT_FAILURE;
+        }
+    }
+    if(optind != argc - 1){
+        fprintf(stderr, "Usage: evidence_replay [-m] [-t threads] [-n passes] <corpus>\n");
+        return EXIT_FAILURE;
+    }
+
+    std::vector<unsigned char> data;
+    std::vector<evidence_record> records;
+    if(load_evidence_corpus(argv[optind], &data, &records)) return EXIT_FAILURE;
+
+    std::vector<replay_item> items(records.size());
+    size_t n = 0;
+    for(evidence_record& r : records){
+        replay_item& it = items[n];
+        const unsigned char* p = r.pubkey.data();
+        if(it.erq.deserialize(r.erq) < 0 || it.ax.deserialize(r.extension) < 0
+                || !(it.pkey = d2i_PUBKEY(NULL, &p, r.pubkey.size()))){
+            fprintf(stderr, "Skipping undecodable record %zu\n", (size_t)(&r - records.data()));
+            continue;
+        }
+        it.expect_ok = r.result == seats_status::OK;
+        n++;
+    }
+    items.resize(n);
+    if(items.empty()){
+        fprintf(stderr, "No records in %s\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+
+    // Rejected evidence is part of the corpus, its errors are expected
+    logger::set_level(SEATS_LOG_OFF);
+
+    // Warm up in capture order, evidence that references cached AMD certs
+    // needs the blob an earlier record put into the shared cache
+    std::unique_ptr<verifier> v = make_verifier();
+    size_t expected_ok = 0;
+    for(replay_item& it : items){
+        verify_one(v.get(), it);
+        expected_ok += it.expect_ok;
+    }
+    printf("%zu records, %zu verified at capture, %zu bytes\n", items.size(), expected_ok, data.size());
+    printf("%-24s %10s %12s %10s %10s\n", "mode", "reports", "reports/s", "us/report", "mismatch");
+
+    size_t mismatches = 0, total_mismatches = 0;
+    auto t0 = bench_clock::now();
+    for(size_t p = 0; p < passes; p++)
+        for(replay_item& it : items)
+            mismatches += verify_one(v.get(), it) != it.expect_ok;
+    report("verify 1 thread", passes * items.size(), mismatches, t0);
+    total_mismatches += mismatches;
+
+    std::atomic<size_t> mt_mismatches{0};
+    std::vector<std::thread> workers;
+    t0 = bench_clock::now();
+    for(unsigned t = 0; t < threads; t++){
+        workers.emplace_back([&, t]{
+            std::unique_ptr<verifier> tv = make_verifier();
+            size_t local = 0;
+            for(size_t p = 0; p < passes; p++)
+                for(size_t i = t; i < items.size(); i += threads)
+                    local += verify_one(tv.get(), items[i]) != items[i].expect_ok;
+            mt_mismatches += local;
+        });
+    }
+    for(auto& w : workers)
+        w.join();
+    char name[32];
+    snprintf(name, sizeof(name), "verify %u threads", threads);
+    report(name, passes * items.size(), mt_mismatches, t0);
+    total_mismatches += mt_mismatches;
+
+    // verify_batch takes the SNP payloads only
+    std::vector<evidence> batch;
+    std::vector<bool> batch_ok;
+    for(replay_item& it : items){
+        if(it.ax.attestation_type != AMD_SEV_SNP) continue;
+        batch.push_back({it.ax.evidence_data.data(), it.ax.evidence_data.size(), &it.erq, it.pkey});
+        batch_ok.push_back(it.expect_ok);
+    }
+    mismatches = 0;
+    t0 = bench_clock::now();
+    for(size_t p = 0; p < passes; p++){
+        std::vector<int> results = v->verify_batch(batch);
+        for(size_t i = 0; i < results.size(); i++)
+            mismatches += (results[i] == 0) != batch_ok[i];
+    }
+    report("verify_batch", passes * batch.size(), mismatches, t0);
+    total_mismatches += mismatches;
+
+    for(replay_item& it : items)
+        EVP_PKEY_free(it.pkey);
+    return total_mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
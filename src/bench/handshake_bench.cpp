@@ -0,0 +1,177 @@
+// Full attested handshakes (mock attester and verifier, the only backend
+// that runs without SEV hardware) between client and server threads of
+// this process over loopback. For every concurrency level 1, 2, 4 .. N it
+// reports handshakes per second and the latency distribution of connect,
+// and writes the same numbers as JSON for tracking regressions.
+//
+//   handshake_bench [-c max concurrency] [-d seconds per level] [-o file.json]
+//
+// Every server thread owns a seats_server_socket on the same port
+// (SO_REUSEPORT), an attester serves one handshake at a time.
+#include "seats/seats_client_socket.hpp"
+#include "seats/seats_server_socket.hpp"
+#include "ssl_ext/log.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <memory>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace seats;
+using bench_clock = std::chrono::steady_clock;
+
+#define BENCH_PORT 9566
+
+struct level_result{
+    unsigned concurrency;
+    size_t handshakes;
+    size_t errors;
+    double seconds;
+    double p50, p99, p999, max, mean;
+};
+
+static void serve(seats_server_socket* srv){
+    seats_socket* s;
+    while((s = srv->accept())){
+        s->accept();
+        delete s;
+    }
+}
+
+static double percentile(const std::vector<double>& sorted, double p){
+    if(sorted.empty()) return 0;
+    size_t i = (size_t)(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(i, sorted.size() - 1)];
+}
+
+static level_result run_level(unsigned concurrency, double seconds){
+    std::vector<std::vector<double>> lat(concurrency);
+    std::atomic<size_t> errors{0};
+    std::vector<std::thread> clients;
+    auto deadline = bench_clock::now() + std::chrono::duration<double>(seconds);
+    auto t0 = bench_clock::now();
+
+    for(unsigned i = 0; i < concurrency; i++){
+        clients.emplace_back([&, i]{
+            // One client context per thread, connect reuses it
+            seats_client_socket cl(true);
+            while(bench_clock::now() < deadline){
+                auto h0 = bench_clock::now();
+                seats_status r = cl.connect("127.0.0.1", BENCH_PORT);
+                auto h1 = bench_clock::now();
+                if(r) errors++;
+                else lat[i].push_back(std::chrono::duration<double, std::micro>(h1 - h0).count());
+            }
+            cl.close();
+        });
+    }
+    for(auto& t : clients)
+        t.join();
+
+    level_result res = {};
+    std::vector<double> all;
+    for(auto& l : lat)
+        all.insert(all.end(), l.begin(), l.end());
+    std::sort(all.begin(), all.end());
+
+    res.concurrency = concurrency;
+    res.seconds = std::chrono::duration<double>(bench_clock::now() - t0).count();
+    res.handshakes = all.size();
+    res.errors = errors;
+    res.p50 = percentile(all, 0.50);
+    res.p99 = percentile(all, 0.99);
+    res.p999 = percentile(all, 0.999);
+    res.max = all.empty() ? 0 : all.back();
+    for(double v : all)
+        res.mean += v / all.size();
+    return res;
+}
+
+static void write_json(const char* path, double seconds, const std::vector<level_result>& results){
+    FILE* f = fopen(path, "w");
+    if(!f){
+        perror(path);
+        return;
+    }
+    fprintf(f, "{\n  \"bench\": \"handshake\",\n  \"backend\": \"mock\",\n");
+    fprintf(f, "  \"timestamp\": %ld,\n  \"cpus\": %u,\n  \"seconds_per_level\": %.1f,\n",
+        (long)time(NULL), std::thread::hardware_concurrency(), seconds);
+    fprintf(f, "  \"levels\": [\n");
+    for(size_t i = 0; i < results.size(); i++){
+        const level_result& r = results[i];
+        fprintf(f, "    {\"concurrency\": %u, \"handshakes\": %zu, \"errors\": %zu, \"per_sec\": %.1f, "
+            "\"mean_us\": %.1f, \"p50_us\": %.1f, \"p99_us\": %.1f, \"p999_us\": %.1f, \"max_us\": %.1f}%s\n",
+            r.concurrency, r.handshakes, r.errors, r.handshakes / r.seconds,
+            r.mean, r.p50, r.p99, r.p999, r.max, i + 1 < results.size() ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    fclose(f);
+}
+
+int main(int argc, char** argv){
+    unsigned max_conc = 16;
+    double seconds = 3;
+    const char* out = "handshake_bench.json";
+    int opt;
+
+    while((opt = getopt(argc, argv, "c:d:o:")) != -1){
+        switch (opt) {
+            case 'c': max_conc = std::max(1, atoi(optarg)); break;
+            case 'd': seconds = atof(optarg); break;
+            case 'o': out = optarg; break;
+            default:
+                fprintf(stderr, "Usage: handshake_bench [-c max concurrency] [-d seconds] [-o file.json]\n");
+                return EXIT_FAILURE;
+        }
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    // Clients closing right after the handshake are expected
+    logger::set_level(SEATS_LOG_OFF);
+
+    std::vector<std::unique_ptr<seats_server_socket>> servers;
+    std::vector<std::thread> threads;
+    for(unsigned i = 0; i < max_conc; i++){
+        servers.emplace_back(new seats_server_socket(BENCH_PORT, true, true));
+        if(servers.back()->get_status()){
+            fprintf(stderr, "Unable to listen on port %d\n", BENCH_PORT);
+            return EXIT_FAILURE;
+        }
+    }
+    for(auto& s : servers)
+        threads.emplace_back(serve, s.get());
+
+    // Key generation, file caches and the first contexts are not measured
+    run_level(1, std::min(seconds, 0.5));
+
+    std::vector<level_result> results;
+    std::vector<unsigned> levels;
+    for(unsigned c = 1; c < max_conc; c *= 2)
+        levels.push_back(c);
+    levels.push_back(max_conc);
+
+    printf("%6s %10s %8s %10s %10s %10s %10s %10s\n",
+        "conc", "hs/s", "errors", "mean us", "p50 us", "p99 us", "p999 us", "max us");
+    for(unsigned c : levels){
+        level_result r = run_level(c, seconds);
+        results.push_back(r);
+        printf("%6u %10.1f %8zu %10.0f %10.0f %10.0f %10.0f %10.0f\n",
+            r.concurrency, r.handshakes / r.seconds, r.errors, r.mean, r.p50, r.p99, r.p999, r.max);
+    }
+    write_json(out, seconds, results);
+    printf("results written to %s\n", out);
+
+    for(auto& s : servers)
+        shutdown(s->get_fd(), SHUT_RDWR);
+    for(auto& t : threads)
+        t.join();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,102 @@
+// Cost of the logger: ns per call for a disabled level, an enabled level
+// (ring buffer) and the synchronous fprintf+fflush it replaced, then the
+// latency of loopback handshakes (mock backend) with logging off, at the
+// default level and at TRACE. Log output goes to /dev/null.
+#include "seats/seats_client_socket.hpp"
+#include "seats/seats_server_socket.hpp"
+#include "ssl_ext/log.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace seats;
+using bench_clock = std::chrono::steady_clock;
+
+#define BENCH_PORT 9561
+
+template<typename F>
+static double ns_per_op(size_t iters, F fn){
+    auto t0 = bench_clock::now();
+    for(size_t i = 0; i < iters; i++)
+        fn(i);
+    auto t1 = bench_clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / iters;
+}
+
+static void bench_calls(FILE* devnull, size_t iters){
+    logger::set_level(SEATS_LOG_INFO);
+    double off = ns_per_op(iters, [](size_t i){ seats_log_debug("Serialized %zu bytes.", i); });
+    // Stay below the ring size so nothing is dropped, the flush is not timed
+    double on = 0;
+    for(size_t done = 0; done < iters; done += SEATS_LOG_RING_SLOTS / 2){
+        on += ns_per_op(SEATS_LOG_RING_SLOTS / 2, [](size_t i){ seats_log_info("Serialized %zu bytes.", i); });
+        logger::flush();
+    }
+    on /= (iters + SEATS_LOG_RING_SLOTS / 2 - 1) / (SEATS_LOG_RING_SLOTS / 2);
+    double sync = ns_per_op(iters, [devnull](size_t i){
+        fprintf(devnull, "Serialized %zu bytes.\n", i);
+        fflush(devnull);
+    });
+
+    printf("%-28s %10s\n", "call", "ns/op");
+    printf("%-28s %10.1f\n", "disabled level", off);
+    printf("%-28s %10.1f\n", "enabled, async", on);
+    printf("%-28s %10.1f\n", "fprintf+fflush (before)", sync);
+}
+
+static void bench_handshakes(const char* name, int level, int n){
+    seats_server_socket srv(BENCH_PORT, true);
+    std::vector<double> lat;
+
+    logger::set_level(level);
+    std::thread server([&]{
+        for(int i = 0; i < n; i++){
+            seats_socket* c = srv.accept();
+            if(!c) continue;
+            c->accept();
+            delete c;
+        }
+    });
+
+    for(int i = 0; i < n; i++){
+        seats_client_socket cl(true);
+        auto t0 = bench_clock::now();
+        if(cl.connect("127.0.0.1", BENCH_PORT)) continue;
+        auto t1 = bench_clock::now();
+        lat.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+    }
+    server.join();
+    logger::flush();
+
+    if(lat.empty()) return;
+    std::sort(lat.begin(), lat.end());
+    double sum = 0;
+    for(double l: lat) sum += l;
+    printf("%-28s %10.1f %10.1f %10.1f\n", name, sum / lat.size(),
+        lat[lat.size() / 2], lat[lat.size() * 99 / 100]);
+}
+
+int main(int argc, char** argv){
+    int n = argc > 1 ? atoi(argv[1]) : 200;
+    FILE* devnull = fopen("/dev/null", "w");
+
+    if(!devnull) return EXIT_FAILURE;
+    signal(SIGPIPE, SIG_IGN);
+    logger::set_output(devnull);
+
+    bench_calls(devnull, 1000000);
+
+    printf("\n%-28s %10s %10s %10s\n", "handshake", "mean us", "p50 us", "p99 us");
+    bench_handshakes("logging off", SEATS_LOG_OFF, n);
+    bench_handshakes("default (INFO)", SEATS_LOG_INFO, n);
+    bench_handshakes("TRACE", SEATS_LOG_TRACE, n);
+
+    logger::set_output(stderr);
+    fclose(devnull);
+    return EXIT_SUCCESS;
+}
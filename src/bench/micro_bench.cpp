@@ -0,0 +1,199 @@
+// Per operation cost of every step of the attestation codec and crypto on
+// the handshake path: ns/op, heap allocations/op and allocated bytes/op,
+// counted for operator new and for OpenSSL (CRYPTO_set_mem_functions).
+// Each case runs a warm up and then several repetitions, the table shows
+// the median and minimum ns/op and the spread between repetitions.
+//
+//   micro_bench [iterations] [repetitions]
+//
+// Payloads have the sizes of a real handshake: RSA-4096 identity key and
+// signature, 64 byte mock cert blob and the 6.4 KB VCEK + ASK + ARK PEM
+// blob of an SNP guest.
+#include "attest/sev/sev_structs.hpp"
+#include "ssl_ext/attestation_ext_structs.hpp"
+#include "ssl_ext/evidence_ext_structs.hpp"
+#include "ssl_ext/handshake_arena.hpp"
+#include "alloc_counter.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <openssl/evp.h>
+#include <vector>
+
+using namespace seats;
+using bench_clock = std::chrono::steady_clock;
+
+#define MOCK_CERT_LEN 64
+#define SNP_CERT_LEN 6400
+#define RSA4096_SIG_LEN 512
+
+static size_t iterations;
+static size_t repetitions;
+
+// Runs fn iters times per repetition, iters is scaled down for slow cases
+template<typename F>
+static void run(const char* name, size_t iters, F fn){
+    std::vector<double> ns;
+    size_t allocs = 0, bytes = 0;
+
+    iters = std::max<size_t>(iters, 1);
+    for(size_t i = 0; i < std::max<size_t>(iters / 10, 1); i++)
+        fn();
+
+    for(size_t r = 0; r < repetitions; r++){
+        alloc_counter c0 = alloc_counter::now();
+        auto t0 = bench_clock::now();
+        for(size_t i = 0; i < iters; i++)
+            fn();
+        auto t1 = bench_clock::now();
+        ns.push_back(std::chrono::duration<double, std::nano>(t1 - t0).count() / iters);
+        alloc_counter c1 = alloc_counter::now();
+        allocs += c1.allocs - c0.allocs;
+        bytes += c1.alloc_bytes - c0.alloc_bytes;
+    }
+
+    std::sort(ns.begin(), ns.end());
+    double mean = 0, var = 0;
+    for(double v : ns)
+        mean += v / ns.size();
+    for(double v : ns)
+        var += (v - mean) * (v - mean) / ns.size();
+
+    printf("%-36s %12.1f %12.1f %7.1f%% %9.2f %10.1f\n", name, ns[ns.size() / 2], ns[0],
+        mean ? 100 * std::sqrt(var) / mean : 0,
+        (double)allocs / (iters * repetitions), (double)bytes / (iters * repetitions));
+}
+
+static EvidenceRequestClient make_erq(size_t cached){
+    EvidenceRequestClient erq;
+    EvidenceType et;
+
+    et.credential_kind = CredentialKind::ATTESTATION;
+    et.type_encoding = TypeEncoding::CONTENT_FORMAT;
+    et.supported_content.content_format = ContentFormat::BINARY_FORMAT;
+    erq.supported_evidence_types.push_back(et);
+    erq.nonce = 0x1234567890;
+    for(size_t i = 0; i < cached; i++){
+        cert_hash h;
+        h.fill((unsigned char)i);
+        erq.cached_cert_hashes.push_back(h);
+    }
+    return erq;
+}
+
+static void bench_erq(const char* name, size_t cached){
+    EvidenceRequestClient erq = make_erq(cached), rx;
+    std::vector<unsigned char> buff(erq.serialized_size());
+    char label[64];
+
+    erq.serialize(buff.data(), buff.size());
+    snprintf(label, sizeof(label), "%s serialize", name);
+    run(label, iterations, [&]{ erq.serialize(buff.data(), buff.size()); });
+    snprintf(label, sizeof(label), "%s deserialize", name);
+    run(label, iterations, [&]{ rx.deserialize(buff); });
+}
+
+static void bench_evidence(const char* name, size_t certlen){
+    std::vector<char> certs(certlen, 'c');
+    std::vector<char> sig(RSA4096_SIG_LEN, 's');
+    SevEvidencePayload sep, rx_sep;
+    AttestationExtension ax, rx;
+    char label[64];
+
+    memset(&sep.attestation_report, 0xab, sizeof(attestation_report_t));
+    sep.amd_cert_data = certs.data();
+    sep.amd_cert_data_len = certlen;
+    sep.sig = sig.data();
+    sep.siglen = sig.size();
+    ax.attestation_type = AMD_SEV_SNP;
+    ax.evidence_payload = &sep;
+
+    std::vector<unsigned char> pbuff(sep.serialized_size());
+    std::vector<unsigned char> xbuff(ax.serialized_size());
+    sep.serialize(pbuff.data(), pbuff.size());
+    ax.serialize(xbuff.data(), xbuff.size());
+    rx.deserialize(xbuff);
+
+    snprintf(label, sizeof(label), "SevEvidencePayload/%s serialize", name);
+    run(label, iterations, [&]{ sep.serialize(pbuff.data(), pbuff.size()); });
+    snprintf(label, sizeof(label), "SevEvidencePayload/%s deserialize", name);
+    run(label, iterations, [&]{ rx_sep.deserialize(pbuff); });
+    snprintf(label, sizeof(label), "AttestationExt/%s serialize", name);
+    run(label, iterations, [&]{ ax.serialize(xbuff.data(), xbuff.size()); });
+    snprintf(label, sizeof(label), "AttestationExt/%s deserialize", name);
+    run(label, iterations, [&]{ rx.deserialize(xbuff); });
+}
+
+static void bench_digest(const char* name, size_t len){
+    std::vector<char> m(len, 'm');
+    unsigned char dig[EVP_MAX_MD_SIZE];
+    unsigned int diglen;
+
+    run(name, iterations, [&]{ get_sha256_digest(m.data(), m.size(), dig, &diglen); });
+}
+
+int main(int argc, char** argv){
+    // Before OpenSSL allocates anything
+    if(!alloc_counter::install())
+        fprintf(stderr, "OpenSSL allocations are not counted\n");
+
+    iterations = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+    repetitions = std::max<size_t>(argc > 2 ? strtoul(argv[2], NULL, 10) : 7, 1);
+    size_t rsa_iters = iterations / 1000;
+
+    EVP_PKEY* pkey = EVP_RSA_gen(4096);
+    if(!pkey) return EXIT_FAILURE;
+
+    printf("%-36s %12s %12s %8s %9s %10s\n", "op", "median ns", "min ns", "spread", "allocs", "bytes");
+
+    bench_erq("EvidenceRequestClient", 0);
+    bench_erq("EvidenceRequestClient+ci", 1);
+    bench_evidence("mock", MOCK_CERT_LEN);
+    bench_evidence("snp", SNP_CERT_LEN);
+
+    EvidenceRequestClient erq = make_erq(1);
+    std::vector<unsigned char> m(erq.serialized_size());
+    erq.serialize(m.data(), m.size());
+
+    bench_digest("get_sha256_digest request", m.size());
+    bench_digest("get_sha256_digest signature", RSA4096_SIG_LEN);
+    bench_digest("get_sha256_digest snp certs", SNP_CERT_LEN);
+
+    // A valid key attestation: the signature over the request and its
+    // digest in the report data, as the attester produces them
+    arena a;
+    SevEvidencePayload sep;
+    char* sig;
+    unsigned char dig[EVP_MAX_MD_SIZE];
+    unsigned int diglen;
+
+    digest_and_sign(pkey, (char*)m.data(), m.size(), &sig, &sep.siglen, &a);
+    std::vector<char> sig_copy(sig, sig + sep.siglen);
+    sep.sig = sig_copy.data();
+    memset(&sep.attestation_report, 0, sizeof(attestation_report_t));
+    get_sha256_digest(sep.sig, sep.siglen, dig, &diglen);
+    memcpy(sep.attestation_report.report_data, dig, diglen);
+    get_sha256_digest((char*)m.data(), m.size(), dig, &diglen);
+
+    run("digest_and_sign RSA-4096", rsa_iters, [&]{
+        char* s;
+        size_t slen;
+        digest_and_sign(pkey, (char*)m.data(), m.size(), &s, &slen, &a);
+        a.reset();
+    });
+    run("verify_signature RSA-4096", iterations / 50, [&]{
+        verify_signature(pkey, sep.sig, sep.siglen, dig, diglen);
+    });
+    if(!verify_kat(pkey, &sep, &erq)){
+        fprintf(stderr, "verify_kat rejects the generated evidence\n");
+        return EXIT_FAILURE;
+    }
+    run("verify_kat RSA-4096", iterations / 50, [&]{ verify_kat(pkey, &sep, &erq); });
+
+    EVP_PKEY_free(pkey);
+    return EXIT_SUCCESS;
+}
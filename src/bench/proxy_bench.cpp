@@ -0,0 +1,250 @@
+// seats-proxy against a direct connection (mock backend). The same plain
+// TCP backend is reached three ways: directly without TLS, through an
+// in-process attested server that links libseats, and through the
+// seats-proxy binary next to this one. Each path reports round trip
+// latency of small messages and upload throughput.
+//
+//   proxy_bench [round trips] [upload MB]
+#include "seats/seats_client_socket.hpp"
+#include "seats/seats_server_socket.hpp"
+#include "ssl_ext/log.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace seats;
+using bench_clock = std::chrono::steady_clock;
+
+#define BACKEND_PORT 9563
+#define DIRECT_PORT 9564
+#define PROXY_PORT 9565
+#define PING_LEN 64
+#define CHUNK (64 * 1024)
+
+using io_fn = std::function<ssize_t(char*, size_t)>;
+
+// Backend protocol: 'p' echoes everything, 'b' + 8 byte length consumes
+// that many bytes and answers with one byte
+static void serve(io_fn rx, io_fn tx){
+    std::vector<char> buff(CHUNK);
+    char mode;
+    ssize_t n;
+
+    if(rx(&mode, 1) != 1) return;
+    if(mode == 'p'){
+        while((n = rx(buff.data(), buff.size())) > 0)
+            if(tx(buff.data(), n) != n) return;
+        return;
+    }
+
+    uint64_t len = 0, got = 0;
+    while(got < sizeof(len)){
+        if((n = rx((char*)&len + got, sizeof(len) - got)) <= 0) return;
+        got += n;
+    }
+    for(got = 0; got < len; got += n)
+        if((n = rx(buff.data(), std::min<uint64_t>(buff.size(), len - got))) <= 0) return;
+    tx((char*)"k", 1);
+}
+
+static ssize_t rx_all(io_fn& rx, char* data, size_t len){
+    size_t got = 0;
+    while(got < len){
+        ssize_t n = rx(data + got, len - got);
+        if(n <= 0) return -1;
+        got += n;
+    }
+    return got;
+}
+
+static void plain_backend(int lfd){
+    int fd;
+    while((fd = accept(lfd, NULL, NULL)) >= 0){
+        std::thread([fd]{
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            serve([fd](char* d, size_t l){ return ::recv(fd, d, l, 0); },
+                  [fd](char* d, size_t l){ return ::send(fd, d, l, 0); });
+            close(fd);
+        }).detach();
+    }
+}
+
+static void attested_backend(seats_server_socket* srv){
+    seats_socket* s;
+    while((s = srv->accept())){
+        if(s->accept()){
+            delete s;
+            continue;
+        }
+        std::thread([s]{
+            serve([s](char* d, size_t l){ return s->recv(d, l); },
+                  [s](char* d, size_t l){ return s->send(d, l); });
+            delete s;
+        }).detach();
+    }
+}
+
+static int plain_connect(int port){
+    struct sockaddr_in a = {};
+    int one = 1;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    a.sin_family = AF_INET;
+    a.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &a.sin_addr);
+    if(connect(fd, (struct sockaddr*)&a, sizeof(a))){
+        close(fd);
+        return -1;
+    }
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+struct target{
+    const char* name;
+    // Returns send/receive functions over a new connection and a closer
+    std::function<bool(io_fn*, io_fn*, std::function<void()>*)> open;
+};
+
+static void run(target& t, size_t pings, size_t upload){
+    io_fn rx, tx;
+    std::function<void()> done;
+    std::vector<double> rtt;
+    char msg[PING_LEN] = {0};
+
+    if(!t.open(&rx, &tx, &done)){
+        printf("%-22s unable to connect\n", t.name);
+        return;
+    }
+    tx((char*)"p", 1);
+    for(size_t i = 0; i < pings; i++){
+        auto t0 = bench_clock::now();
+        if(tx(msg, PING_LEN) != PING_LEN || rx_all(rx, msg, PING_LEN) < 0) break;
+        rtt.push_back(std::chrono::duration<double, std::micro>(bench_clock::now() - t0).count());
+    }
+    done();
+
+    std::vector<char> chunk(CHUNK, 'x');
+    uint64_t len = upload / CHUNK * CHUNK;
+    char ack;
+    double mbs = 0;
+    if(t.open(&rx, &tx, &done)){
+        auto t0 = bench_clock::now();
+        tx((char*)"b", 1);
+        tx((char*)&len, sizeof(len));
+        for(uint64_t sent = 0; sent < len; sent += CHUNK)
+            if(tx(chunk.data(), CHUNK) != CHUNK) break;
+        if(rx(&ack, 1) == 1)
+            mbs = len / std::chrono::duration<double>(bench_clock::now() - t0).count() / (1 << 20);
+        done();
+    }
+
+    if(rtt.empty()){
+        printf("%-22s no round trips\n", t.name);
+        return;
+    }
+    std::sort(rtt.begin(), rtt.end());
+    printf("%-22s %10.1f %10.1f %10.1f %10.1f\n", t.name,
+        rtt[rtt.size() / 2], rtt[rtt.size() * 99 / 100], rtt.back(), mbs);
+}
+
+static bool attested_open(int port, io_fn* rx, io_fn* tx, std::function<void()>* done){
+    seats_client_socket* c = new seats_client_socket(true);
+    if(c->connect("127.0.0.1", port)){
+        delete c;
+        return false;
+    }
+    *rx = [c](char* d, size_t l){ return c->recv(d, l); };
+    *tx = [c](char* d, size_t l){ return c->send(d, l); };
+    *done = [c]{ delete c; };
+    return true;
+}
+
+int main(int argc, char** argv){
+    size_t pings = argc > 1 ? strtoul(argv[1], NULL, 10) : 20000;
+    size_t upload = (argc > 2 ? strtoul(argv[2], NULL, 10) : 256) << 20;
+    std::string dir(argv[0]);
+    std::string proxy = dir.substr(0, dir.rfind('/') + 1) + "seats-proxy";
+    std::string backend = "127.0.0.1:" + std::to_string(BACKEND_PORT);
+    std::string port = std::to_string(PROXY_PORT);
+    int one = 1;
+
+    signal(SIGPIPE, SIG_IGN);
+
+    int lfd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in a = {};
+    a.sin_family = AF_INET;
+    a.sin_port = htons(BACKEND_PORT);
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if(bind(lfd, (struct sockaddr*)&a, sizeof(a)) || listen(lfd, SOMAXCONN)){
+        perror("backend");
+        return EXIT_FAILURE;
+    }
+    std::thread(plain_backend, lfd).detach();
+
+    seats_server_socket srv(DIRECT_PORT, true);
+    if(srv.get_status()) return EXIT_FAILURE;
+    std::thread(attested_backend, &srv).detach();
+
+    std::vector<target> targets = {
+        {"tcp direct", [](io_fn* rx, io_fn* tx, std::function<void()>* done){
+            int fd = plain_connect(BACKEND_PORT);
+            if(fd < 0) return false;
+            *rx = [fd](char* d, size_t l){ return ::recv(fd, d, l, 0); };
+            *tx = [fd](char* d, size_t l){ return ::send(fd, d, l, 0); };
+            *done = [fd]{ close(fd); };
+            return true;
+        }},
+        {"attested in-process", [](io_fn* rx, io_fn* tx, std::function<void()>* done){
+            return attested_open(DIRECT_PORT, rx, tx, done);
+        }},
+        {"attested seats-proxy", [](io_fn* rx, io_fn* tx, std::function<void()>* done){
+            return attested_open(PROXY_PORT, rx, tx, done);
+        }},
+    };
+
+    printf("%-22s %10s %10s %10s %10s\n", "path", "p50 us", "p99 us", "max us", "up MB/s");
+    run(targets[0], pings, upload);
+    run(targets[1], pings, upload);
+
+    // Started last, its attester replaces the certificate and key files
+    // the in-process server loads for every connection
+    pid_t pid = fork();
+    if(!pid){
+        // The readiness probe below fails a handshake on purpose
+        setenv("SEATS_LOG", "error", 1);
+        prctl(PR_SET_PDEATHSIG, SIGTERM);
+        execl(proxy.c_str(), "seats-proxy", "-m", "-t", "1", port.c_str(), backend.c_str(), (char*)NULL);
+        perror("exec seats-proxy");
+        _exit(EXIT_FAILURE);
+    }
+    for(int i = 0, fd; i < 100; i++){
+        if((fd = plain_connect(PROXY_PORT)) >= 0){
+            close(fd);
+            break;
+        }
+        usleep(50000);
+    }
+    run(targets[2], pings, upload);
+
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,92 @@
+// Small message throughput over a loopback attested connection (mock
+// backend): a 16 byte header plus a 240 byte body written with two send
+// calls, with one sendv, and with sendv while corked. The last row is a
+// 64 MB buffer in a single send.
+#include "seats/seats_client_socket.hpp"
+#include "seats/seats_server_socket.hpp"
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <thread>
+#include <vector>
+
+using namespace seats;
+using bench_clock = std::chrono::steady_clock;
+
+#define BENCH_PORT 9562
+#define HEADER_LEN 16
+#define BODY_LEN 240
+
+// Receives len bytes and acknowledges them with one byte
+static void sink(seats_socket* s, size_t len){
+    std::vector<char> buff(1 << 16);
+    size_t got = 0;
+    while(got < len){
+        ssize_t n = s->recv(buff.data(), buff.size());
+        if(n <= 0) return;
+        got += n;
+    }
+    s->send("k", 1);
+}
+
+static void run(const char* name, seats_socket* srv_skt, seats_socket* cl, size_t len,
+        std::function<void()> writer){
+    char ack;
+    std::thread rx(sink, srv_skt, len);
+    auto t0 = bench_clock::now();
+    writer();
+    cl->recv(&ack, 1);
+    auto t1 = bench_clock::now();
+    rx.join();
+
+    double s = std::chrono::duration<double>(t1 - t0).count();
+    printf("%-24s %12.0f %10.1f\n", name, len / (HEADER_LEN + BODY_LEN) / s, len / s / (1 << 20));
+}
+
+int main(int argc, char** argv){
+    size_t msgs = argc > 1 ? strtoul(argv[1], NULL, 10) : 200000;
+    size_t len = msgs * (HEADER_LEN + BODY_LEN);
+    char header[HEADER_LEN] = {0};
+    std::vector<char> body(BODY_LEN, 'b');
+    std::vector<char> bulk(64 << 20, 'x');
+    struct iovec iov[2] = {{header, HEADER_LEN}, {body.data(), BODY_LEN}};
+
+    signal(SIGPIPE, SIG_IGN);
+    seats_server_socket srv(BENCH_PORT, true);
+    seats_socket* srv_skt = NULL;
+    std::thread acceptor([&]{
+        srv_skt = srv.accept();
+        if(srv_skt) srv_skt->accept();
+    });
+    seats_client_socket cl(true);
+    if(cl.connect("127.0.0.1", BENCH_PORT)) return EXIT_FAILURE;
+    acceptor.join();
+    if(!srv_skt) return EXIT_FAILURE;
+
+    printf("%-24s %12s %10s\n", "write pattern", "msgs/s", "MB/s");
+    run("send header + body", srv_skt, &cl, len, [&]{
+        for(size_t i = 0; i < msgs; i++){
+            cl.send(header, HEADER_LEN);
+            cl.send(body.data(), BODY_LEN);
+        }
+    });
+    run("sendv", srv_skt, &cl, len, [&]{
+        for(size_t i = 0; i < msgs; i++)
+            cl.sendv(iov, 2);
+    });
+    run("sendv corked", srv_skt, &cl, len, [&]{
+        cl.cork();
+        for(size_t i = 0; i < msgs; i++)
+            cl.sendv(iov, 2);
+        cl.cork(false);
+    });
+    run("send 64 MB", srv_skt, &cl, bulk.size() / (HEADER_LEN + BODY_LEN) * (HEADER_LEN + BODY_LEN), [&]{
+        cl.send(bulk.data(), bulk.size() / (HEADER_LEN + BODY_LEN) * (HEADER_LEN + BODY_LEN));
+    });
+
+    delete srv_skt;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,180 @@
+// Long running leak check: attested handshakes (mock backend) one after
+// the other between a client and a server thread of this process. Every
+// heap allocation, operator new and OpenSSL (CRYPTO_set_mem_functions), is
+// counted, live bytes use malloc_usable_size. A line per interval shows
+// the rate, RSS and allocations per handshake. After the warm up (key
+// generation, per thread contexts, caches) the number of live allocations
+// must not grow, and neither may the live bytes (a realloc grows a block
+// without adding an allocation), the run fails if they do. Every -a th
+// connection sends garbage instead of a ClientHello so the server's
+// failure path is covered too.
+//
+// Only the mock attester and verifier are soaked, the SEV backend runs
+// snpguest/sev-tool and has to be checked on an SNP host.
+//
+//   soak_bench [-n handshakes] [-d max seconds] [-w warm up] [-i report every] [-a abort every]
+#include "seats/seats_client_socket.hpp"
+#include "seats/seats_server_socket.hpp"
+#include "ssl_ext/log.hpp"
+#include "alloc_counter.hpp"
+
+#include <arpa/inet.h>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace seats;
+using bench_clock = std::chrono::steady_clock;
+
+#define BENCH_PORT 9567
+
+static long rss_kb(){
+    long pages = 0, resident = 0;
+    FILE* f = fopen("/proc/self/statm", "r");
+    if(f){
+        if(fscanf(f, "%ld %ld", &pages, &resident) != 2) resident = 0;
+        fclose(f);
+    }
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+// Handshakes the server finished, the client waits for it before reading
+// the counters so no connection is half torn down
+static std::mutex served_lock;
+static std::condition_variable served_cv;
+static uint64_t served = 0;
+
+static void serve(seats_server_socket* srv){
+    seats_socket* s;
+    while((s = srv->accept())){
+        s->accept();
+        delete s;
+        std::lock_guard<std::mutex> lk(served_lock);
+        served++;
+        served_cv.notify_all();
+    }
+}
+
+static void wait_served(uint64_t n){
+    std::unique_lock<std::mutex> lk(served_lock);
+    served_cv.wait(lk, [n]{ return served >= n; });
+}
+
+static void abort_one(){
+    struct sockaddr_in a = {};
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    a.sin_family = AF_INET;
+    a.sin_port = htons(BENCH_PORT);
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if(!connect(fd, (struct sockaddr*)&a, sizeof(a)))
+        send(fd, "garbage\n", 8, 0);
+    close(fd);
+}
+
+int main(int argc, char** argv){
+    uint64_t total = 1000000, warmup = 200, every = 1000, abort_every = 10;
+    double max_seconds = 0;
+    int opt;
+
+    // Before OpenSSL allocates anything
+    if(!alloc_counter::install()){
+        fprintf(stderr, "Unable to count OpenSSL allocations\n");
+        return EXIT_FAILURE;
+    }
+
+    while((opt = getopt(argc, argv, "n:d:w:i:a:")) != -1){
+        switch (opt) {
+            case 'n': total = strtoull(optarg, NULL, 10); break;
+            case 'd': max_seconds = atof(optarg); break;
+            case 'w': warmup = strtoull(optarg, NULL, 10); break;
+            case 'i': every = std::max(1ull, strtoull(optarg, NULL, 10)); break;
+            case 'a': abort_every = strtoull(optarg, NULL, 10); break;
+            default:
+                fprintf(stderr, "Usage: soak_bench [-n handshakes] [-d max seconds] [-w warm up] [-i report every] [-a abort every]\n");
+                return EXIT_FAILURE;
+        }
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    // Aborted handshakes are expected, and formatting errors would count
+    logger::set_level(SEATS_LOG_OFF);
+
+    seats_server_socket srv(BENCH_PORT, true);
+    if(srv.get_status()){
+        fprintf(stderr, "Unable to listen on port %d\n", BENCH_PORT);
+        return EXIT_FAILURE;
+    }
+    std::thread server(serve, &srv);
+    seats_client_socket cl(true);
+
+    uint64_t done = 0, failed = 0;
+    auto connect_one = [&]{
+        if(abort_every && done % abort_every == abort_every - 1){
+            abort_one();
+        }
+        else{
+            if(cl.connect("127.0.0.1", BENCH_PORT)) failed++;
+            cl.close();
+        }
+        wait_served(++done);
+    };
+
+    for(uint64_t i = 0; i < warmup; i++)
+        connect_one();
+
+    alloc_counter base = alloc_counter::now(), last = base;
+    long base_rss = rss_kb();
+    auto t0 = bench_clock::now(), tl = t0;
+    uint64_t measured = 0, last_measured = 0;
+
+    printf("%10s %8s %8s %10s %12s %12s %10s %12s\n", "handshakes", "secs", "hs/s", "rss KB",
+        "allocs/hs", "bytes/hs", "net live", "net bytes");
+    while(measured < total){
+        connect_one();
+        measured++;
+        bool stop = max_seconds > 0
+            && std::chrono::duration<double>(bench_clock::now() - t0).count() >= max_seconds;
+
+        if(measured % every == 0 || measured == total || stop){
+            alloc_counter c = alloc_counter::now();
+            auto tn = bench_clock::now();
+            uint64_t n = measured - last_measured;
+            printf("%10lu %8.0f %8.1f %10ld %12.1f %12.1f %10ld %12ld\n",
+                (unsigned long)measured, std::chrono::duration<double>(tn - t0).count(),
+                n / std::chrono::duration<double>(tn - tl).count(), rss_kb(),
+                (double)(c.allocs - last.allocs) / n, (double)(c.alloc_bytes - last.alloc_bytes) / n,
+                (long)(c.live - base.live), (long)(c.live_bytes - base.live_bytes));
+            fflush(stdout);
+            last = c;
+            tl = tn;
+            last_measured = measured;
+        }
+        if(stop) break;
+    }
+
+    alloc_counter end = alloc_counter::now();
+    int64_t net = end.live - base.live;
+    int64_t net_bytes = end.live_bytes - base.live_bytes;
+
+    printf("%lu handshakes, %lu failed, net %+.4f allocations and %+.1f bytes per handshake, rss %+ld KB\n",
+        (unsigned long)measured, (unsigned long)failed, (double)net / measured,
+        (double)net_bytes / measured, rss_kb() - base_rss);
+
+    shutdown(srv.get_fd(), SHUT_RDWR);
+    server.join();
+
+    if(failed || net > 0 || net_bytes > 0){
+        printf("FAIL: %s\n", failed ? "handshakes failed" : net > 0 ? "allocations leak" : "live bytes grow");
+        return EXIT_FAILURE;
+    }
+    printf("PASS\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,105 @@
+// Throughput of verifier::verify against sev_verifier::verify_batch, in
+// reports per second for growing batch sizes. Uses the mock SEV backend so
+// the numbers cover the library work (grouping, KAT signature checks) and
+// not the snpguest subprocesses.
+#include "attest/mock/sev/mock_sev_attester.hpp"
+#include "attest/mock/sev/mock_sev_verifier.hpp"
+#include "attest/sev/sev_structs.hpp"
+#include "attest/work_pool.hpp"
+#include "seats/seats_types.hpp"
+#include "ssl_ext/attestation_ext_structs.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#include <vector>
+
+using namespace seats;
+using bench_clock = std::chrono::steady_clock;
+
+// Returns the serialized evidence payload, as the client would receive it
+static std::vector<unsigned char> make_payload(mock_sev_attester& att, EvidenceRequestClient& erq){
+    arena a;
+    std::vector<unsigned char> req(erq.serialized_size());
+    erq.serialize(req.data(), req.size());
+    att.set_data(req.data(), req.size(), &a);
+    att.sign_request();
+    att.attest();
+
+    AttestationExtension ax;
+    att.getResult(&ax);
+    std::vector<unsigned char> ext(ax.serialized_size());
+    ax.serialize(ext.data(), ext.size());
+
+    AttestationExtension rx;
+    rx.deserialize(ext);
+    return std::vector<unsigned char>(rx.evidence_data.begin(), rx.evidence_data.end());
+}
+
+static EVP_PKEY* load_server_pubkey(){
+    FILE* f = fopen(SEATS_CERT_FILE_PATH, "rb");
+    if(!f) return NULL;
+    X509* x509 = PEM_read_X509(f, NULL, NULL, NULL);
+    fclose(f);
+    if(!x509) return NULL;
+    EVP_PKEY* pkey = X509_get_pubkey(x509);
+    X509_free(x509);
+    return pkey;
+}
+
+int main(int argc, char** argv){
+    size_t max_batch = argc > 1 ? strtoul(argv[1], NULL, 10) : 1024;
+
+    mock_sev_attester att;
+    EVP_PKEY* pkey = load_server_pubkey();
+    if(!pkey){
+        fprintf(stderr, "Unable to load server public key from %s\n", SEATS_CERT_FILE_PATH);
+        return EXIT_FAILURE;
+    }
+
+    // Every report gets its own nonce, like reports coming from many nodes
+    std::vector<EvidenceRequestClient> erqs(max_batch);
+    std::vector<std::vector<unsigned char>> payloads(max_batch);
+    std::vector<evidence> batch(max_batch);
+    EvidenceType et;
+    et.credential_kind = CredentialKind::ATTESTATION;
+    et.type_encoding = TypeEncoding::CONTENT_FORMAT;
+    et.supported_content.content_format = ContentFormat::BINARY_FORMAT;
+
+    for(size_t i = 0; i < max_batch; i++){
+        erqs[i].supported_evidence_types.push_back(et);
+        erqs[i].nonce = rand();
+        batch[i].erq = &erqs[i];
+        payloads[i] = make_payload(att, erqs[i]);
+        batch[i].data = payloads[i].data();
+        batch[i].len = payloads[i].size();
+        batch[i].pkey = pkey;
+    }
+
+    printf("# pool threads: %u\n", work_pool::shared().size());
+    printf("%10s %16s %16s\n", "batch", "serial rep/s", "batch rep/s");
+
+    for(size_t n = 1; n <= max_batch; n *= 4){
+        std::span<evidence> sub(batch.data(), n);
+        mock_sev_verifier v;
+
+        auto t0 = bench_clock::now();
+        for(evidence& e: sub){
+            v.set_erq(e.erq);
+            v.set_data(e.data, e.len);
+            v.verify(e.pkey);
+        }
+        auto t1 = bench_clock::now();
+        v.verify_batch(sub);
+        auto t2 = bench_clock::now();
+
+        double serial = std::chrono::duration<double>(t1 - t0).count();
+        double batched = std::chrono::duration<double>(t2 - t1).count();
+        printf("%10zu %16.0f %16.0f\n", n, n / serial, n / batched);
+    }
+
+    EVP_PKEY_free(pkey);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,197 @@
+// libFuzzer harness for the decoders of the attestation extensions, which
+// parse attacker controlled bytes from the ClientHello and the Certificate.
+// Every input goes through the generic cbor::reader walk and through each
+// message decoder. Whatever decodes has to encode back to the same bytes,
+// the encoding is deterministic and the client relies on that for the KAT.
+//
+//   make fuzz && target/bin/cbor_fuzz -max_total_time=60 corpus/
+//
+// Without clang, -DSEATS_FUZZ_DRIVER adds a main that mutates built in
+// seeds (make fuzz FUZZCXX=g++ FUZZFLAGS="-fsanitize=address,undefined
+// -DSEATS_FUZZ_DRIVER"), then: cbor_fuzz [iterations | files...]
+#include "attest/sev/sev_structs.hpp"
+#include "ssl_ext/attestation_ext_structs.hpp"
+#include "ssl_ext/cbor.hpp"
+#include "ssl_ext/evidence_ext_structs.hpp"
+#include "ssl_ext/log.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <span>
+#include <vector>
+
+using namespace seats;
+
+// Some decoder accepted the last input, the driver keeps it as a seed
+static bool decoded;
+
+// Nesting is bounded by the input, every item takes at least one byte
+static void walk(cbor::reader& r, int depth){
+    uint64_t v;
+    int64_t i;
+    size_t n;
+    const char* s;
+    std::span<const unsigned char> b;
+
+    if(depth > 64){
+        r.ok = false;
+        return;
+    }
+    switch (r.peek()) {
+        case cbor::UINT: r.uint(&v); break;
+        case cbor::NINT: r.sint(&i); break;
+        case cbor::BSTR: r.bytes(&b); break;
+        case cbor::TSTR: r.text(&s, &n); break;
+        case cbor::ARRAY:
+            if(!r.array(&n)) return;
+            for(size_t k = 0; k < n && r.ok; k++)
+                walk(r, depth + 1);
+            break;
+        default:
+            r.ok = false;
+    }
+}
+
+template<typename T>
+static void round_trip(const T& m, std::span<const unsigned char> in, int len, const char* name){
+    std::vector<unsigned char> out(m.serialized_size());
+
+    if(m.serialize(out.data(), out.size()) != len || memcmp(out.data(), in.data(), len)){
+        fprintf(stderr, "%s does not encode back to its input\n", name);
+        abort();
+    }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size){
+    std::span<const unsigned char> in(data, size);
+    int len;
+
+    cbor::reader r(in);
+    while(r.ok && r.p < r.end)
+        walk(r, 0);
+
+    decoded = false;
+    EvidenceRequestClient erq;
+    if((len = erq.deserialize(in)) >= 0){
+        round_trip(erq, in, len, "EvidenceRequestClient");
+        decoded = true;
+    }
+
+    AttestationExtension ax;
+    ax.evidence_payload = NULL;
+    if((len = ax.deserialize(in)) >= 0){
+        decoded = true;
+        SevEvidencePayload sep;
+        if((len = sep.deserialize(ax.evidence_data)) >= 0)
+            round_trip(sep, ax.evidence_data, len, "SevEvidencePayload");
+    }
+
+    SevEvidencePayload sep;
+    if((len = sep.deserialize(in)) >= 0){
+        round_trip(sep, in, len, "SevEvidencePayload");
+        decoded = true;
+    }
+    return 0;
+}
+
+extern "C" int LLVMFuzzerInitialize(int*, char***){
+    logger::set_level(SEATS_LOG_OFF);
+    return 0;
+}
+
+#ifdef SEATS_FUZZ_DRIVER
+
+#define SEATS_FUZZ_CORPUS_MAX 4096
+
+static std::vector<std::vector<unsigned char>> seeds(){
+    std::vector<std::vector<unsigned char>> out;
+    EvidenceRequestClient erq;
+    EvidenceType et;
+    static char media_type[] = "application/eat+cwt";
+
+    et.credential_kind = CredentialKind::ATTESTATION;
+    et.type_encoding = TypeEncoding::CONTENT_FORMAT;
+    et.supported_content.content_format = ContentFormat::BINARY_FORMAT;
+    erq.supported_evidence_types.push_back(et);
+    et.type_encoding = TypeEncoding::MEDIA_TYPE;
+    et.supported_content.media_type = media_type;
+    et.media_type_len = sizeof(media_type) - 1;
+    erq.supported_evidence_types.push_back(et);
+    erq.nonce = -123456789;
+    erq.cached_cert_hashes.push_back({});
+    out.emplace_back(erq.serialized_size());
+    erq.serialize(out.back().data(), out.back().size());
+
+    static char certs[300], sig[512];
+    SevEvidencePayload sep;
+    memset(&sep.attestation_report, 0x5a, sizeof(sep.attestation_report));
+    sep.amd_cert_data = certs;
+    sep.amd_cert_data_len = sizeof(certs);
+    sep.sig = sig;
+    sep.siglen = sizeof(sig);
+    out.emplace_back(sep.serialized_size());
+    sep.serialize(out.back().data(), out.back().size());
+    sep.amd_cert_cached = true;
+    out.emplace_back(sep.serialized_size());
+    sep.serialize(out.back().data(), out.back().size());
+
+    AttestationExtension ax;
+    ax.attestation_type = AMD_SEV_SNP;
+    ax.evidence_payload = &sep;
+    out.emplace_back(ax.serialized_size());
+    ax.serialize(out.back().data(), out.back().size());
+    return out;
+}
+
+static void mutate(std::vector<unsigned char>& b){
+    int n = 1 + rand() % 4;
+
+    while(n--){
+        switch (rand() % 5) {
+            case 0: if(!b.empty()) b[rand() % b.size()] ^= 1 << (rand() % 8); break;
+            case 1: if(!b.empty()) b[rand() % b.size()] = rand(); break;
+            case 2: if(!b.empty()) b.resize(rand() % b.size()); break;
+            case 3: b.insert(b.begin() + (b.empty() ? 0 : rand() % b.size()), (unsigned char)rand()); break;
+            case 4: if(!b.empty()) b.erase(b.begin() + rand() % b.size()); break;
+        }
+    }
+}
+
+int main(int argc, char** argv){
+    LLVMFuzzerInitialize(&argc, &argv);
+
+    if(argc > 1 && !atol(argv[1])){
+        for(int i = 1; i < argc; i++){
+            std::vector<unsigned char> b;
+            FILE* f = fopen(argv[i], "rb");
+            int c;
+            if(!f){
+                perror(argv[i]);
+                return EXIT_FAILURE;
+            }
+            while((c = fgetc(f)) != EOF)
+                b.push_back(c);
+            fclose(f);
+            LLVMFuzzerTestOneInput(b.data(), b.size());
+        }
+        return EXIT_SUCCESS;
+    }
+
+    long iterations = argc > 1 ? atol(argv[1]) : 1000000;
+    std::vector<std::vector<unsigned char>> corpus = seeds();
+    srand(1);
+    for(auto& s : corpus)
+        LLVMFuzzerTestOneInput(s.data(), s.size());
+    for(long i = 0; i < iterations; i++){
+        std::vector<unsigned char> b = corpus[rand() % corpus.size()];
+        mutate(b);
+        LLVMFuzzerTestOneInput(b.data(), b.size());
+        if(decoded && corpus.size() < SEATS_FUZZ_CORPUS_MAX) corpus.push_back(b);
+    }
+    printf("%ld inputs, %zu seeds\n", iterations, corpus.size());
+    return EXIT_SUCCESS;
+}
+
+#endif
@@ -15,9 +15,7 @@ void attester::set_cred_kind(CredentialKind cred_kind){
     this->cred_kind = cred_kind;
 }
 
-AttestationExtension* attester::getResult(){
-    AttestationExtension* ax = new AttestationExtension();
+void attester::getResult(AttestationExtension* ax){
     ax->evidence_payload = this->evidence_payload;
     ax->attestation_type = AMD_SEV_SNP;
-    return ax;
 }
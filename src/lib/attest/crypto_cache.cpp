@@ -0,0 +1,73 @@
+#include "attest/crypto_cache.hpp"
+
+#include <openssl/rsa.h>
+
+using namespace seats;
+
+struct pkey_slot{
+    EVP_PKEY* pkey = NULL;
+    EVP_PKEY_CTX* ctx = NULL;
+};
+
+struct thread_ctxs{
+    EVP_MD_CTX* md = NULL;
+    pkey_slot sign[SEATS_CRYPTO_CTX_SLOTS];
+    unsigned sign_next = 0;
+
+    ~thread_ctxs(){
+        EVP_MD_CTX_free(md);
+        for(unsigned i = 0; i < SEATS_CRYPTO_CTX_SLOTS; i++)
+            EVP_PKEY_CTX_free(sign[i].ctx);
+    }
+};
+
+static thread_local thread_ctxs tctx;
+
+EVP_MD* crypto_cache::sha256(){
+    // EVP_sha256() goes through an implicit fetch on every use
+    static EVP_MD* md = EVP_MD_fetch(NULL, "SHA256", NULL);
+    return md;
+}
+
+EVP_MD_CTX* crypto_cache::md_ctx(){
+    if(!tctx.md) tctx.md = EVP_MD_CTX_new();
+    return tctx.md;
+}
+
+static EVP_PKEY_CTX* new_pkey_ctx(EVP_PKEY* pkey, bool sign){
+    EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new_from_pkey(NULL, pkey, NULL);
+    if(!ctx) return NULL;
+
+    if((sign ? EVP_PKEY_sign_init(ctx) : EVP_PKEY_verify_init(ctx)) <= 0
+            || EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_PKCS1_PADDING) <= 0
+            || EVP_PKEY_CTX_set_signature_md(ctx, crypto_cache::sha256()) <= 0){
+        EVP_PKEY_CTX_free(ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+// Signing a digest keeps no state in the context, so an initialized
+// context is reused as is. The slot's context holds a reference on its key,
+// no other key can show up at that address while the slot is in use.
+// Slots are replaced round robin.
+EVP_PKEY_CTX* crypto_cache::sign_ctx(EVP_PKEY* pkey){
+    EVP_PKEY_CTX* ctx;
+    pkey_slot* slot;
+
+    for(unsigned i = 0; i < SEATS_CRYPTO_CTX_SLOTS; i++)
+        if(tctx.sign[i].pkey == pkey) return tctx.sign[i].ctx;
+
+    if(!(ctx = new_pkey_ctx(pkey, true))) return NULL;
+
+    slot = &tctx.sign[tctx.sign_next];
+    tctx.sign_next = (tctx.sign_next + 1) % SEATS_CRYPTO_CTX_SLOTS;
+    EVP_PKEY_CTX_free(slot->ctx);
+    slot->pkey = pkey;
+    slot->ctx = ctx;
+    return ctx;
+}
+
+EVP_PKEY_CTX* crypto_cache::new_verify_ctx(EVP_PKEY* pkey){
+    return new_pkey_ctx(pkey, false);
+}
@@ -0,0 +1,116 @@
+#include "attest/evidence_corpus.hpp"
+#include "ssl_ext/log.hpp"
+
+#include <cstdlib>
+#include <openssl/x509.h>
+
+using namespace seats;
+using namespace seats::cbor;
+
+size_t codec<evidence_record>::size(const evidence_record& m){
+    return head_size(5) + int_size(SEATS_CORPUS_VERSION) + bstr_size(m.erq.size())
+        + bstr_size(m.extension.size()) + bstr_size(m.pubkey.size()) + int_size(m.result);
+}
+
+void codec<evidence_record>::write(writer& w, const evidence_record& m){
+    w.array(5);
+    w.uint(SEATS_CORPUS_VERSION);
+    w.bytes(m.erq);
+    w.bytes(m.extension);
+    w.bytes(m.pubkey);
+    w.sint(m.result);
+}
+
+bool codec<evidence_record>::read(reader& r, evidence_record& m){
+    size_t n;
+    uint64_t version;
+
+    if(!r.array(&n) || n != 5) return false;
+    if(!r.uint(&version) || version != SEATS_CORPUS_VERSION) return false;
+    return r.bytes(&m.erq) && r.bytes(&m.extension) && r.bytes(&m.pubkey) && r.sint(&m.result);
+}
+
+evidence_recorder::evidence_recorder(const char* path){
+    fp = fopen(path, "ab");
+    if(!fp) seats_log_error("Unable to open evidence corpus %s", path);
+}
+
+evidence_recorder::~evidence_recorder(){
+    if(fp) fclose(fp);
+}
+
+bool evidence_recorder::is_open(){ return fp != NULL; }
+
+int evidence_recorder::append(const EvidenceRequestClient* erq, std::span<const unsigned char> extension,
+                              EVP_PKEY* pkey, int result){
+    std::vector<unsigned char> erq_buff(erq->serialized_size());
+    unsigned char* der = NULL;
+    int derlen;
+    evidence_record rec;
+
+    if(!fp) return 1;
+    if(erq->serialize(erq_buff.data(), erq_buff.size()) < 0 || (derlen = i2d_PUBKEY(pkey, &der)) <= 0){
+        seats_log_error("Unable to encode the handshake for the evidence corpus");
+        return 1;
+    }
+
+    rec.erq = erq_buff;
+    rec.extension = extension;
+    rec.pubkey = {der, (size_t)derlen};
+    rec.result = result;
+
+    std::vector<unsigned char> buff(encoded_size(rec));
+    int len = encode(rec, buff.data(), buff.size());
+    OPENSSL_free(der);
+    if(len < 0) return 1;
+
+    // One write per record, readers never see records interleaved
+    std::lock_guard<std::mutex> lk(lock);
+    if(fwrite(buff.data(), 1, len, fp) != (size_t)len || fflush(fp)){
+        seats_log_error("Unable to append to the evidence corpus");
+        return 1;
+    }
+    return 0;
+}
+
+evidence_recorder* evidence_recorder::from_env(){
+    static evidence_recorder* recorder = []() -> evidence_recorder* {
+        const char* path = getenv(SEATS_EVIDENCE_CAPTURE_ENV);
+        if(!path || !*path) return NULL;
+        evidence_recorder* r = new evidence_recorder(path);
+        seats_log_info("Capturing attestation evidence to %s", path);
+        return r;
+    }();
+    return recorder;
+}
+
+int seats::load_evidence_corpus(const char* path, std::vector<unsigned char>* data,
+                                std::vector<evidence_record>* records){
+    FILE* f = fopen(path, "rb");
+    unsigned char chunk[1 << 16];
+    size_t n;
+
+    if(!f){
+        seats_log_error("Unable to open evidence corpus %s", path);
+        return 1;
+    }
+    data->clear();
+    while((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+        data->insert(data->end(), chunk, chunk + n);
+    fclose(f);
+
+    records->clear();
+    std::span<const unsigned char> in(*data);
+    while(!in.empty()){
+        evidence_record rec;
+        int len = decode(rec, in);
+        if(len < 0){
+            // Writer killed in the middle of an append
+            seats_log_warn("Dropping %zu bytes after the last complete record of %s", in.size(), path);
+            break;
+        }
+        records->push_back(rec);
+        in = in.subspan(len);
+    }
+    return 0;
+}
@@ -20,7 +20,7 @@ int seats::mock_sev_attester::attest(){
     SevEvidencePayload* sep = (SevEvidencePayload*) evidence_payload;
 
     if(!sep){
-        perror("Called attest before set_data!");
+        seats_log_error("Called attest before set_data!");
         return 1;
     }
 
@@ -31,9 +31,11 @@ int seats::mock_sev_attester::attest(){
     memcpy(&(sep->attestation_report.report_data), kat, katlen); // KAT IS NOT MOCKED
     
     // Mock cert blob
-    sep->amd_cert_data = new char[64];
-    sep->amd_cert_data_len = 64;
+    static char mock_cert_blob[64];
+    sep->amd_cert_data = mock_cert_blob;
+    sep->amd_cert_data_len = sizeof(mock_cert_blob);
     set_mock_str(sep->amd_cert_data);
+    set_cert_reference();
    
     return 0; 
 }
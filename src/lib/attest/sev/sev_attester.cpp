@@ -1,7 +1,10 @@
 #include "attest/sev/sev_structs.hpp"
+#include "attest/crypto_cache.hpp"
+#include "seats/seats_metrics.hpp"
 #include "seats/seats_types.hpp"
 #include "ssl_ext/evidence_ext_structs.hpp"
 #include "attest/sev/sev_attester.hpp"
+#include "ssl_ext/log.hpp"
 
 #include <cstdint>
 #include <cstring>
@@ -15,34 +18,87 @@ using namespace seats;
 
 EVP_PKEY* sev_attester::pkey = NULL;
 
-sev_attester::sev_attester(): attester::attester(), erq(NULL), kat(NULL), katlen(0){
+sev_attester::sev_attester(): attester::attester(), req(NULL), req_len(0), req_arena(NULL), katlen(0){
     if(!pkey) generate_and_save_cert();
+    // Signing context of the identity key is ready before the first
+    // handshake, on the constructing thread only. Other threads set up
+    // theirs on their first signature.
+    if(pkey) crypto_cache::sign_ctx(pkey);
 
     evidence_payload = new SevEvidencePayload();
     ((SevEvidencePayload*)evidence_payload)->pkey = pkey;
     ((SevEvidencePayload*)evidence_payload)->sig = NULL;
 }
-// TODO IMPLEMENT DESTRUctor
 
 int seats::sev_attester::configure_ssl_ctx(SSL_CTX*){ return 0; }
 
-void seats::sev_attester::set_data(uint8_t* data){
+int seats::sev_attester::set_data(const uint8_t* data, size_t len, arena* a){
     SevEvidencePayload* sep = (SevEvidencePayload*)evidence_payload;
+    int erq_len;
 
-    if(kat) delete []kat;
-    if(sep->sig) delete [](sep->sig); 
+    katlen = 0;
+    sep->sig = NULL;
+    req = NULL;
 
-    erq = new EvidenceRequestClient();
-    size_t len = erq->deserialize((const unsigned char*) data);
-    if(digest_and_sign(pkey, (char*)data, len, &(sep->sig), &(sep->siglen))){
-        perror("Failed to generate signature of sentdata");
-        return;
+    {
+        metric_timer t(metric_phase::REQUEST_PARSE);
+        erq_len = erq.deserialize({data, len});
+    }
+    if(erq_len < 0){
+        seats_log_error("Malformed evidence request");
+        return 1;
     }
 
-    if(get_sha256_digest(sep->sig, sep->siglen, &kat, &katlen)){ 
-        perror("Failed to generate digest of the signature");
-        return;
+    // The ClientHello buffer is gone by the time the request is signed
+    unsigned char* copy = (unsigned char*)a->alloc(erq_len, 1);
+    if(!copy){
+        seats_log_error("Unable to keep the evidence request");
+        return 2;
+    }
+    memcpy(copy, data, erq_len);
+    req = copy;
+    req_len = erq_len;
+    req_arena = a;
+    return 0;
+}
+
+int seats::sev_attester::sign_request(){
+    SevEvidencePayload* sep = (SevEvidencePayload*)evidence_payload;
+
+    if(!req){
+        seats_log_error("Called sign_request before set_data!");
+        return 1;
+    }
+
+    metric_timer t(metric_phase::REQUEST_SIGN);
+    if(digest_and_sign(pkey, (const char*)req, req_len, &(sep->sig), &(sep->siglen), req_arena)){
+        seats_log_error("Failed to generate signature of sentdata");
+        return 2;
+    }
+
+    if(get_sha256_digest(sep->sig, sep->siglen, kat, &katlen)){ 
+        seats_log_error("Failed to generate digest of the signature");
+        return 3;
     } 
+    return 0;
+}
+
+void sev_attester::set_cert_reference(){
+    SevEvidencePayload* sep = (SevEvidencePayload*)evidence_payload;
+
+    sep->amd_cert_cached = false;
+    if(erq.cached_cert_hashes.empty() || !sep->amd_cert_data)
+        return;
+
+    if(get_cert_hash({(const unsigned char*)sep->amd_cert_data, sep->amd_cert_data_len}, &sep->amd_cert_hash))
+        return;
+
+    for(const cert_hash& hash: erq.cached_cert_hashes){
+        if(hash == sep->amd_cert_hash){
+            sep->amd_cert_cached = true;
+            return;
+        }
+    }
 }
 
 void sev_attester::generate_and_save_cert(){ 
@@ -55,37 +111,37 @@ void sev_attester::generate_and_save_cert(){
 
     pkey = (EVP_PKEY*)EVP_RSA_gen(4096);
     if (!pkey){
-        perror("Error while generating private key");
+        seats_log_error("Error while generating private key");
         result = seats_status::UNABLE_TO_GENERATE_PRIVATE_KEY;
         goto end_generate_and_save_certificate;
     }
      
     x509 = X509_new();
     if(!x509){
-        perror("Error while creating x509 struct.");
+        seats_log_error("Error while creating x509 struct.");
         result = seats_status::UNABLE_TO_CREATE_X509;
         goto end_generate_and_save_certificate;
     }
 
     if(!ASN1_INTEGER_set(X509_get_serialNumber(x509), 1)){ 
-        perror("Error while creating x509 struct.");
+        seats_log_error("Error while creating x509 struct.");
         result = seats_status::FAILED_TO_SET_SERIAL_NUMBER;
         goto end_generate_and_save_certificate;
     }
     if(!X509_gmtime_adj(X509_get_notBefore(x509), 0)){
-        perror("Error while setting begin time of cert.");
+        seats_log_error("Error while setting begin time of cert.");
         result = seats_status::FAILED_TO_SET_X509_BEGIN;
         goto end_generate_and_save_certificate;
     }
     
     if(!X509_gmtime_adj(X509_get_notAfter(x509), 31536000L)){
-        perror("Error while setting end time of cert.");
+        seats_log_error("Error while setting end time of cert.");
         result = seats_status::FAILED_TO_SET_X509_END;
         goto end_generate_and_save_certificate;
     }
     
     if(!X509_set_pubkey(x509, pkey)){
-        perror("Error while setting x509 cert public key.");
+        seats_log_error("Error while setting x509 cert public key.");
         result = seats_status::FAILED_TO_SET_X509_PUBKEY;
         goto end_generate_and_save_certificate;
     }
@@ -93,47 +149,47 @@ void sev_attester::generate_and_save_cert(){
     name = X509_get_subject_name(x509);
 
     if(!name){ 
-        perror("Error while getting x509 name.");
+        seats_log_error("Error while getting x509 name.");
         result = seats_status::FAILED_TO_GET_X509_NAME;
         goto end_generate_and_save_certificate;
     }
     
     if(!X509_NAME_add_entry_by_txt(name, "C",  MBSTRING_ASC,
                                (unsigned char *)"CA", -1, -1, 0)){ 
-        perror("Error while setting x509 name 1.");
+        seats_log_error("Error while setting x509 name 1.");
         result = seats_status::FAILED_TO_SET_X509_NAME_1;
         goto end_generate_and_save_certificate;
     }
 
     if(!X509_NAME_add_entry_by_txt(name, "O",  MBSTRING_ASC,
                                (unsigned char *)"MyCompany Inc.", -1, -1, 0)){
-        perror("Error while setting x509 name 2.");
+        seats_log_error("Error while setting x509 name 2.");
         result = seats_status::FAILED_TO_SET_X509_NAME_2;
         goto end_generate_and_save_certificate;
     }
     
     if(!X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
                                (unsigned char *)"localhost", -1, -1, 0)){
-        perror("Error while setting x509 name 3.");
+        seats_log_error("Error while setting x509 name 3.");
         result = seats_status::FAILED_TO_SET_X509_NAME_3;
         goto end_generate_and_save_certificate;
     }
     
     if(!X509_set_issuer_name(x509, name)){
-        perror("Error while setting x509 name 4.");
+        seats_log_error("Error while setting x509 name 4.");
         result = seats_status::FAILED_TO_SET_X509_NAME_4;
         goto end_generate_and_save_certificate;
     }
     
     if(!X509_sign(x509, pkey, EVP_sha1())){ 
-        perror("Error while signing x509 cert.");
+        seats_log_error("Error while signing x509 cert.");
         result = seats_status::FAILED_TO_SIGN_X509;
         goto end_generate_and_save_certificate;
     }
 
     f = fopen(SEATS_KEY_FILE_PATH, "wb");
     if(!f){ 
-        perror("Error opening key file.");
+        seats_log_error("Error opening key file.");
         result = seats_status::FAILED_TO_SIGN_X509;
         goto end_generate_and_save_certificate;
     }
@@ -148,7 +204,7 @@ void sev_attester::generate_and_save_cert(){
             NULL,               /* callback for requesting a password */
             NULL                /* data to pass to the callback */
     )){
-        perror("Error writing key to file.");
+        seats_log_error("Error writing key to file.");
         result = seats_status::FAILED_TO_SIGN_X509;
         goto end_generate_and_save_certificate;
     }
@@ -158,13 +214,13 @@ void sev_attester::generate_and_save_cert(){
     f = fopen(SEATS_CERT_FILE_PATH, "wb");
 
     if(!f){ 
-        perror("Error opening cert file.");
+        seats_log_error("Error opening cert file.");
         result = seats_status::FAILED_TO_SIGN_X509;
         goto end_generate_and_save_certificate;
     }
 
     if (!PEM_write_X509(f, x509)){ 
-        perror("Error writing cert to file.");
+        seats_log_error("Error writing cert to file.");
         result = seats_status::FAILED_TO_SIGN_X509;
         goto end_generate_and_save_certificate;
     }
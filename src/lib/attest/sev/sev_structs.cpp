@@ -1,224 +1,192 @@
 #include"attest/sev/sev_structs.hpp"
+#include "attest/crypto_cache.hpp"
+#include "seats/seats_trace.hpp"
+#include "ssl_ext/cbor.hpp"
 #include "ssl_ext/evidence_ext_structs.hpp"
+#include "ssl_ext/log.hpp"
 #include <cstring>
 #include <openssl/evp.h>
-#include <openssl/rsa.h>
+#include <vector>
 
-int get_sha256_digest(char* m, size_t mlen, char** dig, unsigned int* diglen){
+using namespace seats::cbor;
 
-    EVP_MD_CTX *mdctx;
-    unsigned char md_value[EVP_MAX_MD_SIZE];
+int get_sha256_digest(const char* m, size_t mlen, unsigned char* dig, unsigned int* diglen){
+    EVP_MD_CTX *mdctx = seats::crypto_cache::md_ctx();
 
-    mdctx = EVP_MD_CTX_new();
-    if (!EVP_DigestInit_ex2(mdctx, EVP_sha256(), NULL)) {
-        perror("Message digest initialization failed.\n");
-        EVP_MD_CTX_free(mdctx);
+    if (!mdctx || !EVP_DigestInit_ex2(mdctx, seats::crypto_cache::sha256(), NULL)) {
+        seats_log_error("Message digest initialization failed.");
         return 2;
     }
 
     if (!EVP_DigestUpdate(mdctx, m, mlen)) {
-        printf("Message digest update failed.\n");
-        EVP_MD_CTX_free(mdctx);
+        seats_log_error("Message digest update failed.");
         return 3;
     }
 
-    if (!EVP_DigestFinal_ex(mdctx, md_value, diglen)) {
-        printf("Message digest finalization failed.\n");
-        EVP_MD_CTX_free(mdctx);
+    if (!EVP_DigestFinal_ex(mdctx, dig, diglen)) {
+        seats_log_error("Message digest finalization failed.");
         return 4;
     }
 
-    *dig = new char[*diglen];
-    memcpy(*dig, md_value, *diglen);
-
-    EVP_MD_CTX_free(mdctx);
     return 0; 
 }
 
-int digest_and_sign(EVP_PKEY* pkey, char* m, size_t mlen, char** sig, size_t* siglen){ 
-    char* md;
+int digest_and_sign(EVP_PKEY* pkey, const char* m, size_t mlen, char** sig, size_t* siglen, seats::arena* a){ 
+    unsigned char md[EVP_MAX_MD_SIZE];
     unsigned int mdlen;
+    EVP_PKEY_CTX *ctx;
 
-    if(get_sha256_digest(m, mlen, &md, &mdlen)){
-        perror("Failed to get digest of the message!");
+    if(get_sha256_digest(m, mlen, md, &mdlen)){
+        seats_log_error("Failed to get digest of the message!");
         return 6;
     } 
 
-    EVP_PKEY_CTX *ctx;
-
     // GENERATE SIGN FOR THE ATTESTATION
-    ctx = EVP_PKEY_CTX_new(pkey, NULL /* no engine */);
-    
-     
+    ctx = seats::crypto_cache::sign_ctx(pkey);
     if (ctx == NULL){
-        perror("Signing context failed to initialize.");
+        seats_log_error("Signing context failed to initialize.");
         return 1;
     }
- 
-    if (EVP_PKEY_sign_init(ctx) <= 0){
-        perror("Failed signing initialization.");
-        return 2;
-    }
-    
-    if (EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_PKCS1_PADDING) <= 0){
-        perror("Failed rsa padding setting!");
-        return 3;
-    }
-
-    if (EVP_PKEY_CTX_set_signature_md(ctx, EVP_sha256()) <= 0){
-        perror("Failed signature algorithm setting!");
-        return 4;
-    }
     
     /* Determine sig buffer length */
-    if (EVP_PKEY_sign(ctx, NULL, siglen, (const unsigned char*)m, mlen) <= 0){
-        perror("Getting length did not work!\n");
+    if (EVP_PKEY_sign(ctx, NULL, siglen, md, mdlen) <= 0){
+        seats_log_error("Getting length did not work!");
         return 5;
     }
     
-    *sig = new char[*siglen];
+    *sig = (char*)a->alloc(*siglen, 1);
     
-    if (sig == NULL){
-        perror("");
+    if (*sig == NULL){
+        seats_log_error("Unable to allocate signature buffer");
         return 4;
     }
     
-    if (EVP_PKEY_sign(ctx, (unsigned char*)*sig, siglen, (const unsigned char*)md, (size_t)mdlen) <= 0){
-        perror("Failed signing message.");
-        delete []sig;
+    if (EVP_PKEY_sign(ctx, (unsigned char*)*sig, siglen, md, (size_t)mdlen) <= 0){
+        seats_log_error("Failed signing message.");
+        *sig = NULL;
         return 5;
     }
 
     return 0;
 }
 
-int verify_signature(EVP_PKEY* pkey, char* sig, size_t siglen, char* orig, size_t origlen){
+int verify_signature(EVP_PKEY* pkey, const char* sig, size_t siglen, const unsigned char* orig, size_t origlen){
     EVP_PKEY_CTX *ctx;
+    int result = 0;
  
-    ctx = EVP_PKEY_CTX_new(pkey, NULL /* no engine */);
+    ctx = seats::crypto_cache::new_verify_ctx(pkey);
     if (ctx == NULL){
-        perror("FAILED while creating PKEY CTX!");
+        seats_log_error("FAILED while creating PKEY CTX!");
         return 1;
     }
-    if (EVP_PKEY_verify_init(ctx) <= 0){ 
-        perror("FAILED while verify init");
-        EVP_PKEY_CTX_free(ctx);
-        return 2;
-    }
-    if (EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_PKCS1_PADDING) <= 0){
-        perror("FAILED while adding rsa pkcs padding");
-        EVP_PKEY_CTX_free(ctx);
-        return 3;
-    }
-    
-    if (EVP_PKEY_CTX_set_signature_md(ctx, EVP_sha256()) <= 0){
-        perror("Failed while setting signature algo!");
-        EVP_PKEY_CTX_free(ctx);
-        return 4;
-    }
     
     /* Perform operation */
-    if(!EVP_PKEY_verify(ctx, (const unsigned char*)sig, siglen, (const unsigned char*)orig, origlen)){
-        perror("Failed to verify signature!");
-        EVP_PKEY_CTX_free(ctx);
-        return 5;
+    if(EVP_PKEY_verify(ctx, (const unsigned char*)sig, siglen, orig, origlen) <= 0){
+        seats_log_error("Failed to verify signature!");
+        result = 5;
     }
 
-    return 0;
+    EVP_PKEY_CTX_free(ctx);
+    return result;
 }
 
 bool verify_kat(EVP_PKEY* pkey, SevEvidencePayload* sep, EvidenceRequestClient* erq){
-    const unsigned char* m;
-    size_t mlen = erq->serialize(&m);
+    seats::trace_span t("verify_kat");
+    // Requests are tiny, only unusual media types need the heap
+    unsigned char m_stack[512];
+    std::vector<unsigned char> m_heap;
+    unsigned char* m = m_stack;
+    size_t mlen = erq->serialized_size();
+
+    if(mlen > sizeof(m_stack)){
+        m_heap.resize(mlen);
+        m = m_heap.data();
+    }
+    erq->serialize(m, mlen);
 
-    char* dig;
+    unsigned char dig[EVP_MAX_MD_SIZE];
     unsigned int diglen;
     
-    if(get_sha256_digest((char*)m, mlen, &dig, &diglen)){
-        perror("Failed to generate digest of the client hello extension message");
-        delete []m;
+    if(get_sha256_digest((char*)m, mlen, dig, &diglen)){
+        seats_log_error("Failed to generate digest of the client hello extension message");
         return false;
     }
-    delete []m;
     
     if(verify_signature(pkey, sep->sig, sep->siglen, dig, diglen)){
-        perror("Failed to verify signature of the given TIK!");
-        delete []dig;
+        seats_log_error("Failed to verify signature of the given TIK!");
         return false;
     }
-    delete []dig;
 
-    m = (const unsigned char*)new char[32];
-    memcpy((void*)m, sep->attestation_report.report_data, 32);
-    if(get_sha256_digest(sep->sig, sep->siglen, &dig, &diglen)){
-        perror("Unable to generate hash from signature!");
-        delete []m;
+    if(get_sha256_digest(sep->sig, sep->siglen, dig, &diglen)){
+        seats_log_error("Unable to generate hash from signature!");
         return false;
     }
 
-    if(memcmp(m, dig, diglen)){
-        perror("Hash from attestation report dont match calculated hash of signature!");
-        delete []m;
-        delete []dig;
+    if(memcmp(sep->attestation_report.report_data, dig, diglen)){
+        seats_log_error("Hash from attestation report dont match calculated hash of signature!");
         return false; 
     }
-    delete []m;
-    delete []dig;
 
     return true;
 }
 
-int SevEvidencePayload::serialize(const unsigned char** buff){
-    int len = sizeof(attestation_report_t) 
-        + sizeof(uint64_t) 
-        + amd_cert_data_len 
-        + sizeof(siglen)
-        + siglen;   
-    printf("Allocating buff..\n");
-    *buff = (const unsigned char*)new char[len];
+size_t codec<SevEvidencePayload>::size(const SevEvidencePayload& m){
+    size_t certs_len = m.amd_cert_cached
+        ? head_size(1) + bstr_size(SEATS_CERT_HASH_LEN)
+        : bstr_size(m.amd_cert_data_len);
+    return fixed_size + certs_len + bstr_size(m.siglen);
+}
 
-    char* tmp = (char*)*buff;
+void codec<SevEvidencePayload>::write(writer& w, const SevEvidencePayload& m){
+    w.array(3);
+    w.bytes({(const unsigned char*)&m.attestation_report, sizeof(attestation_report_t)});
+    if(m.amd_cert_cached){
+        w.array(1);
+        w.bytes(m.amd_cert_hash);
+    }
+    else{
+        w.bytes({(const unsigned char*)m.amd_cert_data, m.amd_cert_data_len});
+    }
+    w.bytes({(const unsigned char*)m.sig, m.siglen});
+}
 
-    printf("Setting attestation report..\n");
-    *(attestation_report_t*)tmp = attestation_report;
-    tmp += sizeof(attestation_report_t);
-    
-    printf("Setting cert len..\n");
-    *(uint64_t*)tmp = amd_cert_data_len;
-    tmp += sizeof(amd_cert_data_len);
+bool codec<SevEvidencePayload>::read(reader& r, SevEvidencePayload& m){
+    std::span<const unsigned char> field;
+    size_t n;
 
-    printf("Setting cert data..\n");
-    memcpy(tmp, (const void*)amd_cert_data, amd_cert_data_len);
-    tmp += amd_cert_data_len;
- 
-    printf("Setting signature len..\n");
-    *(size_t*)tmp = siglen;
-    tmp += sizeof(siglen);
+    if(!r.array(&n) || n != 3) return false;
+
+    if(!r.bytes(&field) || field.size() != sizeof(attestation_report_t)) return false;
+    memcpy(&m.attestation_report, field.data(), sizeof(attestation_report_t));
 
-    printf("Setting signature..\n");
-    memcpy(tmp, (const void*)sig, siglen);
-    tmp += siglen;
+    // Cached reference, the verifier resolves it from the cert_cache
+    if(r.peek() == ARRAY){
+        if(!r.array(&n) || n != 1) return false;
+        if(!r.bytes(&field) || field.size() != SEATS_CERT_HASH_LEN) return false;
+        memcpy(m.amd_cert_hash.data(), field.data(), SEATS_CERT_HASH_LEN);
+        m.amd_cert_cached = true;
+        m.amd_cert_data = NULL;
+        m.amd_cert_data_len = 0;
+    }
+    else{
+        if(!r.bytes(&field)) return false;
+        m.amd_cert_cached = false;
+        m.amd_cert_data = (char*)field.data();
+        m.amd_cert_data_len = field.size();
+    }
 
-    return len; 
+    if(!r.bytes(&field)) return false;
+    m.sig = (char*)field.data();
+    m.siglen = field.size();
+    return true;
 }
 
-int SevEvidencePayload::deserialize(const unsigned char* buff){
-    const unsigned char* tmp = buff;
-    attestation_report = *(attestation_report_t*)tmp;
-    tmp += sizeof(attestation_report_t);
-    
-    amd_cert_data_len = *(uint64_t*)tmp;
-    tmp += sizeof(amd_cert_data_len);
+size_t SevEvidencePayload::serialized_size() const{ return encoded_size(*this); }
 
-    amd_cert_data = new char[amd_cert_data_len];
-    memcpy((void*)amd_cert_data, tmp, amd_cert_data_len);
-    tmp += amd_cert_data_len;
- 
-    siglen = *(size_t*)tmp;
-    tmp += sizeof(siglen);
+int SevEvidencePayload::serialize(unsigned char* buff, size_t bufflen) const{
+    return encode(*this, buff, bufflen);
+}
 
-    sig = new char[siglen];
-    memcpy((void*)sig, tmp, siglen);
-    tmp += siglen;
-    return tmp - buff;
+int SevEvidencePayload::deserialize(std::span<const unsigned char> in){
+    return decode(*this, in);
 }
@@ -1,13 +1,139 @@
 #include "attest/sev/sev_verifier.hpp"
 #include "attest/sev/sev_structs.hpp"
+#include "attest/work_pool.hpp"
+#include "seats/seats_metrics.hpp"
+#include "seats/seats_probes.hpp"
+#include "ssl_ext/cached_info.hpp"
 #include "ssl_ext/evidence_ext_structs.hpp"
+#include "ssl_ext/log.hpp"
 
+#include <condition_variable>
 #include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
 
-seats::sev_verifier::sev_verifier(): sep(NULL){}
+// Points a cached cert reference at the blob from the cert_cache, hold
+// keeps it alive while the payload is verified
+static int resolve_certs(SevEvidencePayload* sep, seats::cert_cache* certs, seats::cert_blob* hold){
+    if(!sep->amd_cert_cached) return 0;
 
-seats::sev_verifier::~sev_verifier(){ delete sep; }
+    seats::cert_blob blob = certs ? certs->get(sep->amd_cert_hash) : NULL;
+    if(!blob){
+        seats_log_error("Server referenced AMD certs that are not cached");
+        return 1;
+    }
+    sep->amd_cert_data = (char*)blob->data();
+    sep->amd_cert_data_len = blob->size();
+    *hold = std::move(blob);
 
-void seats::sev_verifier::set_data(uint8_t* data){
-    this->sep = (SevEvidencePayload*)data;
+    size_t saved = seats::cbor::bstr_size(sep->amd_cert_data_len)
+        - seats::cbor::head_size(1) - seats::cbor::bstr_size(SEATS_CERT_HASH_LEN);
+    certs->add_bytes_saved(saved);
+    seats_log_debug("Using cached AMD certs, saved %zu bytes.", saved);
+    return 0;
+}
+
+seats::sev_verifier::sev_verifier(){}
+
+int seats::sev_verifier::set_data(const uint8_t* data, size_t len){
+    metric_timer t(metric_phase::EVIDENCE_PARSE);
+    this->blob.reset();
+    if(this->sep.deserialize({data, len}) < 0) return 1;
+    return resolve_certs(&this->sep, this->certs.get(), &this->blob);
+}
+
+int seats::sev_verifier::verify(EVP_PKEY* pkey){
+    int certs_result, report_result;
+    SEATS_PROBE0(verify_start);
+    {
+        metric_timer t(metric_phase::VERIFY_CERTS);
+        certs_result = verify_certs(&this->sep);
+    }
+    {
+        metric_timer t(metric_phase::VERIFY_REPORT);
+        report_result = verify_report(&this->sep, this->erq, pkey);
+    }
+
+    this->result = report_result ? report_result : certs_result;
+    SEATS_PROBE1(verify_end, this->result);
+
+    // Next handshakes can ask for a reference instead of the blob
+    if(!this->result && !this->sep.amd_cert_cached && this->certs)
+        this->certs->put({(const unsigned char*)sep.amd_cert_data, sep.amd_cert_data_len});
+
+    return this->result;
+}
+
+std::vector<int> seats::sev_verifier::verify_batch(std::span<evidence> batch, verify_batch_cb cb){
+    size_t n = batch.size();
+    std::vector<int> results(n);
+    std::vector<SevEvidencePayload> seps(n);
+    std::vector<cert_blob> blobs(n);
+    std::vector<char> malformed(n, 0);
+    std::vector<size_t> group_of(n);
+    std::vector<int> group_results;
+    std::unordered_map<std::string_view, size_t> groups;
+
+    // GROUP REPORTS BY CERT BLOB (VCEK + ASK + ARK), CHAIN IS CHECKED ONCE PER GROUP
+    for(size_t i = 0; i < n; i++){
+        SevEvidencePayload* s = &seps[i];
+        bool bad;
+        {
+            metric_timer t(metric_phase::EVIDENCE_PARSE);
+            bad = s->deserialize({batch[i].data, batch[i].len}) < 0 || resolve_certs(s, this->certs.get(), &blobs[i]);
+        }
+        if(bad){
+            malformed[i] = 1;
+            continue;
+        }
+        std::string_view blob(s->amd_cert_data, s->amd_cert_data_len);
+
+        auto it = groups.try_emplace(blob, group_results.size());
+        if(it.second){
+            metric_timer t(metric_phase::VERIFY_CERTS);
+            group_results.push_back(verify_certs(s));
+            // Like verify, later handshakes can ask for a reference
+            if(!group_results.back() && !s->amd_cert_cached && this->certs)
+                this->certs->put({(const unsigned char*)s->amd_cert_data, s->amd_cert_data_len});
+        }
+        group_of[i] = it.first->second;
+    }
+
+    // REPORT SIGNATURES AND KATS ARE SPREAD OVER THE POOL
+    std::mutex done_lock;
+    std::condition_variable done_cv;
+    std::vector<char> done(n, 0);
+    work_pool& pool = work_pool::shared();
+
+    auto job = pool.submit(n, [&](size_t i){
+        if(malformed[i]){
+            results[i] = VERIFY_MALFORMED_EVIDENCE;
+        }
+        else{
+            int report_result;
+            {
+                metric_timer t(metric_phase::VERIFY_REPORT);
+                report_result = verify_report(&seps[i], batch[i].erq, batch[i].pkey);
+            }
+            results[i] = report_result ? report_result : group_results[group_of[i]];
+        }
+
+        std::lock_guard<std::mutex> lk(done_lock);
+        done[i] = 1;
+        done_cv.notify_all();
+    });
+
+    // STREAM RESULTS BACK IN BATCH ORDER AS SOON AS THE PREFIX IS DONE
+    for(size_t i = 0; i < n; i++){
+        {
+            std::unique_lock<std::mutex> lk(done_lock);
+            done_cv.wait(lk, [&]{ return done[i] != 0; });
+        }
+        if(cb) cb(i, results[i]);
+    }
+
+    pool.wait(job);
+    return results;
 }
@@ -1,6 +1,7 @@
 #include "attest/sev/tool_attest/cmd/common.hpp"
 #include "attest/sev/tool_attest/cmd/sev_client.hpp"
 #include "attest/sev/tool_attest/sev_tool_attest_utils.hpp"
+#include "ssl_ext/log.hpp"
 #include <cstdio>
 #include <cstring>
 #include <string>
@@ -71,10 +72,7 @@ int verify_measurement(char* measurement, size_t nonce){
     fread((char*)calc_measurement, 96, 1, measurement_file);
 
     if (memcmp(calc_measurement, got_measurement, 96)){
-        printf("\nCALCULATED: ");
-        fwrite(calc_measurement, 96, 1, stdout);
-        fflush(stdout);
-        printf("\n");
+        seats_log_error("MEASUREMENT MISMATCH GOT: %.96s CALCULATED: %.96s", got_measurement, calc_measurement);
         return false;
     }
 
@@ -1,6 +1,7 @@
 #include "attest/sev/tool_attest/cmd/common.hpp"
 #include "attest/sev/tool_attest/cmd/sev_server.hpp"
 #include "attest/sev/tool_attest/sev_tool_attest_utils.hpp"
+#include "ssl_ext/log.hpp"
 #include <cstddef>
 #include <cstring>
 #include <stdio.h>
@@ -22,7 +23,7 @@ int load_cert_blob(char **cert_blob_buff, size_t* bufflen){
     file = fopen(SR_CERT_BLOB_FILE_PATH, "rb");
     if (!file)
     {
-        fprintf(stderr, "Unable to open file %s", SR_CERT_BLOB_FILE_PATH);
+        seats_log_error("Unable to open file %s", SR_CERT_BLOB_FILE_PATH);
         return false;
     }
     
@@ -35,7 +36,7 @@ int load_cert_blob(char **cert_blob_buff, size_t* bufflen){
     buffer=(char *)malloc(fileLen+1);
     if (!buffer)
     {
-        fprintf(stderr, "Memory error!");
+        seats_log_error("Memory error!");
                                 fclose(file);
         return false;
     }
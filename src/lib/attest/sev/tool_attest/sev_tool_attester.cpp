@@ -2,6 +2,8 @@
 #include "attest/sev/sev_attester.hpp"
 #include "attest/sev/sev_structs.hpp"
 #include "attest/sev/tool_attest/cmd/sev_server.hpp"
+#include "seats/seats_trace.hpp"
+#include "ssl_ext/log.hpp"
 #include <cstdlib>
 #include <string.h>
 
@@ -19,30 +21,30 @@ seats::sev_tool_attester::sev_tool_attester(): sev_attester(){
 int seats::sev_tool_attester::attest(){ 
     SevEvidencePayload* sep = (SevEvidencePayload*) evidence_payload;
 
-    printf("checking sep!\n");
     if(!sep){
-        perror("Called attest before set_data!");
+        seats_log_error("Called attest before set_data!");
         return 1;
     }
 
-    printf("alloc buffer!\n");
-    char* buff64 = new char[64];
-
-    printf("seting buffer to 0os\n");
+    char buff64[64];
     memset(buff64, 0, 64);
-
-    printf("copying kat\n");
     memcpy(buff64, kat, katlen);
    
     char* report_data_filename = NULL;
     
-    printf("saving report data\n");
-    save_report_data_file(buff64, &report_data_filename, this->erq->nonce);
-
-    printf("saving and getting attestation report\n");
-    get_attestation_report(&(sep->attestation_report), report_data_filename, this->erq->nonce); 
+    seats_log_debug("Saving report data");
+    {
+        trace_span t("snp.save_report_data");
+        save_report_data_file(buff64, &report_data_filename, this->erq.nonce);
+    }
 
-    printf("finished with adding extension.");
+    seats_log_debug("Getting attestation report");
+    {
+        trace_span t("snp.guest_report");
+        get_attestation_report(&(sep->attestation_report), report_data_filename, this->erq.nonce); 
+    }
+    delete []report_data_filename;
+    set_cert_reference();
 
     return false; 
 }
@@ -4,62 +4,97 @@
 #include "attest/sev/tool_attest/cmd/sev_client.hpp"
 #include "attest/sev/tool_attest/sev_tool_attest_utils.hpp"
 #include "ssl_ext/evidence_ext_structs.hpp"
+#include "seats/seats_trace.hpp"
+#include "ssl_ext/log.hpp"
 #include <cstdio>
 #include <cstring>
+#include <mutex>
+#include <string>
+
+// snpguest/snphost work on fixed file paths, only one report at the time
+static std::mutex snp_tool_lock;
+static std::string exported_certs;
+
+// Waiting for another report is where concurrent verifications queue up
+static std::unique_lock<std::mutex> lock_tools(){
+    seats::trace_span t("snp.lock_wait");
+    return std::unique_lock<std::mutex>(snp_tool_lock);
+}
+
+// Must be called with snp_tool_lock held
+static void export_certs(SevEvidencePayload* sep){
+    if(CERTS_SAVED && exported_certs.size() == sep->amd_cert_data_len
+            && !memcmp(exported_certs.data(), sep->amd_cert_data, sep->amd_cert_data_len))
+        return;
+
+    seats_log_debug("Saving certs...");
+    seats::trace_span t("snp.export_certs");
+    save_certs((const unsigned char*)sep->amd_cert_data, sep->amd_cert_data_len);
+    exported_certs.assign(sep->amd_cert_data, sep->amd_cert_data_len);
+    CERTS_SAVED = true;
+}
 
 seats::sev_tool_verifier::sev_tool_verifier():
     seats::sev_verifier(){}
 
-void seats::sev_tool_verifier::set_data(uint8_t* data){
-    seats::sev_verifier::set_data(data);
+int seats::sev_tool_verifier::verify_certs(SevEvidencePayload* sep){
+    std::unique_lock<std::mutex> lk = lock_tools();
+    export_certs(sep);
+
+    seats_log_debug("Verifying certs...");
+    trace_span t("snp.verify_certs");
+    if (!verify_sev_snp_certs()){
+        seats_log_error("PROVIDED CERTIFICATES INVALID!");
+        return 1;
+    }
+    return 0;
 }
 
-int seats::sev_tool_verifier::verify(EVP_PKEY* pkey){
+int seats::sev_tool_verifier::verify_report(SevEvidencePayload* sep, EvidenceRequestClient* erq, EVP_PKEY* pkey){
     int result = 0;
     char* att_filename = NULL;
 
-    printf("Saving attestation...\n");
-    save_attestation(&(this->sep->attestation_report), &att_filename, this->erq->nonce);
+    {
+        std::unique_lock<std::mutex> lk = lock_tools();
 
-    if(!CERTS_SAVED){
-        printf("Saving certs...\n");
-        save_certs((const unsigned char*)this->sep->amd_cert_data, this->sep->amd_cert_data_len);
-        CERTS_SAVED = true;
-    }
+        // Another group of the batch may have exported its certs meanwhile
+        export_certs(sep);
 
-    printf("Verifying certs...\n");
-    if (!verify_sev_snp_certs()){
-        printf("PROVIDED CERTIFICATES INVALID!\n");
-        result = 1;
-    }
+        seats_log_debug("Saving attestation...");
+        {
+            trace_span t("snp.save_attestation");
+            save_attestation(&(sep->attestation_report), &att_filename, erq->nonce);
+        }
 
-    printf("Verifying att signature..\n");
-    if (!verify_attestation_signature(att_filename)){
-        printf("ATTESTATION SIGNATURE INVALID!\n");
-        result = 2;
-    } 
-
-    printf("Verifying att measurement..\n");
-    if (!verify_measurement((char*)this->sep->attestation_report.measurement, this->erq->nonce)){
-        printf("MEASUREMENT INVALID!\nGOT: ");
-        fwrite(this->sep->attestation_report.measurement, 48, 1, stdout);
-        fflush(stdout);
-        result = 3;
-    }
+        seats_log_debug("Verifying att signature..");
+        {
+            trace_span t("snp.verify_signature");
+            if (!verify_attestation_signature(att_filename)){
+                seats_log_error("ATTESTATION SIGNATURE INVALID!");
+                result = 2;
+            } 
+        }
 
-    printf("Removing attestation file..\n");
-    std::remove(att_filename);
+        seats_log_debug("Verifying att measurement..");
+        {
+            trace_span t("snp.verify_measurement");
+            if (!verify_measurement((char*)sep->attestation_report.measurement, erq->nonce)){
+                seats_log_error("MEASUREMENT INVALID!");
+                result = 3;
+            }
+        }
 
-    printf("Verifying kat..\n");
-    if (!verify_kat(pkey, this->sep, this->erq)){
-        printf("INVALID KAT!");
-        result = 4;
+        seats_log_debug("Removing attestation file..");
+        std::remove(att_filename);
+        delete []att_filename;
     }
 
-    this->result = result;
+    seats_log_debug("Verifying kat..");
+    if (!verify_kat(pkey, sep, erq)){
+        seats_log_error("INVALID KAT!");
+        result = 4;
+    }
 
-    printf("Finished verification..\n");
+    seats_log_debug("Finished verification..");
     return result;
 }
-
-
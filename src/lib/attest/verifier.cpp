@@ -4,11 +4,28 @@
 using namespace seats;
 
 void verifier::set_erq(EvidenceRequestClient* erq){
-    this->erq = erq; 
+    this->erq = erq;
+}
+
+void verifier::set_cert_cache(std::shared_ptr<cert_cache> certs){
+    this->certs = std::move(certs);
 }
 
 int verifier::getResult(){
     return this->result;
 }
 
+std::vector<int> verifier::verify_batch(std::span<evidence> batch, verify_batch_cb cb){
+    std::vector<int> results(batch.size());
 
+    for(size_t i = 0; i < batch.size(); i++){
+        set_erq(batch[i].erq);
+        if(set_data(batch[i].data, batch[i].len))
+            results[i] = VERIFY_MALFORMED_EVIDENCE;
+        else
+            results[i] = verify(batch[i].pkey);
+        if(cb) cb(i, results[i]);
+    }
+
+    return results;
+}
@@ -0,0 +1,125 @@
+#include "attest/work_pool.hpp"
+
+#include <algorithm>
+
+using namespace seats;
+
+// Pool whose worker runs on this thread, if any
+static thread_local work_pool* current_pool = NULL;
+
+work_pool::work_pool(unsigned nthreads): pending(0), generation(0), stopping(false){
+    if(!nthreads) nthreads = std::thread::hardware_concurrency();
+    if(!nthreads) nthreads = 1;
+
+    for(unsigned i = 0; i < nthreads; i++)
+        queues.push_back(std::make_unique<worker_queue>());
+
+    for(unsigned i = 0; i < nthreads; i++)
+        workers.emplace_back(&work_pool::worker_loop, this, i);
+}
+
+work_pool::~work_pool(){
+    {
+        std::unique_lock<std::mutex> lk(state_lock);
+        done_cv.wait(lk, [this]{ return pending == 0; });
+        stopping = true;
+    }
+    work_cv.notify_all();
+    for(std::thread& t: workers)
+        t.join();
+}
+
+work_pool& work_pool::shared(){
+    static work_pool pool;
+    return pool;
+}
+
+unsigned work_pool::size(){ return workers.size(); }
+
+std::shared_ptr<work_pool::job> work_pool::submit(size_t n, std::function<void(size_t)> fn){
+    auto j = std::make_shared<job>();
+    j->fn = std::move(fn);
+    j->pending = 0;
+
+    if(current_pool == this){
+        for(size_t i = 0; i < n; i++)
+            j->fn(i);
+        return j;
+    }
+    if(!n) return j;
+
+    std::lock_guard<std::mutex> lk(state_lock);
+    j->pending = n;
+    pending += n;
+
+    // Contiguous slices keep neighbouring reports on the same core,
+    // stealing evens it out when the slices turn out uneven.
+    size_t slice = (n + queues.size() - 1) / queues.size();
+    for(size_t q = 0, i = 0; q < queues.size(); q++){
+        std::lock_guard<std::mutex> qlk(queues[q]->lock);
+        for(size_t end = std::min(n, i + slice); i < end; i++)
+            queues[q]->tasks.push_back({j, i});
+    }
+
+    generation++;
+    work_cv.notify_all();
+    return j;
+}
+
+void work_pool::wait(const std::shared_ptr<job>& j){
+    std::unique_lock<std::mutex> lk(state_lock);
+    done_cv.wait(lk, [&]{ return j->pending == 0; });
+}
+
+void work_pool::wait(){
+    std::unique_lock<std::mutex> lk(state_lock);
+    done_cv.wait(lk, [this]{ return pending == 0; });
+}
+
+bool work_pool::pop_or_steal(unsigned id, task* t){
+    {
+        worker_queue& own = *queues[id];
+        std::lock_guard<std::mutex> lk(own.lock);
+        if(!own.tasks.empty()){
+            *t = std::move(own.tasks.front());
+            own.tasks.pop_front();
+            return true;
+        }
+    }
+
+    for(size_t i = 1; i < queues.size(); i++){
+        worker_queue& victim = *queues[(id + i) % queues.size()];
+        std::lock_guard<std::mutex> lk(victim.lock);
+        if(!victim.tasks.empty()){
+            *t = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void work_pool::worker_loop(unsigned id){
+    unsigned long seen = 0;
+    task t;
+
+    current_pool = this;
+    while(true){
+        {
+            std::unique_lock<std::mutex> lk(state_lock);
+            work_cv.wait(lk, [&]{ return stopping || generation != seen; });
+            if(stopping) return;
+            seen = generation;
+        }
+
+        while(pop_or_steal(id, &t)){
+            t.owner->fn(t.index);
+
+            std::lock_guard<std::mutex> lk(state_lock);
+            --pending;
+            if(--t.owner->pending == 0)
+                done_cv.notify_all();
+            t.owner.reset();
+        }
+    }
+}
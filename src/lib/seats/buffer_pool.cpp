@@ -0,0 +1,36 @@
+#include "seats/buffer_pool.hpp"
+
+using namespace seats;
+
+buffer_pool& buffer_pool::instance(){
+    static buffer_pool pool;
+    return pool;
+}
+
+buffer_pool::~buffer_pool(){
+    for(char* b: free_buffers)
+        delete[] b;
+}
+
+char* buffer_pool::acquire(){
+    {
+        std::lock_guard<std::mutex> lk(lock);
+        if(!free_buffers.empty()){
+            char* b = free_buffers.back();
+            free_buffers.pop_back();
+            return b;
+        }
+    }
+    return new char[SEATS_POOL_BUFFER_SIZE];
+}
+
+void buffer_pool::release(char* buff){
+    {
+        std::lock_guard<std::mutex> lk(lock);
+        if(free_buffers.size() < SEATS_POOL_MAX_FREE){
+            free_buffers.push_back(buff);
+            return;
+        }
+    }
+    delete[] buff;
+}
@@ -1,20 +1,77 @@
 #include "seats/seats_client_socket.hpp"
 #include "attest/mock/sev/mock_sev_verifier.hpp"
 #include "attest/sev/tool_attest/sev_tool_verifier.hpp"
+#include "seats/seats_metrics.hpp"
 #include "seats/seats_types.hpp"
+#include "ssl_ext/cached_info.hpp"
 #include "ssl_ext/attestation_ext_structs.hpp"
 #include "ssl_ext/client_ext_cbs.hpp"
 #include "ssl_ext/evidence_ext_structs.hpp"
 #include "ssl_ext/log.hpp"
 
+#include <cerrno>
 #include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <openssl/err.h>
 #include <openssl/ssl.h>
 #include <sys/socket.h>
 #include <unistd.h>
+#include <unordered_map>
 
 using namespace seats;
+using session_clock = std::chrono::steady_clock;
 
-seats_client_socket::seats_client_socket(bool mock_t): mock(mock_t){
+// Tickets of attested sessions by "host:port" and verifier policy, newest
+// last. A ticket is
+// used once, the resumed connection brings new ones.
+class session_cache{
+public:
+    void put(const std::string& key, SSL_SESSION* s, session_clock::time_point attested_at){
+        std::lock_guard<std::mutex> lk(lock);
+        std::deque<ticket>& q = tickets[key];
+
+        q.push_back({s, attested_at});
+        if(q.size() > SEATS_TICKETS_PER_PEER){
+            SSL_SESSION_free(q.front().session);
+            q.pop_front();
+        }
+    }
+
+    SSL_SESSION* take(const std::string& key, session_clock::time_point oldest, session_clock::time_point* attested_at){
+        std::lock_guard<std::mutex> lk(lock);
+        auto it = tickets.find(key);
+
+        if(it == tickets.end()) return NULL;
+        while(!it->second.empty()){
+            ticket t = it->second.back();
+            it->second.pop_back();
+            if(t.attested_at >= oldest){
+                *attested_at = t.attested_at;
+                return t.session;
+            }
+            SSL_SESSION_free(t.session);
+        }
+        return NULL;
+    }
+
+private:
+    struct ticket{
+        SSL_SESSION* session;
+        session_clock::time_point attested_at;
+    };
+    std::mutex lock;
+    std::unordered_map<std::string, std::deque<ticket>> tickets;
+};
+
+static session_cache& sessions(){
+    static session_cache* c = new session_cache();
+    return *c;
+}
+
+seats_client_socket::seats_client_socket(bool mock_t, const seats_socket_options& opts): mock(mock_t){
+    options = opts;
     static int rand_init = false;
     if(!rand_init) srand(time(0));
 
@@ -22,38 +79,118 @@ seats_client_socket::seats_client_socket(bool mock_t): mock(mock_t){
     // ADD FUNCTION FOR CHOOSING SUPPORTED EVIDENCE TYPES 
     // For now only one
     EvidenceType et;
+    et.credential_kind = CredentialKind::ATTESTATION;
     et.type_encoding = TypeEncoding::CONTENT_FORMAT;
     et.supported_content.content_format = ContentFormat::BINARY_FORMAT;
     
     erq->supported_evidence_types.push_back(et);
 
+    if(this->mock){
+        m_verifier = new mock_sev_verifier();    
+    }
+    else{
+        m_verifier = new sev_tool_verifier();
+    }
+
     leave_if_true(status = create_context());
 }
 
 seats_client_socket::~seats_client_socket(){
+    delete m_verifier;
     delete erq;
 }
 
-seats_status seats_client_socket::connect(const char* host, int port){ 
+// Fresh nonce and the AMD certs cached for this endpoint for every
+// handshake
+void seats_client_socket::new_request(std::shared_ptr<cert_cache> certs){
     this->erq->nonce = rand();
-    return seats_socket::connect(host, port); 
+    verify_status = seats_status::OK;
+    if(certs) certs->hashes(this->erq->cached_cert_hashes);
+    else this->erq->cached_cert_hashes.clear();
+    m_verifier->set_cert_cache(std::move(certs));
 }
 
-seats_status seats_client_socket::verify(AttestationExtension* ax, EVP_PKEY* pkey){
-    verifier* verifier;
-    if(this->mock){
-        verifier = new mock_sev_verifier();    
+seats_status seats_client_socket::connect(const char* host, int port){ 
+    seats_status result;
+
+    std::string peer = std::string(host) + ":" + std::to_string(port);
+
+    new_request(cert_cache::for_peer(peer));
+    ticket_key = peer + (mock ? " mock " : " sev ") + std::to_string(max_age.count());
+    attested_at = ticket_attested_at = {};
+    if((result = seats_socket::connect(host, port))){
+        if(verify_status) result = verify_status;
+        metrics::failure(result);
+        return result;
     }
-    else{
-        verifier = new sev_tool_verifier();
+    // Set before the tickets of this connection arrive
+    if(session_resumed()) attested_at = ticket_attested_at;
+    return result;
+}
+
+seats_status seats_client_socket::connect(const char* host, int port, const char* data, size_t len, bool* early){
+    seats_status result;
+
+    early_data = data;
+    early_len = len;
+    result = connect(host, port);
+    early_data = NULL;
+    early_len = 0;
+    if(early) *early = !result && early_accepted;
+    return result;
+}
+
+void seats_client_socket::enable_resumption(std::chrono::seconds age){
+    resumption = true;
+    max_age = age;
+}
+
+seats_status seats_client_socket::create_secure_socket(){
+    seats_status result;
+    SSL_SESSION* s;
+
+    if((result = seats_socket::create_secure_socket())) return result;
+    if(!resumption) return seats_status::OK;
+
+    s = sessions().take(ticket_key, session_clock::now() - max_age, &ticket_attested_at);
+    if(s){
+        if(!SSL_set_session(ssl_session, s)) ERR_clear_error();
+        SSL_SESSION_free(s);
     }
-    // mock_sev_verifier sev_verifier; 
+    return seats_status::OK;
+}
+
+// Only sessions that go back to a verified attestation are kept
+int seats_client_socket::new_session_cb(SSL* s, SSL_SESSION* session){
+    seats_client_socket* cs = static_cast<seats_client_socket*>((seats_socket*)SSL_get_app_data(s));
+
+    if(!cs || !cs->resumption) return 0;
+    if(SSL_version(s) != TLS1_3_VERSION || !cs->established
+            || cs->attested_at == session_clock::time_point())
+        return 0;
+    sessions().put(cs->ticket_key, session, cs->attested_at);
+    return 1;
+}
+
+seats_status seats_client_socket::create_memory_session(){
+    seats_status result;
+
+    // The endpoint is not known, nothing is offered from a cache
+    new_request(NULL);
+    if((result = seats_socket::create_memory_session())) return result;
+    SSL_set_connect_state(ssl_session);
+    return seats_status::OK;
+}
+
+seats_status seats_client_socket::verify(AttestationExtension* ax, EVP_PKEY* pkey){
     switch (ax->attestation_type) {
         case AMD_SEV_SNP:
-            verifier->set_erq(erq);
-            verifier->set_data((uint8_t*)ax->evidence_payload);
-            if(verifier->verify(pkey))
+            m_verifier->set_erq(erq);
+            if(m_verifier->set_data(ax->evidence_data.data(), ax->evidence_data.size()))
+                return seats_status::FAILED_VERIFICATION;
+            if(m_verifier->verify(pkey))
                 return seats_status::FAILED_VERIFICATION;
+            attested_at = session_clock::now();
             break;
         default:
             return seats_status::NOT_IMPLEMENTED_ERROR;
@@ -70,14 +207,17 @@ seats_status seats_client_socket::create_context(){
     SSL_CTX_set_keylog_callback(ctx, SSL_keylog_cb);
 
     if (ctx == NULL) {
-        perror("Unable to create SSL context");
+        seats_log_error("Unable to create SSL context");
         ssl_context = NULL;
         return seats_status::UNABLE_TO_CREATE_SSL_CONTEXT;
     }
     SSL_CTX_set_verify(ctx, SSL_VERIFY_NONE, NULL);
+    // Tickets go to session_cache through new_session_cb
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(ctx, new_session_cb);
 
     if(!SSL_CTX_set_default_verify_paths(ctx)){
-        perror("Unable to create SSL context");
+        seats_log_error("Unable to create SSL context");
         SSL_CTX_free(ctx);
         ssl_context = NULL;
         return seats_status::UNABLE_TO_CREATE_SSL_CONTEXT;
@@ -94,7 +234,7 @@ seats_status seats_client_socket::create_context(){
                                 this);
 
     if(!extension_adding_result){
-        perror("Unable to add attestation extensions");
+        seats_log_error("Unable to add attestation extensions");
         SSL_CTX_free(ctx);
         ssl_context = NULL;
         return seats_status::FAILED_TO_ADD_SSL_EXTENSIONS;
@@ -108,7 +248,7 @@ seats_status seats_client_socket::create_context(){
 seats_status seats_client_socket::create_socket(){ 
     socket_handle = socket(AF_INET, SOCK_STREAM, 0);
     if (socket_handle < 0) {
-        perror("Unable to create socket");
+        seats_log_error("Unable to create socket: %s", strerror(errno));
         return seats_status::UNABLE_TO_CREATE_SOCKET;
     }
     return seats_status::OK;
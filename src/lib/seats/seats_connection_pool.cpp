@@ -0,0 +1,209 @@
+#include "seats/seats_connection_pool.hpp"
+#include "ssl_ext/log.hpp"
+
+#include <fcntl.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <poll.h>
+#include <vector>
+
+using namespace seats;
+using pool_clock = std::chrono::steady_clock;
+
+seats_connection_pool::seats_connection_pool(bool mock, size_t max_idle, std::chrono::seconds max_age,
+        const seats_socket_options& opts):
+    mock(mock), opts(opts), max_idle(max_idle), max_age(max_age){
+    maintainer = std::thread(&seats_connection_pool::maintain, this);
+}
+
+seats_connection_pool::~seats_connection_pool(){
+    {
+        std::lock_guard<std::mutex> lk(lock);
+        stopping = true;
+    }
+    cv.notify_all();
+    maintainer.join();
+}
+
+seats_connection_pool::endpoint& seats_connection_pool::get_endpoint(const char* host, int port){
+    std::string key = std::string(host) + ":" + std::to_string(port);
+    auto it = endpoints.find(key);
+
+    if(it == endpoints.end()){
+        std::unique_ptr<endpoint> ep(new endpoint());
+        ep->host = host;
+        ep->port = port;
+        it = endpoints.emplace(key, std::move(ep)).first;
+    }
+    return *it->second;
+}
+
+bool seats_connection_pool::expired(pool_clock::time_point attested){
+    return pool_clock::now() - attested >= max_age;
+}
+
+// Nothing to read on an idle connection means it is still up. Readable
+// data is normally the session tickets sent after the handshake, peeking
+// processes them, anything else (close_notify, EOF, application data)
+// makes the connection useless for the next user.
+bool seats_connection_pool::alive(seats_client_socket* s){
+    SSL* ssl = s->get_ssl_session();
+    int fd = s->get_fd();
+    struct pollfd pfd = {fd, POLLIN, 0};
+    size_t n;
+    char c;
+
+    if(!ssl || fd < 0 || SSL_pending(ssl)) return false;
+    if(poll(&pfd, 1, 0) < 0 || (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))) return false;
+    if(!(pfd.revents & POLLIN)) return true;
+
+    int flags = fcntl(fd, F_GETFL);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    int err = SSL_peek_ex(ssl, &c, 1, &n) ? SSL_ERROR_NONE : SSL_get_error(ssl, 0);
+    fcntl(fd, F_SETFL, flags);
+    ERR_clear_error();
+
+    return err == SSL_ERROR_WANT_READ;
+}
+
+void seats_connection_pool::prewarm(const char* host, int port, size_t min_idle){
+    {
+        std::lock_guard<std::mutex> lk(lock);
+        get_endpoint(host, port).min_idle = min_idle;
+    }
+    cv.notify_all();
+}
+
+seats_client_socket* seats_connection_pool::acquire(const char* host, int port, seats_status* result){
+    std::vector<std::unique_ptr<seats_client_socket>> stale;
+    std::unique_ptr<seats_client_socket> s;
+    seats_status r;
+    endpoint* ep;
+
+    {
+        std::lock_guard<std::mutex> lk(lock);
+        ep = &get_endpoint(host, port);
+
+        // Most recently used first, it is the least likely to be closed
+        while(!ep->idle.empty()){
+            connection c = std::move(ep->idle.back());
+            ep->idle.pop_back();
+
+            if(!expired(c.attested) && alive(c.s.get())){
+                out[c.s.get()] = {ep, c.attested};
+                if(ep->idle.size() < ep->min_idle) cv.notify_all();
+                if(result) *result = seats_status::OK;
+                return c.s.release();
+            }
+            stale.push_back(std::move(c.s));
+        }
+        if(ep->min_idle) cv.notify_all();
+    }
+
+    // A stale socket is reconnected instead of building a new context
+    if(!stale.empty()){
+        s = std::move(stale.back());
+        stale.pop_back();
+    }
+    else{
+        s.reset(new seats_client_socket(mock, opts));
+    }
+    stale.clear();
+
+    if(!(r = s->get_status()))
+        r = s->connect(host, port);
+    if(result) *result = r;
+    if(r){
+        seats_log_warn("Pool unable to connect to %s:%d (%d)", host, port, r);
+        return NULL;
+    }
+
+    std::lock_guard<std::mutex> lk(lock);
+    out[s.get()] = {ep, pool_clock::now()};
+    return s.release();
+}
+
+void seats_connection_pool::release(seats_client_socket* s, bool reusable){
+    std::unique_ptr<seats_client_socket> owned;
+
+    if(!s) return;
+
+    std::lock_guard<std::mutex> lk(lock);
+    auto it = out.find(s);
+    if(it == out.end()){
+        seats_log_error("Connection released to a pool it does not belong to");
+        return;
+    }
+    lent l = it->second;
+    out.erase(it);
+
+    owned.reset(s);
+    // Old connections go back too, they are re-attested before reuse
+    if(reusable && l.ep->idle.size() < max_idle && !owned->flush())
+        l.ep->idle.push_back({std::move(owned), l.attested});
+}
+
+size_t seats_connection_pool::idle(const char* host, int port){
+    std::lock_guard<std::mutex> lk(lock);
+    return get_endpoint(host, port).idle.size();
+}
+
+void seats_connection_pool::maintain(){
+    std::unique_lock<std::mutex> lk(lock);
+    bool failed = false;
+
+    while(!stopping){
+        cv.wait_for(lk, std::chrono::milliseconds(SEATS_CONN_POOL_MAINTAIN_MS), [&]{
+            if(stopping) return true;
+            // After a failed connect retry only on the timer
+            if(failed) return false;
+            for(auto& [key, ep] : endpoints)
+                if(ep->idle.size() + ep->connecting < ep->min_idle) return true;
+            return false;
+        });
+        if(stopping) break;
+
+        std::vector<std::pair<endpoint*, std::unique_ptr<seats_client_socket>>> jobs;
+        std::vector<std::unique_ptr<seats_client_socket>> stale;
+
+        for(auto& [key, ep] : endpoints){
+            for(auto it = ep->idle.begin(); it != ep->idle.end();){
+                if(expired(it->attested) || !alive(it->s.get())){
+                    stale.push_back(std::move(it->s));
+                    it = ep->idle.erase(it);
+                }
+                else ++it;
+            }
+            while(ep->idle.size() + ep->connecting < ep->min_idle){
+                std::unique_ptr<seats_client_socket> s;
+                if(!stale.empty()){
+                    s = std::move(stale.back());
+                    stale.pop_back();
+                }
+                jobs.emplace_back(ep.get(), std::move(s));
+                ep->connecting++;
+            }
+        }
+
+        // Handshakes and closes happen without the lock
+        lk.unlock();
+        stale.clear();
+        failed = false;
+        for(auto& [ep, s] : jobs){
+            seats_status r;
+
+            if(!s) s.reset(new seats_client_socket(mock, opts));
+            if(!(r = s->get_status()))
+                r = s->connect(ep->host.c_str(), ep->port);
+            if(r) seats_log_warn("Pool unable to prewarm %s:%d (%d)", ep->host.c_str(), ep->port, r);
+
+            lk.lock();
+            ep->connecting--;
+            if(r) failed = true;
+            else ep->idle.push_back({std::move(s), pool_clock::now()});
+            lk.unlock();
+            s.reset();
+        }
+        lk.lock();
+    }
+}
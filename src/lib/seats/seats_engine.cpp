@@ -0,0 +1,178 @@
+#include "seats/seats_engine.hpp"
+#include "attest/mock/sev/mock_sev_attester.hpp"
+#include "attest/sev/tool_attest/sev_tool_attester.hpp"
+#include "seats/seats_client_socket.hpp"
+#include "seats/seats_metrics.hpp"
+#include "seats/seats_stc_socket.hpp"
+#include "ssl_ext/log.hpp"
+
+#include <openssl/bio.h>
+#include <openssl/ssl.h>
+
+using namespace seats;
+
+seats_engine::seats_engine(engine_role role, bool mock){
+    if(role == engine_role::SERVER){
+        if(mock) m_attester.reset(new mock_sev_attester());
+        else m_attester.reset(new sev_tool_attester());
+        sock.reset(new seats_stc_socket(m_attester.get()));
+    }
+    else{
+        sock.reset(new seats_client_socket(mock));
+    }
+
+    leave_if_true(status = sock->get_status());
+    leave_if_true(status = sock->create_memory_session());
+    ssl = sock->get_ssl_session();
+    rbio = SSL_get_rbio(ssl);
+    wbio = SSL_get_wbio(ssl);
+}
+
+seats_engine::~seats_engine(){
+    std::unique_lock<std::mutex> lk(lock);
+    idle.wait(lk, [&]{ return !running; });
+}
+
+void seats_engine::offload(engine_executor executor, std::function<void()> notify){
+    this->executor = std::move(executor);
+    this->notify = std::move(notify);
+}
+
+void seats_engine::handshake(){
+    int r = SSL_do_handshake(ssl);
+
+    if(r == 1){
+        established = true;
+        seats_log_debug("Engine handshake done");
+        return;
+    }
+
+    int err = SSL_get_error(ssl, r);
+    if(err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) return;
+
+    seats_log_error("Attested handshake failed");
+    seats_log_ssl_errors();
+    status = SSL_is_server(ssl) ? seats_status::UNABLE_TO_ACCEPT_SESSION : seats_status::CONNECTION_ERROR;
+    metrics::failure(status);
+}
+
+void seats_engine::step(){
+    if(established || status) return;
+    if(!executor){
+        handshake();
+        return;
+    }
+
+    running = true;
+    executor([this]{
+        std::function<void()> done;
+
+        for(;;){
+            handshake();
+
+            // Bytes fed meanwhile, maybe already application data
+            std::lock_guard<std::mutex> lk(lock);
+            bool more = !inbox.empty();
+            if(more) BIO_write(rbio, inbox.data(), inbox.size());
+            inbox.clear();
+            if(!more || established || status){
+                running = false;
+                idle.notify_all();
+                done = notify;
+                break;
+            }
+        }
+        // The engine may be gone once the lock is released
+        if(done) done();
+    });
+}
+
+seats_status seats_engine::start(){
+    if(!status && !SSL_is_server(ssl)) step();
+    return status;
+}
+
+seats_status seats_engine::feed(const char* data, size_t len){
+    if(status) return status;
+    {
+        std::lock_guard<std::mutex> lk(lock);
+        if(running){
+            inbox.insert(inbox.end(), data, data + len);
+            return seats_status::OK;
+        }
+    }
+
+    if(len && BIO_write(rbio, data, len) != (int)len){
+        seats_log_error("Unable to buffer received bytes");
+        return status = seats_status::RECEIVING_FAILED;
+    }
+    step();
+    return status;
+}
+
+size_t seats_engine::pull(char* out, size_t len){
+    if(running || !wbio) return 0;
+    int n = BIO_read(wbio, out, len);
+    return n > 0 ? n : 0;
+}
+
+size_t seats_engine::pending_output(){
+    if(running || !wbio) return 0;
+    return BIO_ctrl_pending(wbio);
+}
+
+ssize_t seats_engine::write(const char* data, size_t len){
+    size_t written;
+
+    if(!established || running || status || closed) return -1;
+    if(!SSL_write_ex(ssl, data, len, &written)){
+        seats_log_error("Unable to encrypt application data");
+        seats_log_ssl_errors();
+        status = seats_status::SENDING_FAILED;
+        return -1;
+    }
+    return written;
+}
+
+ssize_t seats_engine::read(char* data, size_t len){
+    size_t rxlen;
+
+    if(!established || running) return 0;
+    if(status) return -1;
+    if(SSL_read_ex(ssl, data, len, &rxlen)) return rxlen;
+
+    switch (SSL_get_error(ssl, 0)) {
+        case SSL_ERROR_WANT_READ:
+        case SSL_ERROR_WANT_WRITE:
+            return 0;
+        case SSL_ERROR_ZERO_RETURN:
+            closed = true;
+            return 0;
+        default:
+            seats_log_error("Unable to decrypt application data");
+            seats_log_ssl_errors();
+            status = seats_status::RECEIVING_FAILED;
+            return -1;
+    }
+}
+
+void seats_engine::close(){
+    if(running || !ssl || closed) return;
+    if(established) SSL_shutdown(ssl);
+    closed = true;
+}
+
+engine_state seats_engine::get_state(){
+    if(running) return engine_state::ATTESTATION_PENDING;
+    if(!ssl) return engine_state::FAILED;
+    // Alerts go out before the failure is reported
+    if(BIO_ctrl_pending(wbio)) return engine_state::HAVE_OUTPUT;
+    if(status) return engine_state::FAILED;
+    if(closed || (SSL_get_shutdown(ssl) & SSL_RECEIVED_SHUTDOWN)) return engine_state::CLOSED;
+    if(established) return engine_state::ESTABLISHED;
+    return engine_state::NEED_INPUT;
+}
+
+seats_status seats_engine::get_status(){ return status; }
+
+SSL* seats_engine::get_ssl_session(){ return ssl; }
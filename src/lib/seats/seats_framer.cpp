@@ -0,0 +1,131 @@
+#include "seats/seats_framer.hpp"
+#include "seats/buffer_pool.hpp"
+#include "ssl_ext/log.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace seats;
+
+seats_framer::seats_framer(seats_socket* s, size_t max_msg):
+    s(s), max_msg(std::min<size_t>(max_msg, UINT32_MAX)), rpos(0), wpos(0), error(seats_status::OK){
+    if(this->max_msg + SEATS_FRAME_HEADER_LEN <= SEATS_POOL_BUFFER_SIZE){
+        buff = buffer_pool::instance().acquire();
+        cap = SEATS_POOL_BUFFER_SIZE;
+        pooled = true;
+    }
+    else{
+        cap = this->max_msg + SEATS_FRAME_HEADER_LEN;
+        buff = new char[cap];
+        pooled = false;
+    }
+}
+
+seats_framer::~seats_framer(){
+    if(pooled) buffer_pool::instance().release(buff);
+    else delete[] buff;
+}
+
+seats_status seats_framer::send_msg(const char* data, size_t len){
+    struct iovec iov = {(void*)data, len};
+    return send_msg(&iov, 1);
+}
+
+seats_status seats_framer::send_msg(const struct iovec* iov, int iovcnt){
+    struct iovec parts[SEATS_FRAME_MAX_IOV + 1];
+    unsigned char header[SEATS_FRAME_HEADER_LEN];
+    size_t len = 0;
+
+    if(iovcnt < 0 || iovcnt > SEATS_FRAME_MAX_IOV) return seats_status::SENDING_FAILED;
+    for(int i = 0; i < iovcnt; i++){
+        len += iov[i].iov_len;
+        parts[i + 1] = iov[i];
+    }
+    if(len > max_msg){
+        seats_log_error("Message of %zu bytes is over the limit of %zu", len, max_msg);
+        return seats_status::MESSAGE_TOO_LARGE;
+    }
+
+    for(int i = 0; i < SEATS_FRAME_HEADER_LEN; i++)
+        header[i] = len >> (8 * (SEATS_FRAME_HEADER_LEN - 1 - i));
+    parts[0] = {header, SEATS_FRAME_HEADER_LEN};
+
+    if(s->sendv(parts, iovcnt + 1) < 0) return seats_status::SENDING_FAILED;
+    return seats_status::OK;
+}
+
+bool seats_framer::next(std::span<const char>* msg){
+    const unsigned char* p = (const unsigned char*)buff + rpos;
+    size_t len = 0;
+
+    if(wpos - rpos < SEATS_FRAME_HEADER_LEN) return false;
+    for(int i = 0; i < SEATS_FRAME_HEADER_LEN; i++)
+        len = (len << 8) | p[i];
+
+    if(len > max_msg){
+        // The stream can not be resynchronized after this
+        seats_log_error("Peer sent a message of %zu bytes, the limit is %zu", len, max_msg);
+        error = seats_status::MESSAGE_TOO_LARGE;
+        return false;
+    }
+    if(wpos - rpos - SEATS_FRAME_HEADER_LEN < len) return false;
+
+    *msg = {buff + rpos + SEATS_FRAME_HEADER_LEN, len};
+    rpos += SEATS_FRAME_HEADER_LEN + len;
+    return true;
+}
+
+seats_status seats_framer::fill(){
+    size_t pending = wpos - rpos;
+    ssize_t n;
+
+    // Move the partial message to the front once it can not complete in
+    // the space that is left, earlier views are no longer in use here
+    if(!pending){
+        rpos = wpos = 0;
+    }
+    else if(rpos){
+        size_t need = SEATS_FRAME_HEADER_LEN;
+        if(pending >= SEATS_FRAME_HEADER_LEN){
+            const unsigned char* p = (const unsigned char*)buff + rpos;
+            size_t len = 0;
+            for(int i = 0; i < SEATS_FRAME_HEADER_LEN; i++)
+                len = (len << 8) | p[i];
+            need += len;
+        }
+        if(cap - rpos < need){
+            memmove(buff, buff + rpos, pending);
+            rpos = 0;
+            wpos = pending;
+        }
+    }
+
+    n = s->recv(buff + wpos, cap - wpos);
+    if(n == 0) return seats_status::CONNECTION_CLOSED;
+    if(n < 0) return seats_status::RECEIVING_FAILED;
+    wpos += n;
+    return seats_status::OK;
+}
+
+seats_status seats_framer::recv_msg(std::span<const char>* msg){
+    seats_status result;
+
+    while(!next(msg)){
+        if(error) return error;
+        if((result = fill())) return result;
+    }
+    return seats_status::OK;
+}
+
+seats_status seats_framer::recv_msgs(std::vector<std::span<const char>>& msgs){
+    std::span<const char> msg;
+    seats_status result;
+
+    msgs.clear();
+    if((result = recv_msg(&msg))) return result;
+    do{
+        msgs.push_back(msg);
+    } while(next(&msg));
+    // A size error behind complete messages shows up on the next call
+    return seats_status::OK;
+}
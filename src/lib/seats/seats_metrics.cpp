@@ -0,0 +1,284 @@
+#include "seats/seats_metrics.hpp"
+#include "ssl_ext/log.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace seats;
+
+#define PHASES ((size_t)metric_phase::COUNT)
+
+static const uint64_t bucket_bounds_us[SEATS_METRICS_BUCKETS - 1] = {SEATS_METRICS_BUCKETS_US};
+
+static const char* phase_names[PHASES] = {
+    "request_parse", "request_sign", "attest", "evidence_serialize", "handshake_server",
+    "evidence_parse", "verify_certs", "verify_report", "handshake_client",
+};
+
+// Written by the owning thread only, read by snapshot
+struct metrics_block{
+    std::atomic<uint64_t> buckets[PHASES][SEATS_METRICS_BUCKETS] = {};
+    std::atomic<uint64_t> sum_ns[PHASES] = {};
+    std::atomic<uint64_t> failures[SEATS_STATUS_COUNT] = {};
+    std::atomic<uint64_t> opened{0};
+    std::atomic<uint64_t> closed{0};
+    std::atomic<uint64_t> bytes_in{0};
+    std::atomic<uint64_t> bytes_out{0};
+    // Thread gone, the next new thread takes the block over. Its counts
+    // stay, every metric is a running total.
+    std::atomic<bool> orphaned{false};
+};
+
+// Never destroyed, threads can still count while statics go away
+struct metrics_state{
+    std::mutex lock;
+    std::vector<std::unique_ptr<metrics_block>> blocks;
+
+    std::mutex server_lock;
+    int listen_fd = -1;
+    std::thread server;
+};
+
+static void start_from_env();
+
+static metrics_state* state(){
+    static metrics_state* st = new metrics_state();
+    return st;
+}
+
+struct block_owner{
+    metrics_block* block = NULL;
+    ~block_owner(){
+        if(block) block->orphaned.store(true, std::memory_order_release);
+    }
+};
+
+static thread_local block_owner owner;
+
+static metrics_block* thread_block(){
+    if(owner.block) return owner.block;
+
+    static std::once_flag env_once;
+    std::call_once(env_once, start_from_env);
+
+    metrics_state* st = state();
+    std::lock_guard<std::mutex> lk(st->lock);
+    for(auto& b : st->blocks){
+        bool expected = true;
+        if(b->orphaned.compare_exchange_strong(expected, false, std::memory_order_acquire))
+            return owner.block = b.get();
+    }
+    st->blocks.push_back(std::make_unique<metrics_block>());
+    return owner.block = st->blocks.back().get();
+}
+
+// Single writer, a load and a store instead of a locked add
+static inline void bump(std::atomic<uint64_t>& c, uint64_t n = 1){
+    c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+void metrics::observe(metric_phase phase, uint64_t ns){
+    metrics_block* b = thread_block();
+    uint64_t us = ns / 1000;
+    size_t i = 0;
+
+    while(i < SEATS_METRICS_BUCKETS - 1 && us > bucket_bounds_us[i])
+        i++;
+    bump(b->buckets[(size_t)phase][i]);
+    bump(b->sum_ns[(size_t)phase], ns);
+}
+
+void metrics::failure(seats_status status){
+    if(status > 0 && status < SEATS_STATUS_COUNT)
+        bump(thread_block()->failures[status]);
+}
+
+void metrics::connection_opened(){ bump(thread_block()->opened); }
+void metrics::connection_closed(){ bump(thread_block()->closed); }
+void metrics::bytes_in(size_t n){ bump(thread_block()->bytes_in, n); }
+void metrics::bytes_out(size_t n){ bump(thread_block()->bytes_out, n); }
+
+const char* metrics::phase_name(metric_phase phase){
+    return (size_t)phase < PHASES ? phase_names[(size_t)phase] : "unknown";
+}
+
+metrics_snapshot metrics::snapshot(){
+    metrics_state* st = state();
+    metrics_snapshot s;
+
+    memset(&s, 0, sizeof(s));
+    std::lock_guard<std::mutex> lk(st->lock);
+    for(auto& b : st->blocks){
+        for(size_t p = 0; p < PHASES; p++){
+            for(size_t i = 0; i < SEATS_METRICS_BUCKETS; i++){
+                uint64_t n = b->buckets[p][i].load(std::memory_order_relaxed);
+                s.phases[p].buckets[i] += n;
+                s.phases[p].count += n;
+            }
+            s.phases[p].sum_ns += b->sum_ns[p].load(std::memory_order_relaxed);
+        }
+        for(size_t i = 0; i < SEATS_STATUS_COUNT; i++)
+            s.failures[i] += b->failures[i].load(std::memory_order_relaxed);
+        s.connections_opened += b->opened.load(std::memory_order_relaxed);
+        s.connections_closed += b->closed.load(std::memory_order_relaxed);
+        s.bytes_in += b->bytes_in.load(std::memory_order_relaxed);
+        s.bytes_out += b->bytes_out.load(std::memory_order_relaxed);
+    }
+    return s;
+}
+
+static void append(std::string& out, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void append(std::string& out, const char* fmt, ...){
+    char line[256];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    if(n > 0) out.append(line, std::min<size_t>(n, sizeof(line) - 1));
+}
+
+std::string metrics::prometheus(){
+    metrics_snapshot s = snapshot();
+    std::string out;
+
+    out += "# HELP seats_phase_seconds Time spent in each attested handshake phase.\n"
+           "# TYPE seats_phase_seconds histogram\n";
+    for(size_t p = 0; p < PHASES; p++){
+        uint64_t cumulative = 0;
+        for(size_t i = 0; i < SEATS_METRICS_BUCKETS - 1; i++){
+            cumulative += s.phases[p].buckets[i];
+            append(out, "seats_phase_seconds_bucket{phase=\"%s\",le=\"%g\"} %lu\n",
+                phase_names[p], bucket_bounds_us[i] / 1e6, (unsigned long)cumulative);
+        }
+        append(out, "seats_phase_seconds_bucket{phase=\"%s\",le=\"+Inf\"} %lu\n",
+            phase_names[p], (unsigned long)s.phases[p].count);
+        append(out, "seats_phase_seconds_sum{phase=\"%s\"} %.9f\n", phase_names[p], s.phases[p].sum_ns / 1e9);
+        append(out, "seats_phase_seconds_count{phase=\"%s\"} %lu\n", phase_names[p], (unsigned long)s.phases[p].count);
+    }
+
+    out += "# HELP seats_failures_total Failed connects, accepts and verifications by status.\n"
+           "# TYPE seats_failures_total counter\n";
+    for(size_t i = 1; i < SEATS_STATUS_COUNT; i++)
+        if(s.failures[i])
+            append(out, "seats_failures_total{status=\"%s\"} %lu\n",
+                seats_status_name((seats_status)i), (unsigned long)s.failures[i]);
+
+    append(out, "# HELP seats_connections_active Established attested connections.\n"
+                "# TYPE seats_connections_active gauge\nseats_connections_active %ld\n",
+        (long)s.active_connections());
+    append(out, "# HELP seats_connections_total Attested connections established.\n"
+                "# TYPE seats_connections_total counter\nseats_connections_total %lu\n",
+        (unsigned long)s.connections_opened);
+    append(out, "# HELP seats_received_bytes_total Plaintext bytes received.\n"
+                "# TYPE seats_received_bytes_total counter\nseats_received_bytes_total %lu\n",
+        (unsigned long)s.bytes_in);
+    append(out, "# HELP seats_sent_bytes_total Plaintext bytes sent.\n"
+                "# TYPE seats_sent_bytes_total counter\nseats_sent_bytes_total %lu\n",
+        (unsigned long)s.bytes_out);
+    return out;
+}
+
+static void respond(int fd){
+    char req[2048];
+    size_t len = 0;
+    ssize_t n;
+
+    // Only the request line matters, read until the end of the headers
+    while(len < sizeof(req) - 1 && (n = recv(fd, req + len, sizeof(req) - 1 - len, 0)) > 0){
+        len += n;
+        req[len] = 0;
+        if(strstr(req, "\r\n\r\n") || strstr(req, "\n\n")) break;
+    }
+    req[len] = 0;
+
+    std::string body, head;
+    if(!strncmp(req, "GET /metrics ", 13) || !strncmp(req, "GET / ", 6)){
+        body = metrics::prometheus();
+        head = "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n";
+    }
+    else{
+        body = "not found\n";
+        head = "HTTP/1.1 404 Not Found\r\nContent-Type: text/plain\r\n";
+    }
+    head += "Content-Length: " + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n";
+    head += body;
+
+    for(size_t sent = 0; sent < head.size(); sent += n)
+        if((n = send(fd, head.data() + sent, head.size() - sent, MSG_NOSIGNAL)) <= 0) break;
+}
+
+static void server_main(int lfd){
+    int fd;
+    while((fd = accept(lfd, NULL, NULL)) >= 0 || errno == EINTR){
+        if(fd < 0) continue;
+        struct timeval tv = {2, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        respond(fd);
+        close(fd);
+    }
+}
+
+seats_status metrics::serve(int port){
+    metrics_state* st = state();
+    struct sockaddr_in addr = {};
+    int one = 1;
+
+    std::lock_guard<std::mutex> lk(st->server_lock);
+    if(st->listen_fd >= 0) return seats_status::OK;
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if(fd < 0){
+        seats_log_error("Unable to create metrics socket: %s", strerror(errno));
+        return seats_status::UNABLE_TO_CREATE_SOCKET;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if(bind(fd, (struct sockaddr*)&addr, sizeof(addr))){
+        seats_log_error("Unable to bind metrics port %d: %s", port, strerror(errno));
+        close(fd);
+        return seats_status::UNABLE_TO_BIND_SOCKET;
+    }
+    if(listen(fd, 16)){
+        seats_log_error("Unable to listen on metrics port %d: %s", port, strerror(errno));
+        close(fd);
+        return seats_status::UNABLE_TO_LISTEN;
+    }
+
+    st->listen_fd = fd;
+    st->server = std::thread(server_main, fd);
+    seats_log_info("Serving metrics on 127.0.0.1:%d/metrics", port);
+    return seats_status::OK;
+}
+
+void metrics::stop_serving(){
+    metrics_state* st = state();
+    std::lock_guard<std::mutex> lk(st->server_lock);
+
+    if(st->listen_fd < 0) return;
+    shutdown(st->listen_fd, SHUT_RDWR);
+    if(st->server.joinable()) st->server.join();
+    close(st->listen_fd);
+    st->listen_fd = -1;
+}
+
+static void start_from_env(){
+    const char* port = getenv(SEATS_METRICS_PORT_ENV);
+    if(port && *port) metrics::serve(atoi(port));
+}
@@ -0,0 +1,419 @@
+#include "seats/seats_mux.hpp"
+#include "ssl_ext/log.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <openssl/ssl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+using namespace seats;
+
+enum frame_type : uint8_t{
+    DATA = 0,
+    WINDOW_UPDATE = 1,
+    FIN = 2,
+    RESET = 3,
+    // Sent by open(), ids appear on the wire in increasing order
+    OPEN = 4,
+};
+
+struct seats::mux_state: std::enable_shared_from_this<mux_state>{
+    std::mutex lock;
+    std::condition_variable cv;
+
+    std::unordered_map<uint32_t, std::shared_ptr<seats_stream>> streams;
+    // Streams with DATA or FIN that can go out now, served round robin
+    std::deque<uint32_t> ready;
+    std::deque<std::shared_ptr<seats_stream>> accepted;
+    // Encoded WINDOW_UPDATE/RESET frames, sent before any DATA
+    std::vector<unsigned char> control;
+
+    uint32_t next_id;
+    uint32_t last_peer_id = 0;
+    bool is_server;
+    bool stopping = false;
+    bool dead = false;
+    seats_status status = seats_status::OK;
+    int wake_fd = -1;
+
+    void wake(){
+        uint64_t one = 1;
+        if(::write(wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+            seats_log_error("Unable to wake the mux I/O thread: %s", strerror(errno));
+    }
+
+    void schedule(seats_stream* st){
+        if(st->scheduled) return;
+        if((!st->sbuf.empty() && st->send_window) || (st->fin_requested && !st->fin_sent && st->sbuf.empty())){
+            st->scheduled = true;
+            ready.push_back(st->id);
+        }
+    }
+
+    void put_control(frame_type type, uint32_t id, uint32_t value){
+        put_header(control, type, id, value);
+    }
+
+    static void put_header(std::vector<unsigned char>& out, frame_type type, uint32_t id, uint32_t value){
+        unsigned char h[SEATS_MUX_FRAME_HEADER_LEN] = {type,
+            (unsigned char)(id >> 24), (unsigned char)(id >> 16), (unsigned char)(id >> 8), (unsigned char)id,
+            (unsigned char)(value >> 24), (unsigned char)(value >> 16), (unsigned char)(value >> 8), (unsigned char)value};
+        out.insert(out.end(), h, h + SEATS_MUX_FRAME_HEADER_LEN);
+    }
+
+    // Forgets streams that are done in both directions, handles keep them alive
+    void maybe_erase(seats_stream* st){
+        if(st->is_reset || (st->fin_sent && st->remote_fin && st->rbuf.empty()))
+            streams.erase(st->id);
+    }
+
+    // Nothing left to send, also data still waiting for window
+    bool drained(){
+        if(!control.empty()) return false;
+        for(auto& [id, st] : streams)
+            if(!st->is_reset && (!st->sbuf.empty() || (st->fin_requested && !st->fin_sent))) return false;
+        return true;
+    }
+
+    void fail(seats_status s){
+        if(!dead) status = s;
+        dead = true;
+        cv.notify_all();
+    }
+
+    // Encodes control frames and up to a batch of DATA/FIN frames
+    void collect(std::vector<unsigned char>& out){
+        out.insert(out.end(), control.begin(), control.end());
+        control.clear();
+
+        while(out.size() < SEATS_MUX_WRITE_BATCH && !ready.empty()){
+            uint32_t id = ready.front();
+            ready.pop_front();
+
+            auto it = streams.find(id);
+            if(it == streams.end()) continue;
+            seats_stream* st = it->second.get();
+            st->scheduled = false;
+
+            size_t n = std::min({st->sbuf.size(), st->send_window, (size_t)SEATS_MUX_FRAME_MAX});
+            if(n){
+                put_header(out, DATA, id, n);
+                out.insert(out.end(), st->sbuf.begin(), st->sbuf.begin() + n);
+                st->sbuf.erase(st->sbuf.begin(), st->sbuf.begin() + n);
+                st->send_window -= n;
+                cv.notify_all();
+            }
+            if(st->sbuf.empty() && st->fin_requested && !st->fin_sent){
+                put_header(out, FIN, id, 0);
+                st->fin_sent = true;
+                maybe_erase(st);
+                continue;
+            }
+            schedule(st);
+        }
+    }
+
+    // Frames for streams that are already forgotten are dropped
+    seats_stream* find(uint32_t id){
+        auto it = streams.find(id);
+        return it != streams.end() ? it->second.get() : NULL;
+    }
+
+    // Returns false if the id is not a new one of the peer's parity
+    bool peer_stream(uint32_t id){
+        if((id % 2 == 0) != !is_server || id <= last_peer_id) return false;
+        last_peer_id = id;
+
+        std::shared_ptr<seats_stream> st(new seats_stream());
+        st->m = shared_from_this();
+        st->id = id;
+        streams.emplace(id, st);
+        accepted.push_back(st);
+        cv.notify_all();
+        return true;
+    }
+
+    // Returns false on a protocol violation
+    bool dispatch(frame_type type, uint32_t id, uint32_t value, const unsigned char* payload){
+        seats_stream* st;
+
+        switch (type) {
+            case OPEN:
+                return peer_stream(id);
+            case DATA:
+                if(!(st = find(id))) return true;
+                if(value > st->recv_window) return false;
+                st->recv_window -= value;
+                st->rbuf.insert(st->rbuf.end(), payload, payload + value);
+                cv.notify_all();
+                return true;
+            case WINDOW_UPDATE:
+                if(!(st = find(id))) return true;
+                st->send_window += value;
+                schedule(st);
+                return true;
+            case FIN:
+                if(!(st = find(id))) return true;
+                st->remote_fin = true;
+                maybe_erase(st);
+                cv.notify_all();
+                return true;
+            case RESET:
+                if(!(st = find(id))) return true;
+                st->is_reset = true;
+                maybe_erase(st);
+                cv.notify_all();
+                return true;
+        }
+        return false;
+    }
+
+    // Consumes all complete frames at the front of in
+    bool parse(std::vector<unsigned char>& in, size_t* ilen){
+        size_t pos = 0;
+
+        while(*ilen - pos >= SEATS_MUX_FRAME_HEADER_LEN){
+            const unsigned char* h = in.data() + pos;
+            frame_type type = (frame_type)h[0];
+            uint32_t id = (uint32_t)h[1] << 24 | h[2] << 16 | h[3] << 8 | h[4];
+            uint32_t value = (uint32_t)h[5] << 24 | h[6] << 16 | h[7] << 8 | h[8];
+            size_t flen = SEATS_MUX_FRAME_HEADER_LEN + (type == DATA ? value : 0);
+
+            if(type == DATA && value > SEATS_MUX_FRAME_MAX) return false;
+            if(*ilen - pos < flen) break;
+            if(!dispatch(type, id, value, h + SEATS_MUX_FRAME_HEADER_LEN)) return false;
+            pos += flen;
+        }
+
+        memmove(in.data(), in.data() + pos, *ilen - pos);
+        *ilen -= pos;
+        return true;
+    }
+};
+
+uint32_t seats_stream::get_id(){ return id; }
+
+ssize_t seats_stream::write(const char* data, size_t len){
+    std::unique_lock<std::mutex> lk(m->lock);
+    size_t done = 0;
+
+    while(done < len){
+        m->cv.wait(lk, [&]{
+            return m->dead || is_reset || fin_requested || sbuf.size() < SEATS_MUX_WINDOW;
+        });
+        if(m->dead || is_reset || fin_requested) return -1;
+
+        size_t n = std::min(len - done, SEATS_MUX_WINDOW - sbuf.size());
+        sbuf.insert(sbuf.end(), data + done, data + done + n);
+        done += n;
+        m->schedule(this);
+        m->wake();
+    }
+    return len;
+}
+
+ssize_t seats_stream::read(char* data, size_t len){
+    std::unique_lock<std::mutex> lk(m->lock);
+
+    m->cv.wait(lk, [&]{ return !rbuf.empty() || remote_fin || is_reset || m->dead; });
+    if(is_reset) return -1;
+    if(rbuf.empty()) return remote_fin ? 0 : -1;
+
+    size_t n = std::min(len, rbuf.size());
+    std::copy(rbuf.begin(), rbuf.begin() + n, data);
+    rbuf.erase(rbuf.begin(), rbuf.begin() + n);
+
+    // Give the window back in large steps, not one update per read
+    consumed += n;
+    if(consumed >= SEATS_MUX_WINDOW / 2 && !remote_fin && !m->dead){
+        m->put_control(WINDOW_UPDATE, id, consumed);
+        recv_window += consumed;
+        consumed = 0;
+        m->wake();
+    }
+    m->maybe_erase(this);
+    return n;
+}
+
+void seats_stream::close(){
+    std::lock_guard<std::mutex> lk(m->lock);
+    if(fin_requested || is_reset || m->dead) return;
+    fin_requested = true;
+    m->schedule(this);
+    m->wake();
+    m->cv.notify_all();
+}
+
+void seats_stream::reset(){
+    std::lock_guard<std::mutex> lk(m->lock);
+    if(is_reset || m->dead) return;
+    is_reset = true;
+    sbuf.clear();
+    rbuf.clear();
+    m->put_control(RESET, id, 0);
+    m->maybe_erase(this);
+    m->wake();
+    m->cv.notify_all();
+}
+
+seats_mux::seats_mux(seats_socket* s): s(s), m(std::make_shared<mux_state>()){
+    SSL* ssl = s->get_ssl_session();
+
+    m->is_server = ssl && SSL_is_server(ssl);
+    m->next_id = m->is_server ? 2 : 1;
+    m->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if(!ssl || !SSL_is_init_finished(ssl) || m->wake_fd < 0 || s->flush()){
+        seats_log_error("Unable to multiplex, connection not established");
+        m->fail(seats_status::CONNECTION_ERROR);
+        return;
+    }
+    io = std::thread(&seats_mux::io_loop, this);
+}
+
+seats_mux::~seats_mux(){
+    {
+        std::lock_guard<std::mutex> lk(m->lock);
+        m->stopping = true;
+    }
+    if(io.joinable()){
+        m->wake();
+        io.join();
+    }
+    {
+        // Streams point back at the state, break the cycle
+        std::lock_guard<std::mutex> lk(m->lock);
+        m->fail(seats_status::CONNECTION_CLOSED);
+        m->streams.clear();
+        m->accepted.clear();
+        m->ready.clear();
+    }
+    if(m->wake_fd >= 0) ::close(m->wake_fd);
+}
+
+std::shared_ptr<seats_stream> seats_mux::open(){
+    std::lock_guard<std::mutex> lk(m->lock);
+    if(m->dead) return NULL;
+
+    std::shared_ptr<seats_stream> st(new seats_stream());
+    st->m = m;
+    st->id = m->next_id;
+    m->next_id += 2;
+    m->streams.emplace(st->id, st);
+    m->put_control(OPEN, st->id, 0);
+    m->wake();
+    return st;
+}
+
+std::shared_ptr<seats_stream> seats_mux::accept(){
+    std::unique_lock<std::mutex> lk(m->lock);
+    m->cv.wait(lk, [&]{ return !m->accepted.empty() || m->dead; });
+    if(m->accepted.empty()) return NULL;
+
+    std::shared_ptr<seats_stream> st = m->accepted.front();
+    m->accepted.pop_front();
+    return st;
+}
+
+seats_status seats_mux::get_status(){
+    std::lock_guard<std::mutex> lk(m->lock);
+    return m->status;
+}
+
+void seats_mux::io_loop(){
+    SSL* ssl = s->get_ssl_session();
+    int fd = s->get_fd();
+    int flags = fcntl(fd, F_GETFL);
+    std::vector<unsigned char> out;
+    std::vector<unsigned char> in(SEATS_MUX_READ_BUFFER);
+    size_t opos = 0;
+    size_t ilen = 0;
+    seats_status result = seats_status::OK;
+
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    SSL_set_mode(ssl, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
+    while(!result){
+        bool want_out = false;
+        bool blocked = false;
+        bool more;
+
+        {
+            std::lock_guard<std::mutex> lk(m->lock);
+            if(opos == out.size()){
+                out.clear();
+                opos = 0;
+                m->collect(out);
+            }
+            // Queued data is written out before stopping
+            if(m->stopping && out.empty() && m->drained()) break;
+        }
+
+        while(opos < out.size()){
+            size_t n;
+            if(SSL_write_ex(ssl, out.data() + opos, out.size() - opos, &n)){
+                opos += n;
+                continue;
+            }
+            int err = SSL_get_error(ssl, 0);
+            if(err == SSL_ERROR_WANT_WRITE) want_out = true;
+            else if(err != SSL_ERROR_WANT_READ) result = seats_status::SENDING_FAILED;
+            blocked = true;
+            break;
+        }
+
+        while(!result){
+            size_t n;
+            if(SSL_read_ex(ssl, in.data() + ilen, in.size() - ilen, &n)){
+                ilen += n;
+                std::lock_guard<std::mutex> lk(m->lock);
+                if(!m->parse(in, &ilen)){
+                    seats_log_error("Peer violated the mux protocol");
+                    result = seats_status::RECEIVING_FAILED;
+                }
+                continue;
+            }
+            int err = SSL_get_error(ssl, 0);
+            if(err == SSL_ERROR_WANT_WRITE) want_out = true;
+            else if(err == SSL_ERROR_ZERO_RETURN) result = seats_status::CONNECTION_CLOSED;
+            else if(err != SSL_ERROR_WANT_READ) result = seats_status::RECEIVING_FAILED;
+            break;
+        }
+        if(result) break;
+
+        {
+            std::lock_guard<std::mutex> lk(m->lock);
+            more = !m->ready.empty() || !m->control.empty();
+        }
+        if(!blocked && !want_out && more) continue;
+
+        struct pollfd pfd[2] = {
+            {fd, (short)(POLLIN | (want_out ? POLLOUT : 0)), 0},
+            {m->wake_fd, POLLIN, 0},
+        };
+        if(poll(pfd, 2, -1) < 0 && errno != EINTR){
+            result = seats_status::CONNECTION_ERROR;
+            break;
+        }
+        if(pfd[1].revents & POLLIN){
+            uint64_t v;
+            if(::read(m->wake_fd, &v, sizeof(v)) < 0 && errno != EAGAIN) result = seats_status::CONNECTION_ERROR;
+        }
+    }
+
+    SSL_clear_mode(ssl, SSL_MODE_ENABLE_PARTIAL_WRITE);
+    fcntl(fd, F_SETFL, flags);
+
+    std::lock_guard<std::mutex> lk(m->lock);
+    if(result){
+        if(result != seats_status::CONNECTION_CLOSED) seats_log_ssl_errors();
+        m->fail(result);
+    }
+}
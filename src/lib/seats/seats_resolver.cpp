@@ -0,0 +1,181 @@
+#include "seats/seats_resolver.hpp"
+#include "ssl_ext/log.hpp"
+
+#include <arpa/inet.h>
+#include <cstring>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <thread>
+
+using namespace seats;
+
+seats_resolver& seats_resolver::instance(){
+    // Never destroyed, lookup threads wait for work until exit
+    static seats_resolver* r = new seats_resolver();
+    return *r;
+}
+
+static void set_port(seats_address& a, int port){
+    if(a.addr.ss_family == AF_INET6) ((struct sockaddr_in6*)&a.addr)->sin6_port = htons(port);
+    else ((struct sockaddr_in*)&a.addr)->sin_port = htons(port);
+}
+
+static bool literal(const char* host, int port, std::vector<seats_address>* out){
+    seats_address a = {};
+    struct sockaddr_in* in = (struct sockaddr_in*)&a.addr;
+    struct sockaddr_in6* in6 = (struct sockaddr_in6*)&a.addr;
+
+    if(inet_pton(AF_INET, host, &in->sin_addr) == 1){
+        in->sin_family = AF_INET;
+        a.len = sizeof(*in);
+    }
+    else if(inet_pton(AF_INET6, host, &in6->sin6_addr) == 1){
+        in6->sin6_family = AF_INET6;
+        a.len = sizeof(*in6);
+    }
+    else return false;
+
+    set_port(a, port);
+    out->assign(1, a);
+    return true;
+}
+
+// First address of the preferred family, then alternating families
+static std::vector<seats_address> interleave(const std::vector<seats_address>& addrs){
+    std::vector<seats_address> first, second, out;
+
+    for(const seats_address& a : addrs)
+        (a.addr.ss_family == addrs[0].addr.ss_family ? first : second).push_back(a);
+    for(size_t i = 0; i < first.size() || i < second.size(); i++){
+        if(i < first.size()) out.push_back(first[i]);
+        if(i < second.size()) out.push_back(second[i]);
+    }
+    return out;
+}
+
+static void copy_with_port(const std::vector<seats_address>& addrs, int port, std::vector<seats_address>* out){
+    *out = addrs;
+    for(seats_address& a : *out)
+        set_port(a, port);
+}
+
+seats_status seats_resolver::resolve(const char* host, int port, std::vector<seats_address>* out,
+                                     std::chrono::milliseconds timeout){
+    if(literal(host, port, out)) return seats_status::OK;
+
+    auto now = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lk(lock);
+    entry& e = cache[host];
+
+    e.used = ++uses;
+    if(cache.size() > SEATS_DNS_MAX_NAMES) evict(&e);
+
+    if(e.done && now < e.expires){
+        if(e.status) return e.status;
+        copy_with_port(e.addrs, port, out);
+        return seats_status::OK;
+    }
+    if(e.done && !e.addrs.empty()){
+        if(!e.lookup) start(host, e);
+        copy_with_port(e.addrs, port, out);
+        return seats_status::OK;
+    }
+
+    if(!e.lookup) start(host, e);
+    uint64_t generation = e.generation;
+    e.waiters++;
+    bool answered = cv.wait_until(lk, now + timeout, [&]{ return e.generation != generation; });
+    e.waiters--;
+    if(!answered){
+        seats_log_error("Resolving %s timed out", host);
+        return seats_status::UNABLE_TO_RESOLVE_HOST;
+    }
+    if(e.status) return e.status;
+    copy_with_port(e.addrs, port, out);
+    return seats_status::OK;
+}
+
+// Called with lock held
+void seats_resolver::start(const std::string& host, entry& e){
+    e.lookup = true;
+    queue.push_back(host);
+    if(!idle_threads && lookup_threads < SEATS_DNS_LOOKUP_THREADS){
+        lookup_threads++;
+        std::thread(&seats_resolver::lookup_loop, this).detach();
+    }
+    queue_cv.notify_one();
+}
+
+// Called with lock held, entries with a lookup or waiters in flight stay
+void seats_resolver::evict(const entry* keep){
+    auto lru = cache.end();
+
+    for(auto it = cache.begin(); it != cache.end(); it++){
+        const entry& e = it->second;
+        if(&e == keep || e.lookup || e.waiters) continue;
+        if(lru == cache.end() || e.used < lru->second.used) lru = it;
+    }
+    if(lru != cache.end()) cache.erase(lru);
+}
+
+void seats_resolver::lookup_loop(){
+    std::unique_lock<std::mutex> lk(lock);
+
+    for(;;){
+        idle_threads++;
+        queue_cv.wait(lk, [this]{ return !queue.empty(); });
+        idle_threads--;
+        std::string host = std::move(queue.front());
+        queue.pop_front();
+
+        lk.unlock();
+        lookup(host);
+        lk.lock();
+    }
+}
+
+void seats_resolver::lookup(const std::string& host){
+    struct addrinfo hints = {};
+    struct addrinfo* res = NULL;
+    std::vector<seats_address> addrs;
+    int r;
+
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_ADDRCONFIG;
+    if((r = getaddrinfo(host.c_str(), NULL, &hints, &res)))
+        seats_log_error("Unable to resolve %s: %s", host.c_str(), gai_strerror(r));
+
+    for(struct addrinfo* ai = res; ai; ai = ai->ai_next){
+        if(ai->ai_family != AF_INET && ai->ai_family != AF_INET6) continue;
+        seats_address a = {};
+        memcpy(&a.addr, ai->ai_addr, ai->ai_addrlen);
+        a.len = ai->ai_addrlen;
+        addrs.push_back(a);
+    }
+    if(res) freeaddrinfo(res);
+
+    std::lock_guard<std::mutex> lk(lock);
+    entry& e = cache[host];
+    e.status = addrs.empty() ? seats_status::UNABLE_TO_RESOLVE_HOST : seats_status::OK;
+    e.addrs = addrs.empty() ? addrs : interleave(addrs);
+    e.expires = std::chrono::steady_clock::now() + (addrs.empty() ? negative_ttl : ttl);
+    e.lookup = false;
+    e.done = true;
+    e.generation++;
+    cv.notify_all();
+}
+
+void seats_resolver::set_ttl(std::chrono::seconds t, std::chrono::seconds negative){
+    std::lock_guard<std::mutex> lk(lock);
+    ttl = t;
+    negative_ttl = negative;
+}
+
+void seats_resolver::flush(){
+    std::lock_guard<std::mutex> lk(lock);
+    for(auto& it : cache){
+        it.second.expires = {};
+        it.second.addrs.clear();
+    }
+}
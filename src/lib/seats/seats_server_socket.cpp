@@ -2,7 +2,10 @@
 #include "attest/mock/sev/mock_sev_attester.hpp"
 #include "seats/seats_stc_socket.hpp"
 #include "attest/sev/tool_attest/sev_tool_attester.hpp"
+#include "ssl_ext/log.hpp"
 
+#include <cerrno>
+#include <cstring>
 #include <netinet/in.h>
 #include <openssl/evp.h>
 #include <openssl/pem.h>
@@ -13,64 +16,106 @@
 
 using namespace seats;
 
-seats_server_socket::seats_server_socket(uint port, bool mock_t):mock(mock_t){
+seats_server_socket::seats_server_socket(uint port, bool mock_t, bool reuse_port, const seats_socket_options& opts):mock(mock_t){
     leave_if_true(status = create_attester());
-    leave_if_true(status = create_socket(port));
+    leave_if_true(status = seats_stc_socket::new_context(m_attester, &ssl_context));
+    leave_if_true(status = create_socket(port, reuse_port, opts));
 }
 
 seats_server_socket::~seats_server_socket(){
     close(socket_handle);
+    if(ssl_context) SSL_CTX_free(ssl_context);
     if(m_attester) delete m_attester;
 }
 
 seats_socket* seats_server_socket::accept(){ 
     int client_skt;
-    struct sockaddr_in cli_addr; 
+    struct sockaddr_storage cli_addr; 
     socklen_t cli_addr_len = sizeof(cli_addr);
 
-    client_skt = ::accept(socket_handle, (struct sockaddr*)&addr, &cli_addr_len);
+    client_skt = ::accept(socket_handle, (struct sockaddr*)&cli_addr, &cli_addr_len);
 
     if (client_skt < 0) {
-        perror("Unable to accept");
+        if(errno == EAGAIN || errno == EWOULDBLOCK) return NULL;
+        seats_log_error("Unable to accept: %s", strerror(errno));
         status = seats_status::UNABLE_TO_ACCEPT_CONNECTION;
         return NULL;
     }
 
-    return new seats_stc_socket(client_skt, addr, cli_addr_len, this->m_attester);
+    seats_socket* s = new seats_stc_socket(client_skt, cli_addr, cli_addr_len, this->m_attester, ssl_context);
+    s->enable_ktls(ktls);
+    return s;
 }
 
 seats_status seats_server_socket::get_status(){ return status; }
 
-seats_status seats_server_socket::create_socket(uint port){
-    int optval = 1;
+int seats_server_socket::get_fd(){ return socket_handle; }
 
-    socket_handle = socket(AF_INET, SOCK_STREAM, 0);
+void seats_server_socket::enable_ktls(bool on){ ktls = on; }
+
+void seats_server_socket::enable_early_data(uint32_t max){
+    if(ssl_context) seats_stc_socket::set_max_early_data(ssl_context, max);
+}
+
+seats_status seats_server_socket::create_socket(uint port, bool reuse_port, const seats_socket_options& opts){
+    seats_status result;
+    int optval = 1, v6only = 0;
+    socklen_t addr_len = 0;
+
+    memset(&addr, 0, sizeof(addr));
+    socket_handle = socket(AF_INET6, SOCK_STREAM, 0);
+    if (socket_handle >= 0) {
+        struct sockaddr_in6* in6 = (struct sockaddr_in6*)&addr;
+        in6->sin6_family = AF_INET6;
+        in6->sin6_port = htons(port);
+        in6->sin6_addr = in6addr_any;
+        addr_len = sizeof(*in6);
+
+        /* IPv4 clients arrive as v4-mapped addresses */
+        if (setsockopt(socket_handle, IPPROTO_IPV6, IPV6_V6ONLY, &v6only, sizeof(v6only)) < 0)
+            seats_log_warn("setsockopt(IPV6_V6ONLY) failed, IPv6 only: %s", strerror(errno));
+    }
+    else if (errno == EAFNOSUPPORT) {
+        struct sockaddr_in* in = (struct sockaddr_in*)&addr;
+        socket_handle = socket(AF_INET, SOCK_STREAM, 0);
+        in->sin_family = AF_INET;
+        in->sin_port = htons(port);
+        in->sin_addr.s_addr = INADDR_ANY;
+        addr_len = sizeof(*in);
+    }
     if (socket_handle < 0) {
-        perror("Unable to create socket");
+        seats_log_error("Unable to create socket: %s", strerror(errno));
         return seats_status::UNABLE_TO_CREATE_SOCKET;
     }
 
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(port);
-    addr.sin_addr.s_addr = INADDR_ANY;
-
     /* Reuse the address; good for quick restarts */
     if (setsockopt(socket_handle, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval))
             < 0) {
-        perror("setsockopt(SO_REUSEADDR) failed");
+        seats_log_error("setsockopt(SO_REUSEADDR) failed: %s", strerror(errno));
         close(socket_handle);
         return seats_status::UNABLE_TO_SOCKET_REUSE_ADR;
 
     }
 
-    if (bind(socket_handle, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
-        perror("Unable to bind");
+    if (reuse_port && setsockopt(socket_handle, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(optval)) < 0) {
+        seats_log_error("setsockopt(SO_REUSEPORT) failed: %s", strerror(errno));
+        close(socket_handle);
+        return seats_status::UNABLE_TO_SOCKET_REUSE_ADR;
+    }
+
+    if ((result = opts.apply_listener(socket_handle))) {
+        close(socket_handle);
+        return result;
+    }
+
+    if (bind(socket_handle, (struct sockaddr*) &addr, addr_len) < 0) {
+        seats_log_error("Unable to bind: %s", strerror(errno));
         close(socket_handle);
         return seats_status::UNABLE_TO_BIND_SOCKET;
     }
 
-    if (listen(socket_handle, 1) < 0) {
-        perror("Unable to listen");
+    if (listen(socket_handle, SOMAXCONN) < 0) {
+        seats_log_error("Unable to listen: %s", strerror(errno));
 
         return seats_status::UNABLE_TO_LISTEN;
     }
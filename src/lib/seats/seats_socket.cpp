@@ -1,14 +1,26 @@
 #include "seats/seats_socket.hpp"
+#include "seats/seats_metrics.hpp"
+#include "seats/seats_probes.hpp"
+#include "seats/seats_resolver.hpp"
+#include "seats/seats_trace.hpp"
+#include "ssl_ext/handshake_arena.hpp"
+#include "ssl_ext/log.hpp"
 
-#include <arpa/inet.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
 #include <openssl/err.h>
 #include <openssl/ssl.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <unistd.h>
+#include <vector>
 
 using namespace seats;
 
 seats_socket::~seats_socket(){ 
+    if(established) metrics::connection_closed();
     if(ssl_session){
         if(SSL_is_init_finished(ssl_session))
             SSL_shutdown(ssl_session);
@@ -27,78 +39,352 @@ SSL_CTX* seats_socket::get_ssl_context(){
     return ssl_context;
 }
 
-seats_status seats_socket::connect(const char* host, int port){ 
-    socket_handle = socket(AF_INET, SOCK_STREAM, 0);
-    if (socket_handle < 0) {
-        perror("Unable to create socket");
-        return seats_status::UNABLE_TO_CREATE_SOCKET;
-    }
+SSL* seats_socket::get_ssl_session(){
+    return ssl_session;
+}
+
+int seats_socket::get_fd(){
+    return socket_handle;
+}
 
+// Reconnecting starts from scratch, a failed attempt leaves the socket closed
+seats_status seats_socket::connect(const char* host, int port){ 
     seats_status result = seats_status::OK;
- 
-    addr.sin_family = AF_INET;
-    inet_pton(AF_INET, host, &addr.sin_addr.s_addr);
-    addr.sin_port = htons(port);
+    trace_span root("connection.connect", true);
+
+    close();
+    wlen = 0;
+    burst_bytes = 0;
+    early_accepted = false;
+
     /* Do TCP connect with server */
-    if (::connect(socket_handle, (struct sockaddr*) &addr, sizeof(addr)) != 0) {
-        perror("Unable to TCP connect to server");
-        return seats_status::CONNECTION_ERROR;
+    if((result = connect_tcp(host, port))){
+        close();
+        return result;
     }
 
     if((result = create_secure_socket())){
-        perror("FAILED TO CREATE SECURE SOCKET!");
+        seats_log_error("FAILED TO CREATE SECURE SOCKET!");
+        close();
         return result;
     }
 
     if(!ssl_session){
-        perror("SSL session not created, you cannot connect.\n");
+        seats_log_error("SSL session not created, you cannot connect.");
+        close();
         return seats_status::CONNECTION_ERROR;
     }
 
-    if (!SSL_connect(ssl_session)) {
+    int r = 1;
+    SSL_SESSION* resume = SSL_get0_session(ssl_session);
+    bool zero_rtt = early_len && resume && SSL_SESSION_get_max_early_data(resume) >= early_len;
+    SEATS_PROBE2(handshake_start, socket_handle, 0);
+    {
+        metric_timer t(metric_phase::HANDSHAKE_CLIENT);
+        size_t written;
+        // Sends the ClientHello and the data right behind it
+        if(zero_rtt && !SSL_write_early_data(ssl_session, early_data, early_len, &written))
+            r = 0;
+        if(r > 0) r = SSL_connect(ssl_session);
+    }
+    SEATS_PROBE3(handshake_end, socket_handle, 0, r <= 0 ? (int)seats_status::CONNECTION_ERROR : 0);
+    if (r <= 0) {
         //TODO: check if attestation message is present
-        perror("SSL connection to server failed\n\n");
-        ERR_print_errors_fp(stderr);
+        seats_log_error("SSL connection to server failed");
+        seats_log_ssl_errors();
+        close();
+        return seats_status::CONNECTION_ERROR;
+    }
+
+    established = true;
+    metrics::connection_opened();
+
+    // Rejected early data is discarded by the server, it goes out again
+    if(zero_rtt) early_accepted = SSL_get_early_data_status(ssl_session) == SSL_EARLY_DATA_ACCEPTED;
+    if(early_len && !early_accepted && send(early_data, early_len) != (ssize_t)early_len){
+        close();
+        return seats_status::SENDING_FAILED;
+    }
+
+    if(ktls) seats_log_debug("kTLS send %d recv %d", ktls_send_active(), ktls_recv_active());
+    return seats_status::OK;
+}
+
+// One non-blocking connect, -1 if it failed right away
+static int start_attempt(const seats_address& a, const seats_socket_options& opts){
+    int fd = socket(a.addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if(fd < 0){
+        seats_log_debug("Unable to create socket: %s", strerror(errno));
+        return -1;
+    }
+    if(opts.apply_client(fd)
+            || (::connect(fd, (struct sockaddr*)&a.addr, a.len) && errno != EINPROGRESS)){
+        seats_log_debug("Connect attempt failed: %s", strerror(errno));
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// RFC 8305: the addresses are tried in order, the next one as soon as the
+// previous attempt failed or after attempt_delay_ms without an answer,
+// while earlier attempts keep running. The first connected one wins.
+seats_status seats_socket::connect_tcp(const char* host, int port){
+    using he_clock = std::chrono::steady_clock;
+    auto deadline = he_clock::now() + std::chrono::milliseconds(options.connect_timeout_ms);
+    std::vector<seats_address> addrs;
+    seats_status result;
+
+    {
+        trace_span t("dns.resolve");
+        result = seats_resolver::instance().resolve(host, port, &addrs,
+            std::chrono::milliseconds(options.connect_timeout_ms));
+    }
+    if(result) return result;
+
+    // Racing needs real SYNs, a Fast Open connect returns before sending one
+    seats_socket_options opts = options;
+    if(addrs.size() > 1) opts.fastopen = false;
+
+    trace_span t("tcp.connect");
+    std::vector<struct pollfd> fds;
+    std::vector<size_t> candidate;
+    size_t next = 0, won = 0;
+    int winner = -1;
+    auto next_attempt = he_clock::now();
+
+    while(winner < 0){
+        auto now = he_clock::now();
+        if(now >= deadline) break;
+
+        if(next < addrs.size() && now >= next_attempt){
+            int fd = start_attempt(addrs[next], opts);
+            if(fd >= 0){
+                fds.push_back({fd, POLLOUT, 0});
+                candidate.push_back(next);
+                next_attempt = now + std::chrono::milliseconds(opts.attempt_delay_ms);
+            }
+            next++;
+            continue;
+        }
+        if(fds.empty()){
+            if(next >= addrs.size()) break;
+            next_attempt = now;
+            continue;
+        }
+
+        auto until = next < addrs.size() ? std::min(deadline, next_attempt) : deadline;
+        int ms = std::chrono::duration_cast<std::chrono::milliseconds>(until - now).count() + 1;
+        if(poll(fds.data(), fds.size(), ms) < 0 && errno != EINTR){
+            seats_log_error("poll failed: %s", strerror(errno));
+            break;
+        }
+
+        for(size_t i = 0; i < fds.size();){
+            if(!fds[i].revents){
+                i++;
+                continue;
+            }
+            int err = 0;
+            socklen_t len = sizeof(err);
+            getsockopt(fds[i].fd, SOL_SOCKET, SO_ERROR, &err, &len);
+            if(!err){
+                winner = fds[i].fd;
+                won = candidate[i];
+            }
+            else{
+                seats_log_debug("Connect to address %zu of %s failed: %s", candidate[i], host, strerror(err));
+                ::close(fds[i].fd);
+                // Do not wait for the delay, try the next address now
+                next_attempt = he_clock::now();
+            }
+            fds.erase(fds.begin() + i);
+            candidate.erase(candidate.begin() + i);
+            if(winner >= 0) break;
+        }
+    }
+    for(struct pollfd& p : fds)
+        ::close(p.fd);
+
+    if(winner < 0){
+        seats_log_error("Unable to TCP connect to %s:%d%s", host, port,
+            he_clock::now() >= deadline ? ", timed out" : "");
         return seats_status::CONNECTION_ERROR;
     }
 
+    // The SSL layer works on a blocking socket
+    fcntl(winner, F_SETFL, fcntl(winner, F_GETFL) & ~O_NONBLOCK);
+    socket_handle = winner;
+    memcpy(&addr, &addrs[won].addr, addrs[won].len);
+    addr_len = addrs[won].len;
     return seats_status::OK;
 }
 
 seats_status seats_socket::accept(){
+    trace_span root("connection.accept", true, accepted_ns);
+    if(accepted_ns) trace::record("accept.setup", accepted_ns, ready_ns);
+
     if(!ssl_session){
-        perror("SSL session not created, you cannot accept.\n");
+        seats_log_error("SSL session not created, you cannot accept.");
         return seats_status::UNABLE_TO_ACCEPT_SESSION;
     }
 
-    if (SSL_accept(ssl_session) <= 0) {
-        perror("Unable to accept secure ssl connection from client\n");
-        ERR_print_errors_fp(stderr);
+    int r = 1;
+    SEATS_PROBE2(handshake_start, socket_handle, 1);
+    {
+        metric_timer t(metric_phase::HANDSHAKE_SERVER);
+        if(SSL_get_max_early_data(ssl_session)) r = read_early_data();
+        if(r > 0) r = SSL_accept(ssl_session);
+    }
+    SEATS_PROBE3(handshake_end, socket_handle, 1, r <= 0 ? (int)seats_status::UNABLE_TO_ACCEPT_SESSION : 0);
+    if (r <= 0) {
+        seats_log_error("Unable to accept secure ssl connection from client");
+        seats_log_ssl_errors();
+        metrics::failure(seats_status::UNABLE_TO_ACCEPT_SESSION);
         return seats_status::UNABLE_TO_ACCEPT_SESSION;
     }
+
+    established = true;
+    metrics::connection_opened();
+
+    if(ktls) seats_log_debug("kTLS send %d recv %d", ktls_send_active(), ktls_recv_active());
     return seats_status::OK;
 }
-int seats_socket::send(const char* data, int datalen){ 
+// Early data ends with FINISH, also when the client sent none or the
+// server rejected it
+int seats_socket::read_early_data(){
+    size_t max = SSL_get_max_early_data(ssl_session);
+
+    early_in.resize(max);
+    early_off = 0;
+    for(size_t got = 0;;){
+        size_t n = 0;
+        int r = SSL_read_early_data(ssl_session, early_in.data() + got, max - got, &n);
+        got += n;
+        if(r == SSL_READ_EARLY_DATA_ERROR){
+            early_in.clear();
+            return 0;
+        }
+        if(r == SSL_READ_EARLY_DATA_FINISH){
+            early_in.resize(got);
+            break;
+        }
+    }
+    early_accepted = SSL_get_early_data_status(ssl_session) == SSL_EARLY_DATA_ACCEPTED;
+    return 1;
+}
+
+bool seats_socket::early_data_accepted(){
+    return early_accepted;
+}
+
+bool seats_socket::session_resumed(){
+    return ssl_session && SSL_session_reused(ssl_session);
+}
+
+ssize_t seats_socket::send(const char* data, size_t datalen){ 
+    struct iovec iov = {(void*)data, datalen};
+    return sendv(&iov, 1);
+}
+
+size_t seats_socket::record_size(){
+    auto now = std::chrono::steady_clock::now();
+    if(now - last_write > std::chrono::milliseconds(SEATS_RECORD_IDLE_RESET_MS))
+        burst_bytes = 0;
+    return burst_bytes < SEATS_RECORD_BOOST_BYTES ? SEATS_RECORD_SMALL : SSL3_RT_MAX_PLAIN_LENGTH;
+}
+
+// OpenSSL splits anything above the maximum fragment into full records
+int seats_socket::write_out(const char* data, size_t len){
+    size_t written;
+
+    if(!SSL_write_ex(ssl_session, data, len, &written)){
+        seats_log_error("Unable to send packets.");
+        seats_log_ssl_errors();
+        return 1;
+    }
+    burst_bytes += written;
+    metrics::bytes_out(written);
+    last_write = std::chrono::steady_clock::now();
+    return 0;
+}
+
+ssize_t seats_socket::sendv(const struct iovec* iov, int iovcnt){
+    size_t total = 0;
+
     if(!ssl_session){ 
-        perror("SSL session not created, you cannot send packets.\n");
-        return seats_status::SENDING_FAILED;
+        seats_log_error("SSL session not created, you cannot send packets.");
+        return -1;
     }
-    
-    int txlen = SSL_write(ssl_session, data, datalen); 
-    if (txlen <= 0) {
-        perror("Unable to send packets.");
-        ERR_print_errors_fp(stderr);
+    if(!wbuf) wbuf = std::make_unique<char[]>(SSL3_RT_MAX_PLAIN_LENGTH);
+
+    for(int i = 0; i < iovcnt; i++){
+        const char* p = (const char*)iov[i].iov_base;
+        size_t left = iov[i].iov_len;
+
+        while(left){
+            size_t rs = record_size();
+
+            if(wlen >= rs){
+                if(write_out(wbuf.get(), wlen)) return -1;
+                wlen = 0;
+                continue;
+            }
+
+            // Whole records straight from the caller buffer
+            if(!wlen && left >= rs){
+                size_t n = rs == SSL3_RT_MAX_PLAIN_LENGTH ? left - left % rs : rs;
+                if(write_out(p, n)) return -1;
+                p += n;
+                left -= n;
+                continue;
+            }
+
+            size_t n = std::min(rs - wlen, left);
+            memcpy(wbuf.get() + wlen, p, n);
+            wlen += n;
+            p += n;
+            left -= n;
+            if(wlen == rs){
+                if(write_out(wbuf.get(), wlen)) return -1;
+                wlen = 0;
+            }
+        }
+        total += iov[i].iov_len;
     }
-    return txlen;
+
+    if(!corked && flush()) return -1;
+    SEATS_PROBE2(send, socket_handle, total);
+    return total;
+}
+
+void seats_socket::cork(bool on){
+    corked = on;
+    if(!on) flush();
+}
+
+seats_status seats_socket::flush(){
+    if(!wlen) return seats_status::OK;
+    if(!ssl_session || write_out(wbuf.get(), wlen))
+        return seats_status::SENDING_FAILED;
+    wlen = 0;
+    return seats_status::OK;
 }
 
 seats_status seats_socket::close(){
     if(ssl_session){
-        if(SSL_is_init_finished(ssl_session))
+        if(SSL_is_init_finished(ssl_session)){
+            flush();
             SSL_shutdown(ssl_session);
+        }
         SSL_free(ssl_session);
         ssl_session = NULL;
     }
+    if(established){
+        metrics::connection_closed();
+        established = false;
+    }
    
     if(socket_handle > 0){
         ::close(socket_handle);
@@ -108,37 +394,161 @@ seats_status seats_socket::close(){
     return seats_status::OK;
 }
 
-int seats_socket::recv(char* data, int datalen){
+ssize_t seats_socket::recv(char* data, size_t datalen){
+    size_t rxlen;
+
     if(!ssl_session){ 
-        perror("SSL session not created, you cannot recieve packets.\n");
-        return seats_status::RECEIVING_FAILED;
+        seats_log_error("SSL session not created, you cannot recieve packets.");
+        return -1;
     }
 
-    int rxlen = SSL_read(ssl_session, (void*)data, datalen);
-    if (rxlen <= 0) {
-        perror("Unable to receive packets.");
-        ERR_print_errors_fp(stderr);
+    // The peer may be waiting for what is still corked
+    if(flush()) return -1;
+
+    if(early_off < early_in.size()){
+        size_t n = std::min(datalen, early_in.size() - early_off);
+        memcpy(data, early_in.data() + early_off, n);
+        early_off += n;
+        SEATS_PROBE2(recv, socket_handle, n);
+        metrics::bytes_in(n);
+        return n;
+    }
+
+    if (!SSL_read_ex(ssl_session, (void*)data, datalen, &rxlen)) {
+        if(SSL_get_error(ssl_session, 0) == SSL_ERROR_ZERO_RETURN){
+            SEATS_PROBE2(recv, socket_handle, 0);
+            return 0;
+        }
+        seats_log_error("Unable to receive packets.");
+        seats_log_ssl_errors();
+        SEATS_PROBE2(recv, socket_handle, -1);
+        return -1;
     }
+    SEATS_PROBE2(recv, socket_handle, rxlen);
+    metrics::bytes_in(rxlen);
     return rxlen;
 }	
 
+static void set_ktls_option(SSL* s, bool on){
+#ifdef SSL_OP_ENABLE_KTLS
+    if(on) SSL_set_options(s, SSL_OP_ENABLE_KTLS);
+    else SSL_clear_options(s, SSL_OP_ENABLE_KTLS);
+#else
+    (void)s;
+    (void)on;
+#endif
+}
+
+void seats_socket::enable_ktls(bool on){
+    ktls = on;
+    if(ssl_session) set_ktls_option(ssl_session, on);
+}
+
+bool seats_socket::ktls_send_active(){
+    return ssl_session && BIO_get_ktls_send(SSL_get_wbio(ssl_session));
+}
+
+bool seats_socket::ktls_recv_active(){
+    return ssl_session && BIO_get_ktls_recv(SSL_get_rbio(ssl_session));
+}
+
+ssize_t seats_socket::send_file(int fd, off_t offset, size_t len){
+    size_t sent = 0;
+
+    if(!ssl_session){ 
+        seats_log_error("SSL session not created, you cannot send files.");
+        return -1;
+    }
+    if(flush()) return -1;
+
+    if(ktls_send_active()){
+        while(sent < len){
+            ossl_ssize_t n = SSL_sendfile(ssl_session, fd, offset + sent, len - sent, 0);
+            if(n <= 0){
+                seats_log_error("Unable to sendfile.");
+                seats_log_ssl_errors();
+                return -1;
+            }
+            sent += n;
+        }
+        metrics::bytes_out(sent);
+        return sent;
+    }
+
+    // One full TLS record per write
+    char buff[SSL3_RT_MAX_PLAIN_LENGTH];
+    while(sent < len){
+        size_t chunk = std::min(len - sent, sizeof(buff));
+        ssize_t n = pread(fd, buff, chunk, offset + sent);
+
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0){
+            seats_log_error("Unable to read file: %s", n ? strerror(errno) : "unexpected end of file");
+            return -1;
+        }
+        if(write_out(buff, n)) return -1;
+        sent += n;
+    }
+    return sent;
+}
+
 seats_status seats_socket::get_status(){
     return status;
 }
 
-seats_status seats_socket::create_secure_socket(){ 
+seats_status seats_socket::new_session(){
     ssl_session = SSL_new(ssl_context);
-    seats_status result = seats_status::OK;
 
     if(!ssl_session){ 
-        perror("Unable to create ssl session");
-        result = seats_status::UNABLE_TO_CREATE_SSL_SESSION; 
-        goto end_create_secure_socket; 
+        seats_log_error("Unable to create ssl session");
+        return seats_status::UNABLE_TO_CREATE_SSL_SESSION; 
+    }
+
+    set_ktls_option(ssl_session, ktls);
+    SSL_set_app_data(ssl_session, this);
+
+    if (arena::attach(ssl_session)) {
+        seats_log_error("Unable to attach handshake arena");
+        SSL_free(ssl_session);
+        ssl_session = NULL;
+        return seats_status::UNABLE_TO_CREATE_SSL_SESSION; 
     }
+    return seats_status::OK;
+}
+
+seats_status seats_socket::create_memory_session(){
+    seats_status result;
+    BIO* rbio;
+    BIO* wbio;
+
+    if(!ssl_context) return seats_status::UNABLE_TO_CREATE_SSL_CONTEXT;
+    if(ssl_session) return seats_status::UNABLE_TO_CREATE_SSL_SESSION;
+    if((result = new_session())) return result;
+
+    rbio = BIO_new(BIO_s_mem());
+    wbio = BIO_new(BIO_s_mem());
+    if(!rbio || !wbio){
+        seats_log_error("Unable to create memory BIOs");
+        BIO_free(rbio);
+        BIO_free(wbio);
+        SSL_free(ssl_session);
+        ssl_session = NULL;
+        return seats_status::UNABLE_TO_CREATE_SSL_SESSION;
+    }
+    // An empty read buffer means "retry later", not end of stream
+    BIO_set_mem_eof_return(rbio, -1);
+    SSL_set_bio(ssl_session, rbio, wbio);
+    return seats_status::OK;
+}
+
+seats_status seats_socket::create_secure_socket(){ 
+    seats_status result = seats_status::OK;
+
+    if((result = new_session())) return result;
 
     if (!SSL_set_fd(ssl_session, socket_handle)) {
-        perror("Unable to set socket for ssl session");
-        ERR_print_errors_fp(stderr);
+        seats_log_error("Unable to set socket for ssl session");
+        seats_log_ssl_errors();
         result = seats_status::UNABLE_TO_SET_SOCKET_FOR_SSL_SESSION; 
         goto end_create_secure_socket;
     }
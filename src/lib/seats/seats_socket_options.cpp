@@ -0,0 +1,63 @@
+#include "seats/seats_socket_options.hpp"
+#include "ssl_ext/log.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+using namespace seats;
+
+static int set_option(int fd, int level, int option, int value, const char* name){
+    if(!setsockopt(fd, level, option, &value, sizeof(value))) return 0;
+    seats_log_error("setsockopt(%s) failed: %s", name, strerror(errno));
+    return 1;
+}
+
+seats_status seats_socket_options::apply(int fd) const{
+    if(nodelay && set_option(fd, IPPROTO_TCP, TCP_NODELAY, 1, "TCP_NODELAY"))
+        return seats_status::UNABLE_TO_SET_SOCKET_OPTION;
+
+    if(keepalive && (set_option(fd, SOL_SOCKET, SO_KEEPALIVE, 1, "SO_KEEPALIVE")
+            || set_option(fd, IPPROTO_TCP, TCP_KEEPIDLE, keepalive_idle_s, "TCP_KEEPIDLE")
+            || set_option(fd, IPPROTO_TCP, TCP_KEEPINTVL, keepalive_interval_s, "TCP_KEEPINTVL")
+            || set_option(fd, IPPROTO_TCP, TCP_KEEPCNT, keepalive_count, "TCP_KEEPCNT")))
+        return seats_status::UNABLE_TO_SET_SOCKET_OPTION;
+
+    // Before connect/listen, the window scale is negotiated on the SYN
+    if(send_buffer && set_option(fd, SOL_SOCKET, SO_SNDBUF, send_buffer, "SO_SNDBUF"))
+        return seats_status::UNABLE_TO_SET_SOCKET_OPTION;
+    if(recv_buffer && set_option(fd, SOL_SOCKET, SO_RCVBUF, recv_buffer, "SO_RCVBUF"))
+        return seats_status::UNABLE_TO_SET_SOCKET_OPTION;
+
+    return seats_status::OK;
+}
+
+seats_status seats_socket_options::apply_client(int fd) const{
+    seats_status result;
+
+    if((result = apply(fd))) return result;
+
+    // Not fatal, the connect is an ordinary three way handshake then
+    if(fastopen){
+#ifdef TCP_FASTOPEN_CONNECT
+        int one = 1;
+        if(setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, &one, sizeof(one)))
+            seats_log_warn("TCP Fast Open unavailable: %s", strerror(errno));
+#else
+        seats_log_warn("TCP Fast Open unavailable: no TCP_FASTOPEN_CONNECT");
+#endif
+    }
+    return seats_status::OK;
+}
+
+seats_status seats_socket_options::apply_listener(int fd) const{
+    seats_status result;
+
+    if((result = apply(fd))) return result;
+
+    if(fastopen && setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN, &fastopen_queue, sizeof(fastopen_queue)))
+        seats_log_warn("TCP Fast Open unavailable: %s", strerror(errno));
+    return seats_status::OK;
+}
@@ -1,83 +1,224 @@
 #include "seats/seats_stc_socket.hpp"
+#include "seats/seats_metrics.hpp"
+#include "seats/seats_probes.hpp"
+#include "seats/seats_trace.hpp"
 #include "seats/seats_types.hpp"
 #include "ssl_ext/attestation_ext_structs.hpp"
 #include "ssl_ext/evidence_ext_structs.hpp"
 #include "ssl_ext/server_ext_cbs.hpp"
+#include "ssl_ext/log.hpp"
 
+#include <array>
+#include <ctime>
+#include <map>
+#include <mutex>
 #include <openssl/err.h>
+#include <openssl/rand.h>
+#include <openssl/sha.h>
 #include <openssl/ssl.h>
+#include <string>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
 
 using namespace seats;
 
-seats_stc_socket::seats_stc_socket(int sock_fd, struct sockaddr_in addr, socklen_t addr_len, attester* t_attester){
+seats_stc_socket::seats_stc_socket(int sock_fd, const struct sockaddr_storage& addr, socklen_t addr_len, attester* t_attester,
+                                   SSL_CTX* shared_ctx){
+    accepted_ns = trace::now();
     socket_handle = sock_fd;
     this->addr = addr; 
     this->addr_len = addr_len;
     this->m_attester = t_attester;
 
     if(sock_fd <= 0){
-        perror("Provided socket fd invalid!.");
+        seats_log_error("Provided socket fd invalid!.");
         status = UNABLE_TO_CREATE_SOCKET;
         return;
     }
 
-    leave_if_true(status = create_context());
-    if(this->m_attester->configure_ssl_ctx(this->ssl_context)){
-        status = seats_status::UNABLE_TO_CONFIGURE_SSL_CONTEXT;
-        return;
-    }
+    if(shared_ctx && SSL_CTX_up_ref(shared_ctx)) ssl_context = shared_ctx;
+    else leave_if_true(status = create_context());
     leave_if_true(status = create_secure_socket());
+    ready_ns = trace::now();
+}
+
+seats_stc_socket::seats_stc_socket(attester* t_attester){
+    this->m_attester = t_attester;
+
+    leave_if_true(status = create_context());
+}
+
+seats_status seats_stc_socket::create_memory_session(){
+    seats_status result;
+
+    if((result = seats_socket::create_memory_session())) return result;
+    SSL_set_accept_state(ssl_session);
+    return seats_status::OK;
 }
 
 seats_status seats_stc_socket::connect(const char*, int){ return seats_status::CONNECTION_ERROR; }
 
-AttestationExtension* seats_stc_socket::attest(){
-    if (m_attester->attest())
-        return NULL;
-    return m_attester->getResult();
+seats_stc_socket* seats_stc_socket::from_session(SSL* s){
+    return static_cast<seats_stc_socket*>((seats_socket*)SSL_get_app_data(s));
+}
+
+int seats_stc_socket::attest(AttestationExtension* ax){
+    int result;
+
+    // Only full handshakes get here, resumed ones never sign the request
+    if(m_attester->sign_request())
+        return 1;
+
+    metric_timer t(metric_phase::ATTEST);
+    SEATS_PROBE0(attest_start);
+    result = m_attester->attest();
+    SEATS_PROBE1(attest_end, result);
+    if (result)
+        return 1;
+    m_attester->getResult(ax);
+    return 0;
+}
+
+// Servers with the same kind of attester share these keys, a ticket from
+// one listener (reuse_port) resumes on the others. A ticket of a mock
+// attester never resumes on a real one. They live as long as the process.
+static const unsigned char* ticket_keys(attester* t_attester){
+    static std::mutex lock;
+    static std::map<std::type_index, std::array<unsigned char, 80>> keys;
+    std::type_index kind = typeid(*t_attester);
+    std::lock_guard<std::mutex> lk(lock);
+
+    auto it = keys.find(kind);
+    if(it == keys.end()){
+        std::array<unsigned char, 80> k;
+        if(RAND_bytes(k.data(), k.size()) != 1) return NULL;
+        it = keys.emplace(kind, k).first;
+    }
+    return it->second.data();
+}
+
+// Early data of a ticket is accepted once. Tickets are known by their
+// resumption secret and remembered until they are too old for early data
+// anyway, so the store only holds tickets of the last window.
+class replay_store{
+public:
+    bool first_use(const unsigned char* key, size_t len, time_t issued){
+        std::string k((const char*)key, len);
+        time_t now = time(NULL);
+        std::lock_guard<std::mutex> lk(lock);
+
+        if(seen.size() >= SEATS_EARLY_DATA_REPLAY_MAX){
+            for(auto it = seen.begin(); it != seen.end();)
+                it = it->second <= now ? seen.erase(it) : std::next(it);
+            if(seen.size() >= SEATS_EARLY_DATA_REPLAY_MAX){
+                seats_log_warn("Early data replay store full, rejecting early data");
+                return false;
+            }
+        }
+        return seen.emplace(k, issued + SEATS_EARLY_DATA_WINDOW_S).second;
+    }
+private:
+    std::mutex lock;
+    std::unordered_map<std::string, time_t> seen;
+};
+
+static replay_store& replays(){
+    static replay_store* r = new replay_store();
+    return *r;
+}
+
+// OpenSSL already dropped early data whose obfuscated ticket age does not
+// match the time since the ticket was sent
+static int allow_early_data_cb(SSL* s, void*){
+    SSL_SESSION* sess = SSL_get0_session(s);
+    unsigned char secret[SSL_MAX_MASTER_KEY_LENGTH];
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    size_t len;
+    time_t issued;
+
+    if(!sess) return 0;
+    issued = SSL_SESSION_get_time(sess);
+    if(time(NULL) - issued > SEATS_EARLY_DATA_WINDOW_S){
+        seats_log_debug("Ticket too old for early data");
+        return 0;
+    }
+    len = SSL_SESSION_get_master_key(sess, secret, sizeof(secret));
+    if(!len || !SHA256(secret, len, digest)) return 0;
+    OPENSSL_cleanse(secret, sizeof(secret));
+    if(!replays().first_use(digest, sizeof(digest), issued)){
+        seats_log_warn("Replayed early data rejected");
+        return 0;
+    }
+    return 1;
+}
+
+seats_status seats_stc_socket::create_context(){
+    return new_context(m_attester, &ssl_context);
 }
 
-seats_status seats_stc_socket::create_context(){ 
+seats_status seats_stc_socket::new_context(attester* t_attester, SSL_CTX** out){ 
     const SSL_METHOD *method = TLS_server_method();
     SSL_CTX *ctx = SSL_CTX_new(method);
+    const unsigned char* keys = ticket_keys(t_attester);
     int extension_adding_result;
 
+    *out = NULL;
     if (ctx == NULL) {
-        perror("Unable to create SSL context");
-        ssl_context = NULL;
+        seats_log_error("Unable to create SSL context");
         return seats_status::UNABLE_TO_CREATE_SSL_CONTEXT;
     }
 
     if (SSL_CTX_use_certificate_chain_file(ctx, SEATS_CERT_FILE_PATH) <= 0) {
-        perror("Unable to add cert chain file.");
-        ERR_print_errors_fp(stderr);
+        seats_log_error("Unable to add cert chain file.");
+        seats_log_ssl_errors();
+        SSL_CTX_free(ctx);
         return seats_status::UNABLE_TO_CREATE_SSL_CONTEXT;
     }
 
     if (SSL_CTX_use_PrivateKey_file(ctx, SEATS_KEY_FILE_PATH, SSL_FILETYPE_PEM) <= 0) {
-        perror("Unable to add key file.");
-        ERR_print_errors_fp(stderr);
+        seats_log_error("Unable to add key file.");
+        seats_log_ssl_errors();
+        SSL_CTX_free(ctx);
         return seats_status::UNABLE_TO_CREATE_SSL_CONTEXT;
     }
 
+    // The callbacks find their socket through the app data of the session
     extension_adding_result = 
         SSL_CTX_add_custom_ext(ctx,
                                 ATTESTATION_CLIENT_HELLO_EXTENSION_TYPE,
                                 SSL_EXT_CLIENT_HELLO | SSL_EXT_TLS1_3_CERTIFICATE,
                                 server_certificate_ext_add_cb, 
                                 server_certificate_ext_free_cb, 
-                                this, 
+                                NULL, 
                                 client_hello_ext_parse_cb,
-                                this);
+                                NULL);
 
     if(!extension_adding_result){
-        perror("Unable to add attestation extensions");
+        seats_log_error("Unable to add attestation extensions");
         SSL_CTX_free(ctx);
-        ssl_context = NULL;
         return seats_status::FAILED_TO_ADD_SSL_EXTENSIONS;
     }
 
-    ssl_context = ctx; 
+    // Stateless tickets, replays of early data are caught by replay_store
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+    SSL_CTX_set_options(ctx, SSL_OP_NO_ANTI_REPLAY);
+    SSL_CTX_set_timeout(ctx, SEATS_ATTESTATION_MAX_AGE_S);
+    SSL_CTX_set_allow_early_data_cb(ctx, allow_early_data_cb, NULL);
+    if(!keys || SSL_CTX_set_tlsext_ticket_keys(ctx, (void*)keys, 80) != 1)
+        seats_log_warn("Unable to set shared ticket keys, tickets are per server");
+
+    if(t_attester->configure_ssl_ctx(ctx)){
+        SSL_CTX_free(ctx);
+        return seats_status::UNABLE_TO_CONFIGURE_SSL_CONTEXT;
+    }
+
+    *out = ctx; 
 
     return seats_status::OK;
 }
+
+void seats_stc_socket::set_max_early_data(SSL_CTX* ctx, uint32_t max_early_data){
+    SSL_CTX_set_max_early_data(ctx, max_early_data);
+    SSL_CTX_set_recv_max_early_data(ctx, max_early_data);
+}
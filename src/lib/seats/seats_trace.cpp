@@ -0,0 +1,243 @@
+#include "seats/seats_trace.hpp"
+#include "ssl_ext/log.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace seats;
+
+static std::atomic<bool> tracing{false};
+static std::atomic<uint32_t> sample_every{100};
+static std::atomic<uint64_t> slow_ns{0};
+
+// Never destroyed, the exit handler writes it after statics are gone
+struct trace_ring{
+    std::mutex lock;
+    std::vector<trace_span_record> spans;
+    size_t next = 0;
+};
+
+static trace_ring* ring(){
+    static trace_ring* r = new trace_ring();
+    return r;
+}
+
+// The trace being recorded by this thread
+struct thread_trace{
+    bool active = false;
+    bool sampled = false;
+    uint64_t hi = 0;
+    uint64_t lo = 0;
+    int32_t current = -1;
+    uint32_t tid = 0;
+    uint64_t roots = 0;
+    uint64_t rng = 0;
+    std::vector<trace_span_record> spans;
+};
+
+static thread_local thread_trace tt;
+
+// splitmix64
+static uint64_t next_id(thread_trace& t){
+    uint64_t z = (t.rng += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static void commit(thread_trace& t){
+    trace_ring* r = ring();
+    std::lock_guard<std::mutex> lk(r->lock);
+
+    for(trace_span_record& s : t.spans){
+        if(r->spans.size() < SEATS_TRACE_RING_SPANS){
+            r->spans.push_back(s);
+            continue;
+        }
+        r->spans[r->next] = s;
+        r->next = (r->next + 1) % SEATS_TRACE_RING_SPANS;
+    }
+}
+
+static void finish(thread_trace& t){
+    trace_span_record& root = t.spans[0];
+    uint64_t slow = slow_ns.load(std::memory_order_relaxed);
+
+    if(t.sampled || (slow && root.end_ns - root.start_ns >= slow))
+        commit(t);
+    t.spans.clear();
+    t.active = false;
+    t.current = -1;
+}
+
+uint64_t trace::now(){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+trace_span::trace_span(const char* name, bool root, uint64_t start_ns){
+    thread_trace& t = tt;
+
+    if(!t.active){
+        if(!root || !tracing.load(std::memory_order_relaxed)) return;
+
+        uint32_t every = sample_every.load(std::memory_order_relaxed);
+        bool sampled = every && t.roots++ % every == 0;
+        if(!sampled && !slow_ns.load(std::memory_order_relaxed)) return;
+
+        if(!t.tid){
+            t.tid = syscall(SYS_gettid);
+            t.rng = ((uint64_t)std::random_device{}() << 32) ^ std::random_device{}() ^ t.tid;
+        }
+        t.active = true;
+        t.sampled = sampled;
+        t.hi = next_id(t);
+        t.lo = next_id(t);
+        this->root = true;
+    }
+    if(t.spans.size() >= SEATS_TRACE_MAX_SPANS) return;
+
+    index = t.spans.size();
+    parent = t.current;
+    t.spans.push_back({t.hi, t.lo, (uint32_t)index + 1, (uint32_t)(parent + 1), name,
+        start_ns ? start_ns : trace::now(), 0, t.tid});
+    t.current = index;
+}
+
+trace_span::~trace_span(){
+    if(index < 0) return;
+
+    thread_trace& t = tt;
+    t.spans[index].end_ns = trace::now();
+    t.current = parent;
+    if(root) finish(t);
+}
+
+void trace::record(const char* name, uint64_t start_ns, uint64_t end_ns){
+    thread_trace& t = tt;
+
+    if(!t.active || t.spans.size() >= SEATS_TRACE_MAX_SPANS) return;
+    t.spans.push_back({t.hi, t.lo, (uint32_t)t.spans.size() + 1, (uint32_t)(t.current + 1), name,
+        start_ns, end_ns, t.tid});
+}
+
+void trace::enable(uint32_t every, uint64_t slow_us){
+    sample_every.store(every, std::memory_order_relaxed);
+    slow_ns.store(slow_us * 1000, std::memory_order_relaxed);
+    tracing.store(true, std::memory_order_relaxed);
+}
+
+void trace::disable(){ tracing.store(false, std::memory_order_relaxed); }
+
+bool trace::enabled(){ return tracing.load(std::memory_order_relaxed); }
+
+std::vector<trace_span_record> trace::collect(){
+    trace_ring* r = ring();
+    std::vector<trace_span_record> out;
+    std::lock_guard<std::mutex> lk(r->lock);
+
+    out.reserve(r->spans.size());
+    out.insert(out.end(), r->spans.begin() + r->next, r->spans.end());
+    out.insert(out.end(), r->spans.begin(), r->spans.begin() + r->next);
+
+    // The oldest trace may be partly overwritten, start at a root
+    size_t first = 0;
+    while(first < out.size() && out[first].span != 1)
+        first++;
+    out.erase(out.begin(), out.begin() + first);
+    return out;
+}
+
+void trace::clear(){
+    trace_ring* r = ring();
+    std::lock_guard<std::mutex> lk(r->lock);
+    r->spans.clear();
+    r->next = 0;
+}
+
+static int64_t unix_offset_ns(){
+    int64_t wall = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    return wall - (int64_t)trace::now();
+}
+
+static void write_chrome(FILE* f, const std::vector<trace_span_record>& spans, int64_t offset){
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    for(size_t i = 0; i < spans.size(); i++){
+        const trace_span_record& s = spans[i];
+        fprintf(f, "%s\n{\"name\":\"%s\",\"cat\":\"seats\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                   "\"pid\":%d,\"tid\":%u,\"args\":{\"trace_id\":\"%016lx%016lx\",\"span_id\":%u,\"parent_id\":%u}}",
+            i ? "," : "", s.name, (s.start_ns + offset) / 1e3, (s.end_ns - s.start_ns) / 1e3,
+            (int)getpid(), s.tid, (unsigned long)s.trace_hi, (unsigned long)s.trace_lo, s.span, s.parent);
+    }
+    fprintf(f, "\n]}\n");
+}
+
+// Span ids are the trace's low half with the span number in the low bits
+static unsigned long otlp_span_id(const trace_span_record& s, uint32_t span){
+    return (unsigned long)((s.trace_lo & ~0xffffffffull) | span);
+}
+
+static void write_otlp(FILE* f, const std::vector<trace_span_record>& spans, int64_t offset){
+    fprintf(f, "{\"resourceSpans\":[{\"resource\":{\"attributes\":["
+               "{\"key\":\"service.name\",\"value\":{\"stringValue\":\"seats\"}},"
+               "{\"key\":\"process.pid\",\"value\":{\"intValue\":\"%d\"}}]},"
+               "\"scopeSpans\":[{\"scope\":{\"name\":\"seats\"},\"spans\":[", (int)getpid());
+    for(size_t i = 0; i < spans.size(); i++){
+        const trace_span_record& s = spans[i];
+        char parent[48] = "";
+        if(s.parent)
+            snprintf(parent, sizeof(parent), "\"parentSpanId\":\"%016lx\",", otlp_span_id(s, s.parent));
+        fprintf(f, "%s\n{\"traceId\":\"%016lx%016lx\",\"spanId\":\"%016lx\",%s\"name\":\"%s\",\"kind\":1,"
+                   "\"startTimeUnixNano\":\"%lu\",\"endTimeUnixNano\":\"%lu\","
+                   "\"attributes\":[{\"key\":\"thread.id\",\"value\":{\"intValue\":\"%u\"}}]}",
+            i ? "," : "", (unsigned long)s.trace_hi, (unsigned long)s.trace_lo, otlp_span_id(s, s.span),
+            parent, s.name, (unsigned long)(s.start_ns + offset), (unsigned long)(s.end_ns + offset), s.tid);
+    }
+    fprintf(f, "\n]}]}]}\n");
+}
+
+int trace::write(const char* path, trace_format format){
+    std::vector<trace_span_record> spans = collect();
+    FILE* f = fopen(path, "w");
+
+    if(!f){
+        seats_log_error("Unable to open trace file %s: %s", path, strerror(errno));
+        return 1;
+    }
+    if(format == trace_format::OTLP) write_otlp(f, spans, unix_offset_ns());
+    else write_chrome(f, spans, unix_offset_ns());
+    if(fclose(f)){
+        seats_log_error("Unable to write trace file %s: %s", path, strerror(errno));
+        return 1;
+    }
+    return 0;
+}
+
+static void write_env_file(){
+    const char* path = getenv(SEATS_TRACE_FILE_ENV);
+    const char* format = getenv(SEATS_TRACE_FORMAT_ENV);
+
+    trace::write(path, format && !strcmp(format, "otlp") ? trace_format::OTLP : trace_format::CHROME);
+}
+
+static bool enable_from_env(){
+    const char* path = getenv(SEATS_TRACE_FILE_ENV);
+    const char* sample = getenv(SEATS_TRACE_SAMPLE_ENV);
+    const char* slow = getenv(SEATS_TRACE_SLOW_US_ENV);
+
+    if(!path || !*path) return false;
+    trace::enable(sample ? strtoul(sample, NULL, 10) : 100, slow ? strtoull(slow, NULL, 10) : 0);
+    atexit(write_env_file);
+    return true;
+}
+
+[[maybe_unused]] static const bool env_tracing = enable_from_env();
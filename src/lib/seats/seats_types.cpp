@@ -0,0 +1,45 @@
+#include "seats/seats_types.hpp"
+
+using namespace seats;
+
+#define STATUS_NAME(x) case seats_status::x: return #x;
+
+const char* seats::seats_status_name(seats_status s){
+    switch (s) {
+        STATUS_NAME(OK)
+        STATUS_NAME(UNABLE_TO_CREATE_SOCKET)
+        STATUS_NAME(UNABLE_TO_BIND_SOCKET)
+        STATUS_NAME(UNABLE_TO_LISTEN)
+        STATUS_NAME(UNABLE_TO_SOCKET_REUSE_ADR)
+        STATUS_NAME(UNABLE_TO_ACCEPT_CONNECTION)
+        STATUS_NAME(UNABLE_TO_CREATE_SSL_CONTEXT)
+        STATUS_NAME(FAILED_TO_ADD_SSL_EXTENSIONS)
+        STATUS_NAME(UNABLE_TO_CONFIGURE_SSL_CONTEXT)
+        STATUS_NAME(UNABLE_TO_GENERATE_PRIVATE_KEY)
+        STATUS_NAME(UNABLE_TO_CREATE_X509)
+        STATUS_NAME(FAILED_TO_SET_SERIAL_NUMBER)
+        STATUS_NAME(FAILED_TO_SET_X509_BEGIN)
+        STATUS_NAME(FAILED_TO_SET_X509_END)
+        STATUS_NAME(FAILED_TO_SET_X509_PUBKEY)
+        STATUS_NAME(FAILED_TO_GET_X509_NAME)
+        STATUS_NAME(FAILED_TO_SET_X509_NAME_1)
+        STATUS_NAME(FAILED_TO_SET_X509_NAME_2)
+        STATUS_NAME(FAILED_TO_SET_X509_NAME_3)
+        STATUS_NAME(FAILED_TO_SET_X509_NAME_4)
+        STATUS_NAME(FAILED_TO_SIGN_X509)
+        STATUS_NAME(UNABLE_TO_CREATE_SSL_SESSION)
+        STATUS_NAME(UNABLE_TO_SET_SOCKET_FOR_SSL_SESSION)
+        STATUS_NAME(UNABLE_TO_ACCEPT_SESSION)
+        STATUS_NAME(FAILED_VERIFICATION)
+        STATUS_NAME(CONNECTION_ERROR)
+        STATUS_NAME(RECEIVING_FAILED)
+        STATUS_NAME(ATTESTATION_INVALID)
+        STATUS_NAME(SENDING_FAILED)
+        STATUS_NAME(MESSAGE_TOO_LARGE)
+        STATUS_NAME(CONNECTION_CLOSED)
+        STATUS_NAME(UNABLE_TO_SET_SOCKET_OPTION)
+        STATUS_NAME(UNABLE_TO_RESOLVE_HOST)
+        STATUS_NAME(NOT_IMPLEMENTED_ERROR)
+    }
+    return "UNKNOWN";
+}
@@ -1,42 +1,57 @@
 #include "ssl_ext/attestation_ext_structs.hpp"
 #include "attest/sev/sev_structs.hpp"
+#include "ssl_ext/cbor.hpp"
 #include <cstring>
 
-int AttestationExtension::serialize(const unsigned char** buff){
-    int len = sizeof(AttestationType);
-    int payload_len = 0;
-    const unsigned char* tmp;
-    const unsigned char* tmp_buff;
-
-    printf("Serializing evidence payload..\n");
-    len += payload_len = evidence_payload->serialize(&tmp); 
-    printf("Allocating buffer..\n");
-    tmp_buff = *buff = (const unsigned char*)new char[len]; 
-
-    printf("Setting attestation type..\n");
-    *(AttestationType*)tmp_buff = attestation_type;
-    tmp_buff += sizeof(AttestationType);
-    printf("Setting evidence_payload");
-    memcpy((void*)tmp_buff, tmp, payload_len);
-
-    printf("Deleting buffer.");
-    delete []tmp;
-    return len;
+using namespace seats::cbor;
+
+size_t codec<AttestationExtension>::size(const AttestationExtension& m){
+    return head_size(2) + head_size(cmw_type(m.attestation_type))
+        + bstr_size(m.evidence_payload->serialized_size());
 }
-int AttestationExtension::deserialize(const unsigned char* buff){
-    const unsigned char* tmp = buff;
-    attestation_type = *(AttestationType*)tmp;
-    tmp += sizeof(AttestationType);
 
-    switch (attestation_type) {
+void codec<AttestationExtension>::write(writer& w, const AttestationExtension& m){
+    size_t payload_len = m.evidence_payload->serialized_size();
+
+    w.array(2);
+    w.uint(cmw_type(m.attestation_type));
+    w.head(BSTR, payload_len);
+
+    // Payload goes straight into the output, no intermediate buffer
+    if(!w.ok || m.evidence_payload->serialize(w.p, w.end - w.p) != (int)payload_len){
+        w.ok = false;
+        return;
+    }
+    w.p += payload_len;
+}
+
+bool codec<AttestationExtension>::read(reader& r, AttestationExtension& m){
+    size_t n;
+    uint64_t type;
+
+    if(!r.array(&n) || n != 2) return false;
+    if(!r.uint(&type) || type < cmw_type(AMD_SEV) || type > cmw_type(INTEL_TDX)) return false;
+    if(!r.bytes(&m.evidence_data)) return false;
+
+    m.attestation_type = (AttestationType)(type - SEATS_CMW_CONTENT_FORMAT_BASE);
+    m.evidence_payload = NULL;
+
+    switch (m.attestation_type) {
         case AMD_SEV_SNP: 
-            evidence_payload = new SevEvidencePayload();
-            tmp += evidence_payload->deserialize(tmp);
             break;
         default:
-            evidence_payload = NULL; 
+            m.evidence_data = {};
             break;
     }
+    return true;
+}
+
+size_t AttestationExtension::serialized_size() const{ return encoded_size(*this); }
+
+int AttestationExtension::serialize(unsigned char* buff, size_t bufflen) const{
+    return encode(*this, buff, bufflen);
+}
 
-    return 0;
+int AttestationExtension::deserialize(std::span<const unsigned char> in){
+    return decode(*this, in);
 }
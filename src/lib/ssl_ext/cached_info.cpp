@@ -0,0 +1,87 @@
+#include "ssl_ext/cached_info.hpp"
+#include "attest/crypto_cache.hpp"
+#include "ssl_ext/log.hpp"
+
+#include <openssl/evp.h>
+
+using namespace seats;
+
+int get_cert_hash(std::span<const unsigned char> blob, cert_hash* hash){
+    EVP_MD_CTX* ctx = crypto_cache::md_ctx();
+    unsigned int len = SEATS_CERT_HASH_LEN;
+
+    if(!ctx || !EVP_DigestInit_ex2(ctx, crypto_cache::sha256(), NULL)
+            || !EVP_DigestUpdate(ctx, blob.data(), blob.size())
+            || !EVP_DigestFinal_ex(ctx, hash->data(), &len)){
+        seats_log_error("Failed to hash the cert blob");
+        return 1;
+    }
+    return 0;
+}
+
+static std::atomic<uint64_t> saved{0};
+
+// Least recently used key of m, by the used counter of its values
+template<typename M>
+static typename M::iterator oldest(M& m){
+    auto lru = m.begin();
+    for(auto it = m.begin(); it != m.end(); ++it)
+        if(it->second.used < lru->second.used) lru = it;
+    return lru;
+}
+
+std::shared_ptr<cert_cache> cert_cache::for_peer(const std::string& peer){
+    struct peer_entry{
+        std::shared_ptr<cert_cache> cache;
+        uint64_t used;
+    };
+    static std::mutex peers_lock;
+    static std::map<std::string, peer_entry> peers;
+    static uint64_t peer_uses = 0;
+    std::lock_guard<std::mutex> lk(peers_lock);
+
+    auto it = peers.find(peer);
+    if(it == peers.end()){
+        if(peers.size() >= SEATS_CERT_CACHE_MAX_PEERS) peers.erase(oldest(peers));
+        it = peers.emplace(peer, peer_entry{std::make_shared<cert_cache>(), 0}).first;
+    }
+    it->second.used = ++peer_uses;
+    return it->second.cache;
+}
+
+uint64_t cert_cache::bytes_saved(){ return saved; }
+
+void cert_cache::add_bytes_saved(uint64_t n){ saved += n; }
+
+void cert_cache::put(std::span<const unsigned char> blob){
+    cert_hash hash;
+    if(get_cert_hash(blob, &hash)) return;
+
+    std::lock_guard<std::mutex> lk(lock);
+    auto it = blobs.find(hash);
+    if(it == blobs.end()){
+        if(blobs.size() >= SEATS_CERT_CACHE_MAX_ENTRIES) blobs.erase(oldest(blobs));
+        it = blobs.emplace(hash, entry{std::make_shared<const std::string>((const char*)blob.data(), blob.size()), 0}).first;
+    }
+    it->second.used = ++uses;
+}
+
+cert_blob cert_cache::get(const cert_hash& hash){
+    std::lock_guard<std::mutex> lk(lock);
+    auto it = blobs.find(hash);
+    if(it == blobs.end()) return NULL;
+    it->second.used = ++uses;
+    return it->second.blob;
+}
+
+void cert_cache::hashes(std::vector<cert_hash>& out){
+    std::lock_guard<std::mutex> lk(lock);
+    out.clear();
+    for(auto& entry: blobs)
+        out.push_back(entry.first);
+}
+
+void cert_cache::clear(){
+    std::lock_guard<std::mutex> lk(lock);
+    blobs.clear();
+}
@@ -0,0 +1,123 @@
+#include "ssl_ext/cbor.hpp"
+
+#include <cstring>
+
+using namespace seats::cbor;
+
+void writer::head(major_type mt, uint64_t v){
+    size_t len = head_size(v);
+    unsigned char ib = mt << 5;
+
+    if(!ok || (size_t)(end - p) < len){
+        ok = false;
+        return;
+    }
+
+    switch (len) {
+        case 1: *p++ = ib | v; return;
+        case 2: *p++ = ib | 24; break;
+        case 3: *p++ = ib | 25; break;
+        case 5: *p++ = ib | 26; break;
+        default: *p++ = ib | 27; break;
+    }
+    for(size_t i = len - 1; i > 0; i--)
+        *p++ = v >> (8 * (i - 1));
+}
+
+void writer::sint(int64_t v){
+    if(v < 0) head(NINT, ~(uint64_t)v);
+    else head(UINT, v);
+}
+
+void writer::bytes(std::span<const unsigned char> b){
+    head(BSTR, b.size());
+    if(!ok || (size_t)(end - p) < b.size()){
+        ok = false;
+        return;
+    }
+    memcpy(p, b.data(), b.size());
+    p += b.size();
+}
+
+void writer::text(const char* s, size_t len){
+    head(TSTR, len);
+    if(!ok || (size_t)(end - p) < len){
+        ok = false;
+        return;
+    }
+    memcpy(p, s, len);
+    p += len;
+}
+
+major_type reader::peek(){
+    if(!ok || p >= end) return (major_type)0xff;
+    return (major_type)(*p >> 5);
+}
+
+bool reader::head(major_type mt, uint64_t* v){
+    size_t len;
+    unsigned char ai;
+
+    if(!ok || p >= end || (*p >> 5) != mt) return ok = false;
+
+    ai = *p & 0x1f;
+    switch (ai) {
+        case 24: len = 1; break;
+        case 25: len = 2; break;
+        case 26: len = 4; break;
+        case 27: len = 8; break;
+        default:
+            if(ai > 27) return ok = false;
+            *v = ai;
+            p++;
+            return true;
+    }
+
+    if((size_t)(end - p) < len + 1) return ok = false;
+    p++;
+    *v = 0;
+    for(size_t i = 0; i < len; i++)
+        *v = (*v << 8) | *p++;
+
+    // Only the preferred (shortest) form, the encoding has to be
+    // deterministic since the client signs over what it re-encodes
+    if(head_size(*v) != len + 1) return ok = false;
+    return true;
+}
+
+bool reader::sint(int64_t* v){
+    uint64_t u;
+    if(peek() == NINT){
+        if(!head(NINT, &u) || u > INT64_MAX) return ok = false;
+        *v = ~(int64_t)u;
+        return true;
+    }
+    if(!head(UINT, &u) || u > INT64_MAX) return ok = false;
+    *v = u;
+    return true;
+}
+
+bool reader::bytes(std::span<const unsigned char>* b){
+    uint64_t len;
+    if(!head(BSTR, &len) || (uint64_t)(end - p) < len) return ok = false;
+    *b = {p, (size_t)len};
+    p += len;
+    return true;
+}
+
+bool reader::text(const char** s, size_t* len){
+    uint64_t l;
+    if(!head(TSTR, &l) || (uint64_t)(end - p) < l) return ok = false;
+    *s = (const char*)p;
+    *len = l;
+    p += l;
+    return true;
+}
+
+bool reader::array(size_t* n){
+    uint64_t l;
+    // Every element takes at least one byte
+    if(!head(ARRAY, &l) || (uint64_t)(end - p) < l) return ok = false;
+    *n = l;
+    return true;
+}
@@ -1,37 +1,49 @@
 
 // CLIENT HELLO EXTENSION
 #include "ssl_ext/client_ext_cbs.hpp"
+#include "attest/evidence_corpus.hpp"
 #include "attest/verifier.hpp"
 #include "ssl_ext/attestation_ext_structs.hpp"
 #include "seats/seats_client_socket.hpp"
+#include "seats/seats_trace.hpp"
 #include "ssl_ext/evidence_ext_structs.hpp"
+#include "ssl_ext/handshake_arena.hpp"
 #include <cstdlib>
 #include <openssl/ssl.h>
 #include <openssl/x509.h>
 
 
 #define UNUSED(x) (void)(x)
-int seats::client_hello_ext_add_cb(SSL *, unsigned int,
+int seats::client_hello_ext_add_cb(SSL *s, unsigned int,
                                         unsigned int,
                                         const unsigned char **out,
                                         size_t *outlen, X509 *,
-                                        size_t, int *,
+                                        size_t, int *al,
                                         void *add_arg)
 {
+    seats::trace_span span("ext.client_hello_add");
     seats::seats_client_socket* client_skt = (seats::seats_client_socket*)add_arg;
+    size_t bufflen = client_skt->erq->serialized_size();
+    unsigned char* buff = (unsigned char*)seats::arena::get(s)->alloc(bufflen, 1);
+    int len;
 
-    *outlen = client_skt->erq->serialize(out);
+    if(!buff || (len = client_skt->erq->serialize(buff, bufflen)) < 0){
+        *al = SSL_AD_INTERNAL_ERROR;
+        return -1;
+    }
 
+    *out = buff;
+    *outlen = len;
     return 1;
 }
 
+// Extension buffer is released with the handshake arena
 void seats::client_hello_ext_free_cb(SSL *, unsigned int,
                                           unsigned int,
                                           const unsigned char *out,
                                           void *)
 {
     UNUSED(out);
-    delete []out;
 }
 
 // SERVER CERTIFICATE EXTENTSION 
@@ -39,18 +51,26 @@ int  seats::server_certificate_ext_parse_cb(SSL *, unsigned int,
                                           unsigned int,
                                           const unsigned char *in,
                                           size_t inlen, X509 *x,
-                                          size_t chainidx, int *,
+                                          size_t chainidx, int *al,
                                           void *parse_arg)
 {
-    UNUSED(inlen);
-
     if(chainidx == 0){
+        seats::trace_span span("ext.certificate_parse");
         EVP_PKEY* pkey = X509_get0_pubkey(x);
-        AttestationExtension* aex = new AttestationExtension();       
+        AttestationExtension aex;
         seats::seats_client_socket* cs = (seats::seats_client_socket*) parse_arg;
-        aex->deserialize(in);
-        if(cs->verify(aex, pkey)){
-            cs->close();
+        // The session is still in use here, connect cleans up after the
+        // handshake failed
+        if(aex.deserialize({in, inlen}) < 0){
+            *al = SSL_AD_DECODE_ERROR;
+            return false;
+        }
+        seats::seats_status result = cs->verify(&aex, pkey);
+        if(seats::evidence_recorder* rec = seats::evidence_recorder::from_env())
+            rec->append(cs->erq, {in, inlen}, pkey, result);
+        if(result){
+            cs->verify_status = result;
+            *al = SSL_AD_HANDSHAKE_FAILURE;
             return false;
         }
     }
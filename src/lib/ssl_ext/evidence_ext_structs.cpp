@@ -1,117 +1,136 @@
 #include "ssl_ext/evidence_ext_structs.hpp"
 #include "seats/seats_types.hpp"
+#include "ssl_ext/cbor.hpp"
 #include <cstdio>
 #include <cstring>
-#include <utility>
 
+using namespace seats::cbor;
 
 void print_string_hex(const unsigned char* s, int len){
     for(int i = 0; i < len; i++)
         printf("%02x", (unsigned int) *s++);
 }
 
-int EvidenceType::serialize(const unsigned char** buff){
-    // Calculate length
-    int len = sizeof(CredentialKind) + sizeof(TypeEncoding);
-    int mt_len;
-    switch (type_encoding) {
+size_t codec<EvidenceType>::size(const EvidenceType& m){
+    switch (m.type_encoding) {
         case TypeEncoding::CONTENT_FORMAT:
-            len += sizeof(ContentFormat); 
-            break;
+            return content_format_size(m.credential_kind, m.supported_content.content_format);
         case TypeEncoding::MEDIA_TYPE:
-            len += mt_len = strlen(supported_content.media_type) + 1;
-            break;
+            return head_size(2) + head_size(m.credential_kind) + head_size(m.media_type_len) + m.media_type_len;
     }
+    return 0;
+}
 
-    // Allocate buffer
-    const unsigned char *tmp = *buff = (const unsigned char*)new char[len];
-    
-    *(CredentialKind*)tmp = credential_kind;
-    tmp += sizeof(CredentialKind);
-    
-    *(TypeEncoding*)tmp = type_encoding;
-    tmp += sizeof(type_encoding);
-
-    switch (type_encoding) {
+void codec<EvidenceType>::write(writer& w, const EvidenceType& m){
+    w.array(2);
+    w.uint(m.credential_kind);
+    switch (m.type_encoding) {
         case TypeEncoding::CONTENT_FORMAT:
-            *(ContentFormat*)tmp = supported_content.content_format;
-            tmp += sizeof(ContentFormat); 
+            w.uint(m.supported_content.content_format);
             break;
         case TypeEncoding::MEDIA_TYPE:
-            memcpy((void*)tmp, supported_content.media_type, mt_len);
-            tmp += mt_len;
+            w.text(m.supported_content.media_type, m.media_type_len);
             break;
     }
-    
-    return len;
 }
 
-int EvidenceType::deserialize(char* buff){
-    char* tmp = buff;
-    int mt_len;
-    credential_kind = *(CredentialKind*)tmp; 
-    tmp += sizeof(CredentialKind);
-
-    type_encoding = *(TypeEncoding*)tmp;
-    tmp += sizeof(TypeEncoding);
-
-    switch (type_encoding) {
-        case TypeEncoding::CONTENT_FORMAT:
-            supported_content.content_format = *(ContentFormat*)tmp;
-            tmp += sizeof(ContentFormat); 
-            break;
-        case TypeEncoding::MEDIA_TYPE:
-            mt_len = strlen(tmp) + 1;
-            memcpy(supported_content.media_type, (void*)tmp, mt_len);
-            tmp += mt_len;
-            break;
+bool codec<EvidenceType>::read(reader& r, EvidenceType& m){
+    size_t n;
+    uint64_t v;
+    const char* mt;
+
+    if(!r.array(&n) || n != 2) return false;
+    if(!r.uint(&v) || v > CredentialKind::CERT_ATTESTATION) return false;
+    m.credential_kind = (CredentialKind)v;
+
+    switch (r.peek()) {
+        case UINT:
+            if(!r.uint(&v) || v > ContentFormat::BINARY_FORMAT) return false;
+            m.type_encoding = TypeEncoding::CONTENT_FORMAT;
+            m.supported_content.content_format = (ContentFormat)v;
+            return true;
+        case TSTR:
+            if(!r.text(&mt, &m.media_type_len)) return false;
+            m.type_encoding = TypeEncoding::MEDIA_TYPE;
+            m.supported_content.media_type = (char*)mt;
+            return true;
+        default:
+            return false;
     }
-
-    return tmp - buff; 
 }
 
-int EvidenceRequestClient::serialize(const unsigned char** buff){
-
-    size_t vec_size = supported_evidence_types.size();
-    std::vector<std::pair<const unsigned char*, int>> buff_vec;
-    const unsigned char* tmp_buff;
-    int tmp_len = 0;
-    int len = sizeof(size_t) + sizeof(int64_t);
-   
-    for (EvidenceType& et: supported_evidence_types){
-        tmp_len = et.serialize(&tmp_buff); 
-        buff_vec.push_back(std::make_pair(tmp_buff, tmp_len)); 
-        len+=tmp_len;
-    }
-    
-    tmp_buff = *buff = (const unsigned char*)new char[len]; 
-    *(size_t*)tmp_buff = vec_size;
-    tmp_buff += sizeof(size_t);
-    *(int64_t*)tmp_buff = nonce;
-    tmp_buff += sizeof(int64_t);
-
-    for (auto& p: buff_vec){
-        memcpy((void*)tmp_buff, p.first, p.second);
-        tmp_buff += p.second;
-        delete []p.first;
-    }
+size_t codec<EvidenceRequestClient>::size(const EvidenceRequestClient& m){
+    size_t len = head_size(3) + head_size(SEATS_EXT_VERSION) + int_size(m.nonce)
+        + head_size(m.supported_evidence_types.size());
+    for (const EvidenceType& et: m.supported_evidence_types)
+        len += codec<EvidenceType>::size(et);
+    if(!m.cached_cert_hashes.empty())
+        len += head_size(m.cached_cert_hashes.size())
+            + m.cached_cert_hashes.size() * bstr_size(SEATS_CERT_HASH_LEN);
     return len;
 }
 
-int EvidenceRequestClient::deserialize(const unsigned char* buff){
+void codec<EvidenceRequestClient>::write(writer& w, const EvidenceRequestClient& m){
+    w.array(m.cached_cert_hashes.empty() ? 3 : 4);
+    w.uint(SEATS_EXT_VERSION);
+    w.sint(m.nonce);
+    w.array(m.supported_evidence_types.size());
+    for (const EvidenceType& et: m.supported_evidence_types)
+        codec<EvidenceType>::write(w, et);
+
+    if(m.cached_cert_hashes.empty()) return;
+    w.array(m.cached_cert_hashes.size());
+    for (const cert_hash& hash: m.cached_cert_hashes)
+        w.bytes(hash);
+}
 
+bool codec<EvidenceRequestClient>::read(reader& r, EvidenceRequestClient& m){
     EvidenceType tmp_et;
-    const unsigned char *tmp = buff;
+    std::span<const unsigned char> hash;
+    size_t n, fields;
+    uint64_t version;
+
+    if(!r.array(&fields) || fields < 3 || fields > 4) return false;
+    if(!r.uint(&version) || version != SEATS_EXT_VERSION) return false;
+    if(!r.sint(&m.nonce)) return false;
+    if(!r.array(&n)) return false;
+
+    // Keeps the capacity, a reused request does not allocate again
+    m.supported_evidence_types.clear();
+    for (size_t i = 0; i < n; i++){
+        if(!codec<EvidenceType>::read(r, tmp_et)) return false;
+        m.supported_evidence_types.push_back(tmp_et);
+    }
 
-    size_t vec_size = *(size_t*)tmp;
-    tmp += sizeof(size_t);
-    nonce = *(int64_t*)tmp;
-    tmp += sizeof(int64_t);
+    m.cached_cert_hashes.clear();
+    if(fields == 3) return true;
 
-    for (size_t i = 0; i < vec_size; i++){
-        tmp += tmp_et.deserialize((char*)tmp); 
-        supported_evidence_types.push_back(tmp_et);
+    // An empty list is left out, never sent as []
+    if(!r.array(&n) || !n) return false;
+    for (size_t i = 0; i < n; i++){
+        if(!r.bytes(&hash) || hash.size() != SEATS_CERT_HASH_LEN) return false;
+        m.cached_cert_hashes.emplace_back();
+        memcpy(m.cached_cert_hashes.back().data(), hash.data(), SEATS_CERT_HASH_LEN);
     }
-    
-    return tmp-buff;
+    return true;
+}
+
+size_t EvidenceType::serialized_size() const{ return encoded_size(*this); }
+
+int EvidenceType::serialize(unsigned char* buff, size_t bufflen) const{
+    return encode(*this, buff, bufflen);
+}
+
+int EvidenceType::deserialize(std::span<const unsigned char> in){
+    return decode(*this, in);
+}
+
+size_t EvidenceRequestClient::serialized_size() const{ return encoded_size(*this); }
+
+int EvidenceRequestClient::serialize(unsigned char* buff, size_t bufflen) const{
+    return encode(*this, buff, bufflen);
+}
+
+int EvidenceRequestClient::deserialize(std::span<const unsigned char> in){
+    return decode(*this, in);
 }
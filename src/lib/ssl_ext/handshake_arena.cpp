@@ -0,0 +1,90 @@
+#include "ssl_ext/handshake_arena.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <openssl/crypto.h>
+
+using namespace seats;
+
+static void arena_ex_free(void*, void* ptr, CRYPTO_EX_DATA*, int, long, void*){
+    delete (arena*)ptr;
+}
+
+static int arena_ex_index(){
+    static int index = SSL_get_ex_new_index(0, NULL, NULL, NULL, arena_ex_free);
+    return index;
+}
+
+// Replaces the callback of the SSL object, the one it had before (or the
+// one of its SSL_CTX, looked up on each call) still runs first
+static void arena_info_cb(const SSL* s, int where, int ret){
+    arena* a = arena::get(s);
+    arena::info_cb prev = a ? a->prev_info : NULL;
+
+    if(!prev)
+        prev = SSL_CTX_get_info_callback(SSL_get_SSL_CTX(s));
+    if(prev)
+        prev(s, where, ret);
+
+    if(a && (where & SSL_CB_HANDSHAKE_DONE))
+        a->reset();
+}
+
+arena::arena(size_t chunk_size): prev_info(NULL), head(NULL), chunk_size(chunk_size), total(0){}
+
+arena::~arena(){ reset(); }
+
+void* arena::alloc(size_t len, size_t align){
+    uintptr_t base, p;
+
+    if(head){
+        base = (uintptr_t)(head + 1);
+        p = (base + head->used + align - 1) & ~(uintptr_t)(align - 1);
+        if(p + len <= base + head->size){
+            head->used = p + len - base;
+            return (void*)p;
+        }
+    }
+
+    size_t size = len + align > chunk_size ? len + align : chunk_size;
+    chunk* c = (chunk*)malloc(sizeof(chunk) + size);
+    if(!c) return NULL;
+
+    c->next = head;
+    c->size = size;
+    c->used = 0;
+    head = c;
+    total += size;
+
+    base = (uintptr_t)(c + 1);
+    p = (base + align - 1) & ~(uintptr_t)(align - 1);
+    c->used = p + len - base;
+    return (void*)p;
+}
+
+void arena::reset(){
+    if(total > chunk_size)
+        chunk_size = total;
+
+    while(head){
+        chunk* next = head->next;
+        free(head);
+        head = next;
+    }
+    total = 0;
+}
+
+int arena::attach(SSL* s){
+    arena* a = new arena();
+    if(!SSL_set_ex_data(s, arena_ex_index(), a)){
+        delete a;
+        return 1;
+    }
+    a->prev_info = SSL_get_info_callback(s);
+    SSL_set_info_callback(s, arena_info_cb);
+    return 0;
+}
+
+arena* arena::get(const SSL* s){
+    return (arena*)SSL_get_ex_data(s, arena_ex_index());
+}
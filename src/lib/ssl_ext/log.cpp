@@ -1,12 +1,313 @@
 #include "ssl_ext/log.hpp"
 
-void SSL_keylog_cb(const SSL *, const char *line){
-    FILE  * fp;
-    fp = fopen("key_log.log", "a");
-    if (fp == NULL)
+#include <openssl/err.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <strings.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+using namespace seats;
+
+struct log_record{
+    uint64_t ts;
+    uint32_t tid;
+    uint16_t len;
+    uint8_t level;
+    char msg[SEATS_LOG_MSG_MAX];
+};
+
+// Single producer (the owning thread), single consumer (whoever holds
+// log_state::lock). head and tail only grow, slot is index % SLOTS.
+struct log_ring{
+    alignas(64) std::atomic<uint64_t> head{0};
+    alignas(64) std::atomic<uint64_t> tail{0};
+    std::atomic<bool> orphaned{false};
+    uint32_t tid;
+    log_record slots[SEATS_LOG_RING_SLOTS];
+};
+
+// Never destroyed, other threads can still log while statics go away
+struct log_state{
+    std::mutex lock;
+    std::vector<std::unique_ptr<log_ring>> rings;
+    std::vector<std::pair<log_ring*, uint64_t>> heads;
+    std::vector<const log_record*> batch;
+    std::vector<char> text;
+    FILE* out = stderr;
+
+    std::mutex wake_lock;
+    std::condition_variable cv;
+    bool wake = false;
+    bool stop = false;
+    std::thread flusher;
+
+    std::atomic<uint64_t> dropped{0};
+};
+
+static const char* level_names[] = {"TRACE", "DEBUG", "INFO", "WARN", "ERROR"};
+
+static FILE* keylog_fp = NULL;
+static std::once_flag keylog_once;
+static std::atomic<bool> keylog_dirty{false};
+
+static int env_level(){
+    const char* env = getenv("SEATS_LOG");
+    if(!env) return SEATS_LOG_INFO;
+    for(int i = SEATS_LOG_TRACE; i < SEATS_LOG_OFF; i++)
+        if(!strcasecmp(env, level_names[i])) return i;
+    if(!strcasecmp(env, "off")) return SEATS_LOG_OFF;
+    return SEATS_LOG_INFO;
+}
+
+std::atomic<int> logger::level{env_level()};
+
+static void append_record(std::vector<char>& text, const log_record* rec, time_t* last_sec, char* stamp){
+    time_t sec = rec->ts / 1000000000;
+    char line[48];
+    int n;
+
+    if(sec != *last_sec){
+        struct tm tm;
+        localtime_r(&sec, &tm);
+        strftime(stamp, 16, "%H:%M:%S", &tm);
+        *last_sec = sec;
+    }
+    n = snprintf(line, sizeof(line), "%s.%06u %-5s %u ", stamp,
+        (unsigned)(rec->ts % 1000000000 / 1000), level_names[rec->level], rec->tid);
+    text.insert(text.end(), line, line + n);
+    text.insert(text.end(), rec->msg, rec->msg + rec->len);
+    text.push_back('\n');
+}
+
+static void drain(log_state* st){
+    std::lock_guard<std::mutex> lk(st->lock);
+    time_t last_sec = -1;
+    char stamp[16];
+
+    st->heads.clear();
+    st->batch.clear();
+    st->text.clear();
+
+    for(auto& r: st->rings){
+        uint64_t t = r->tail.load(std::memory_order_relaxed);
+        uint64_t h = r->head.load(std::memory_order_acquire);
+        for(; t < h; t++)
+            st->batch.push_back(&r->slots[t % SEATS_LOG_RING_SLOTS]);
+        st->heads.emplace_back(r.get(), h);
+    }
+
+    // Rings are drained one after another, put threads back in time order
+    std::stable_sort(st->batch.begin(), st->batch.end(),
+        [](const log_record* a, const log_record* b){ return a->ts < b->ts; });
+    for(const log_record* rec: st->batch)
+        append_record(st->text, rec, &last_sec, stamp);
+
+    if(!st->text.empty()){
+        fwrite(st->text.data(), 1, st->text.size(), st->out);
+        fflush(st->out);
+    }
+
+    for(auto& [r, h]: st->heads)
+        r->tail.store(h, std::memory_order_release);
+
+    // Threads that exited and have nothing left in their ring
+    std::erase_if(st->rings, [](const std::unique_ptr<log_ring>& r){
+        return r->orphaned.load(std::memory_order_acquire)
+            && r->tail.load(std::memory_order_relaxed) == r->head.load(std::memory_order_acquire);
+    });
+
+    if(keylog_dirty.exchange(false, std::memory_order_relaxed))
+        fflush(keylog_fp);
+}
+
+static void flusher_main(log_state* st){
+    std::unique_lock<std::mutex> lk(st->wake_lock);
+    while(!st->stop){
+        st->cv.wait_for(lk, std::chrono::milliseconds(SEATS_LOG_FLUSH_MS),
+            [st]{ return st->wake || st->stop; });
+        st->wake = false;
+        lk.unlock();
+        drain(st);
+        lk.lock();
+    }
+}
+
+static log_state* state();
+
+static void stop_flusher(){
+    log_state* st = state();
+    {
+        std::lock_guard<std::mutex> lk(st->wake_lock);
+        st->stop = true;
+    }
+    st->cv.notify_one();
+    if(st->flusher.joinable()) st->flusher.join();
+    drain(st);
+}
+
+static log_state* state(){
+    static log_state* st = []{
+        log_state* st = new log_state();
+        st->flusher = std::thread(flusher_main, st);
+        atexit(stop_flusher);
+        return st;
+    }();
+    return st;
+}
+
+static void wake_flusher(log_state* st){
     {
-        printf("Failed to create log file\n");
+        std::lock_guard<std::mutex> lk(st->wake_lock);
+        st->wake = true;
     }
-    fprintf(fp, "%s\n", line);
-    fclose(fp);
+    st->cv.notify_one();
+}
+
+// Set once the thread's ring is handed to the flusher, trivially
+// destructible so it can still be read by later thread_local destructors
+static thread_local bool owner_gone = false;
+
+struct ring_owner{
+    log_ring* ring = NULL;
+    ~ring_owner(){
+        if(ring) ring->orphaned.store(true, std::memory_order_release);
+        ring = NULL;
+        owner_gone = true;
+    }
+};
+
+static thread_local ring_owner owner;
+
+// NULL while the thread exits, its ring may already be freed
+static log_ring* thread_ring(log_state* st){
+    if(owner_gone) return NULL;
+    if(!owner.ring){
+        std::unique_ptr<log_ring> r = std::make_unique<log_ring>();
+        r->tid = gettid();
+        owner.ring = r.get();
+        std::lock_guard<std::mutex> lk(st->lock);
+        st->rings.push_back(std::move(r));
+    }
+    return owner.ring;
+}
+
+static void fill_record(log_record* rec, int lvl, uint32_t tid, const char* fmt, va_list ap){
+    struct timespec ts;
+    int n;
+
+    n = vsnprintf(rec->msg, SEATS_LOG_MSG_MAX, fmt, ap);
+    n = std::clamp(n, 0, SEATS_LOG_MSG_MAX - 1);
+    while(n > 0 && rec->msg[n - 1] == '\n') n--;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    rec->ts = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    rec->tid = tid;
+    rec->len = n;
+    rec->level = std::clamp(lvl, SEATS_LOG_TRACE, SEATS_LOG_ERROR);
+}
+
+// Without a ring the record is written right away, after what the
+// thread's ring still holds
+static void write_direct(log_state* st, const log_record* rec){
+    std::vector<char> text;
+    time_t last_sec = -1;
+    char stamp[16];
+
+    drain(st);
+    append_record(text, rec, &last_sec, stamp);
+    std::lock_guard<std::mutex> lk(st->lock);
+    fwrite(text.data(), 1, text.size(), st->out);
+    fflush(st->out);
+}
+
+void logger::write(int lvl, const char* fmt, ...){
+    log_state* st = state();
+    log_ring* r = thread_ring(st);
+    va_list ap;
+
+    if(!r){
+        log_record rec;
+        va_start(ap, fmt);
+        fill_record(&rec, lvl, gettid(), fmt, ap);
+        va_end(ap);
+        write_direct(st, &rec);
+        return;
+    }
+
+    uint64_t h = r->head.load(std::memory_order_relaxed);
+    uint64_t used = h - r->tail.load(std::memory_order_acquire);
+
+    if(used >= SEATS_LOG_RING_SLOTS){
+        st->dropped.fetch_add(1, std::memory_order_relaxed);
+        wake_flusher(st);
+        return;
+    }
+
+    va_start(ap, fmt);
+    fill_record(&r->slots[h % SEATS_LOG_RING_SLOTS], lvl, r->tid, fmt, ap);
+    va_end(ap);
+    r->head.store(h + 1, std::memory_order_release);
+
+    // Errors go out right away, everything else when the ring fills up
+    // or on the next periodic flush
+    if(lvl >= SEATS_LOG_ERROR || used + 1 == SEATS_LOG_RING_SLOTS / 2)
+        wake_flusher(st);
+}
+
+static int openssl_error_cb(const char* str, size_t len, void* u){
+    logger::write(*(int*)u, "%.*s", (int)len, str);
+    return 1;
+}
+
+void logger::openssl_errors(int lvl){
+    ERR_print_errors_cb(openssl_error_cb, &lvl);
+}
+
+void logger::set_level(int lvl){
+    level.store(lvl, std::memory_order_relaxed);
+}
+
+void logger::set_output(FILE* fp){
+    log_state* st = state();
+    drain(st);
+    std::lock_guard<std::mutex> lk(st->lock);
+    st->out = fp;
+}
+
+void logger::flush(){
+    drain(state());
+}
+
+uint64_t logger::dropped(){
+    return state()->dropped.load(std::memory_order_relaxed);
+}
+
+// Secrets are only written when SSLKEYLOGFILE asks for them. One buffered
+// handle for the whole process, flushed by the log thread.
+void SSL_keylog_cb(const SSL *, const char *line){
+    std::call_once(keylog_once, []{
+        const char* path = getenv("SSLKEYLOGFILE");
+        if(!path || !*path) return;
+        keylog_fp = fopen(path, "a");
+        if(!keylog_fp){
+            seats_log_error("Failed to open key log file %s", path);
+            return;
+        }
+        setvbuf(keylog_fp, NULL, _IOFBF, 1 << 16);
+        state();
+    });
+    if(!keylog_fp) return;
+
+    fprintf(keylog_fp, "%s\n", line);
+    keylog_dirty.store(true, std::memory_order_relaxed);
 }
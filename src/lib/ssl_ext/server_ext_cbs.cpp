@@ -1,55 +1,91 @@
 
 
 // SERVER CERTIFICATE CALLBACKS
+#include "seats/seats_metrics.hpp"
+#include "seats/seats_probes.hpp"
+#include "seats/seats_trace.hpp"
 #include "seats/seats_types.hpp"
 #include "ssl_ext/attestation_ext_structs.hpp"
 #include "ssl_ext/evidence_ext_structs.hpp"
 #include "ssl_ext/server_ext_cbs.hpp"
 #include "seats/seats_stc_socket.hpp"
+#include "ssl_ext/handshake_arena.hpp"
+#include "ssl_ext/log.hpp"
 #include <cstdlib>
 
 #define UNUSED(x) (void)(x)
 
-int seats::server_certificate_ext_add_cb(SSL *, unsigned int,
+int seats::server_certificate_ext_add_cb(SSL *s, unsigned int,
                                         unsigned int,
                                         const unsigned char **out,
                                         size_t *outlen, X509 *,
-                                        size_t chainidx, int *,
-                                        void *add_arg)
+                                        size_t chainidx, int *al,
+                                        void *)
 {
 
     if(chainidx == 0){
-        seats::seats_stc_socket* ss = (seats::seats_stc_socket*)add_arg;
-        AttestationExtension* ax = ss->attest();
-        printf("Serializing attestation extension.\n");
-        *outlen = ax->serialize(out);
-        delete ax;
-        printf("Serialized and deleted.\n");
+        seats::trace_span span("ext.certificate_add");
+        seats::seats_stc_socket* ss = seats::seats_stc_socket::from_session(s);
+        seats::arena* a = seats::arena::get(s);
+        AttestationExtension ax;
+        unsigned char* buff;
+        size_t bufflen;
+        int len;
+
+        SEATS_PROBE0(certificate_add_start);
+        if(ss->attest(&ax)){
+            SEATS_PROBE1(certificate_add_end, -1);
+            *al = SSL_AD_INTERNAL_ERROR;
+            return -1;
+        }
+
+        seats_log_trace("Serializing attestation extension.");
+        seats::metric_timer t(seats::metric_phase::EVIDENCE_SERIALIZE);
+        bufflen = ax.serialized_size();
+        buff = (unsigned char*)a->alloc(bufflen, 1);
+        if(!buff || (len = ax.serialize(buff, bufflen)) < 0){
+            SEATS_PROBE1(certificate_add_end, -1);
+            *al = SSL_AD_INTERNAL_ERROR;
+            return -1;
+        }
+        SEATS_PROBE1(certificate_add_end, len);
+        *out = buff;
+        *outlen = len;
+        seats_log_trace("Serialized %d bytes.", len);
+        return 1;
     }
-    return 1;
+    return 0;
 }
 
+// Extension buffer is released with the handshake arena
 void seats::server_certificate_ext_free_cb(SSL *, unsigned int,
                                           unsigned int,
                                           const unsigned char *out,
                                           void *)
 {
-    delete []out;
+    UNUSED(out);
 }
 
 
 // CLIENT HELLO CALLBACKS
-int seats::client_hello_ext_parse_cb(SSL *, unsigned int,
+int seats::client_hello_ext_parse_cb(SSL *s, unsigned int,
                                           unsigned int,
                                           const unsigned char *in,
                                           size_t inlen, X509 *,
-                                          size_t, int *,
-                                          void *parse_arg)
+                                          size_t, int *al,
+                                          void *)
 
 {
-    UNUSED(inlen);
-    seats::seats_stc_socket* ss = (seats::seats_stc_socket*)parse_arg;
-    ss->m_attester->set_data((uint8_t*)in); 
+    seats::trace_span span("ext.client_hello_parse");
+    seats::seats_stc_socket* ss = seats::seats_stc_socket::from_session(s);
+    SEATS_PROBE1(client_hello_parse_start, inlen);
+    // Only keeps the request, it is signed when the Certificate is written
+    if(ss->m_attester->set_data(in, inlen, seats::arena::get(s))){
+        SEATS_PROBE1(client_hello_parse_end, 0);
+        *al = SSL_AD_DECODE_ERROR;
+        return 0;
+    }
+    SEATS_PROBE1(client_hello_parse_end, 1);
     // TODO: Add evidence output
     return 1;
 }
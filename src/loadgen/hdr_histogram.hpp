@@ -0,0 +1,93 @@
+#ifndef __HDR_HISTOGRAM_HPP__
+#define __HDR_HISTOGRAM_HPP__
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// 2048 sub buckets per power of two keep 3 significant digits
+#define HDR_SUB_BUCKET_BITS 11
+#define HDR_SUB_BUCKET_COUNT (1 << HDR_SUB_BUCKET_BITS)
+#define HDR_SUB_BUCKET_HALF_BITS (HDR_SUB_BUCKET_BITS - 1)
+#define HDR_SUB_BUCKET_HALF (1 << HDR_SUB_BUCKET_HALF_BITS)
+
+// Layout of HdrHistogram: values below 2048 have their own count, above
+// that every power of two is split into 1024 equal parts. Recording is an
+// index computation and an increment, one histogram per thread, merged
+// with add().
+class hdr_histogram{
+public:
+    hdr_histogram(uint64_t highest = 3600ull * 1000 * 1000) : highest(highest){
+        int buckets = 1;
+        for(uint64_t untrackable = HDR_SUB_BUCKET_COUNT; untrackable <= highest; untrackable <<= 1)
+            buckets++;
+        counts.assign((buckets + 1) * HDR_SUB_BUCKET_HALF, 0);
+    }
+
+    void record(uint64_t v){
+        v = std::min(v, highest);
+        counts[index(v)]++;
+        total++;
+        sum += v;
+        min_v = std::min(min_v, v);
+        max_v = std::max(max_v, v);
+    }
+
+    void add(const hdr_histogram& o){
+        for(size_t i = 0; i < std::min(counts.size(), o.counts.size()); i++)
+            counts[i] += o.counts[i];
+        total += o.total;
+        sum += o.sum;
+        min_v = std::min(min_v, o.min_v);
+        max_v = std::max(max_v, o.max_v);
+    }
+
+    // Highest value equivalent to the one at percentile p (0..100)
+    uint64_t percentile(double p) const{
+        uint64_t target = std::max<uint64_t>(1, (uint64_t)std::ceil(p / 100 * total));
+        uint64_t seen = 0;
+
+        if(!total) return 0;
+        for(size_t i = 0; i < counts.size(); i++){
+            if((seen += counts[i]) >= target){
+                int bucket;
+                uint64_t v = value_at(i, &bucket);
+                return std::min(v + ((uint64_t)1 << bucket) - 1, max_v);
+            }
+        }
+        return max_v;
+    }
+
+    uint64_t count() const{ return total; }
+    uint64_t min() const{ return total ? min_v : 0; }
+    uint64_t max() const{ return max_v; }
+    double mean() const{ return total ? (double)sum / total : 0; }
+
+private:
+    static size_t index(uint64_t v){
+        int bucket = 64 - __builtin_clzll(v | (HDR_SUB_BUCKET_COUNT - 1)) - HDR_SUB_BUCKET_BITS;
+        size_t sub = v >> bucket;
+        return ((size_t)(bucket + 1) << HDR_SUB_BUCKET_HALF_BITS) + sub - HDR_SUB_BUCKET_HALF;
+    }
+
+    static uint64_t value_at(size_t i, int* bucket){
+        int b = (int)(i >> HDR_SUB_BUCKET_HALF_BITS) - 1;
+        uint64_t sub = (i & (HDR_SUB_BUCKET_HALF - 1)) + HDR_SUB_BUCKET_HALF;
+        if(b < 0){
+            sub -= HDR_SUB_BUCKET_HALF;
+            b = 0;
+        }
+        *bucket = b;
+        return sub << b;
+    }
+
+    uint64_t highest;
+    std::vector<uint64_t> counts;
+    uint64_t total = 0;
+    uint64_t sum = 0;
+    uint64_t min_v = UINT64_MAX;
+    uint64_t max_v = 0;
+};
+
+#endif // !__HDR_HISTOGRAM_HPP__
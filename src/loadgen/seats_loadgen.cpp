@@ -0,0 +1,503 @@
+// seats-loadgen: open loop load against attested TLS servers, and the
+// server to run it against.
+//
+//   seats-loadgen [-m] [-F] [-R] [-0] [-M mode] [-r rate] [-d seconds] [-w workers]
+//                 [-s bytes] [-n messages] [-g grace] [-o file.json] <host> <port>
+//   seats-loadgen [-m] [-F] [-0] -S echo|sink|source [-t threads] <port>
+//
+// Client modes, one operation per arrival, each on a new connection:
+//   handshake  connect (full attested handshake) and close
+//   echo       -n round trips of -s bytes, against an echo server
+//   upload     -s bytes to a sink server, which acknowledges with one byte
+//   download   -s bytes from a source server
+// Sink and source read an 8 byte length first, echo returns everything.
+//
+// Arrivals are scheduled at a fixed rate no matter how many operations are
+// still running. Latency is taken from the scheduled start, so waiting for
+// a free worker or a slow server counts (no coordinated omission), service
+// time from the actual start is reported next to it. Failed operations
+// count at the time they failed, operations never started by the end of
+// the grace period at the time they had waited by then (a lower bound),
+// both are in "latency (all)" next to the successful ones. -m uses the mock
+// attester and verifier on both sides, -F turns TCP Fast Open on.
+// -R resumes sessions of earlier operations, -0 also sends the first echo
+// message as 0-RTT early data (the server needs -0 to accept it). Tickets
+// are only picked up while reading, -M handshake never resumes.
+#include "hdr_histogram.hpp"
+
+#include "seats/seats_client_socket.hpp"
+#include "seats/seats_server_socket.hpp"
+#include "seats/seats_types.hpp"
+#include "ssl_ext/log.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace seats;
+using lg_clock = std::chrono::steady_clock;
+
+#define LOADGEN_CHUNK (64 * 1024)
+
+enum class client_mode{ HANDSHAKE, ECHO, UPLOAD, DOWNLOAD };
+enum class server_mode{ ECHO, SINK, SOURCE };
+
+struct options{
+    bool mock = false;
+    seats_socket_options sock;
+    bool resume = false;
+    bool early = false;
+    bool server = false;
+    client_mode cmode = client_mode::HANDSHAKE;
+    server_mode smode = server_mode::ECHO;
+    double rate = 10;
+    double seconds = 10;
+    double grace = 10;
+    unsigned workers = 64;
+    unsigned threads = 1;
+    size_t size = 0;
+    unsigned messages = 10;
+    const char* json = NULL;
+    const char* host = NULL;
+    int port = 0;
+};
+
+static void usage(){
+    fprintf(stderr,
+        "Usage: seats-loadgen [-m] [-F] [-R] [-0] [-M handshake|echo|upload|download] [-r rate] [-d seconds]\n"
+        "                     [-w workers] [-s bytes] [-n messages] [-g grace] [-o file.json] <host> <port>\n"
+        "       seats-loadgen [-m] [-F] [-0] -S echo|sink|source [-t threads] <port>\n");
+    exit(EXIT_FAILURE);
+}
+
+static seats_status send_all(seats_socket* s, const char* data, size_t len){
+    return s->send(data, len) == (ssize_t)len ? seats_status::OK : seats_status::SENDING_FAILED;
+}
+
+static seats_status recv_all(seats_socket* s, char* data, size_t len){
+    for(size_t got = 0; got < len;){
+        ssize_t n = s->recv(data + got, len - got);
+        if(n == 0) return seats_status::CONNECTION_CLOSED;
+        if(n < 0) return seats_status::RECEIVING_FAILED;
+        got += n;
+    }
+    return seats_status::OK;
+}
+
+// SERVER
+
+static std::atomic<uint64_t> srv_accepted{0};
+static std::atomic<uint64_t> srv_failed{0};
+static std::atomic<uint64_t> srv_bytes{0};
+static std::atomic<uint64_t> srv_resumed{0};
+static std::atomic<uint64_t> srv_early{0};
+
+static void serve_connection(seats_socket* s, server_mode mode){
+    std::vector<char> buff(LOADGEN_CHUNK);
+    uint64_t len;
+    ssize_t n;
+
+    if(mode == server_mode::ECHO){
+        while((n = s->recv(buff.data(), buff.size())) > 0){
+            srv_bytes += n;
+            if(send_all(s, buff.data(), n)) break;
+        }
+        return;
+    }
+
+    // Sink and source serve requests until the client closes
+    while(!recv_all(s, (char*)&len, sizeof(len))){
+        if(mode == server_mode::SINK){
+            for(uint64_t got = 0; got < len; got += n){
+                if((n = s->recv(buff.data(), std::min<uint64_t>(buff.size(), len - got))) <= 0) return;
+                srv_bytes += n;
+            }
+            if(send_all(s, "k", 1)) return;
+        }
+        else{
+            s->cork();
+            for(uint64_t sent = 0; sent < len; sent += n){
+                n = std::min<uint64_t>(buff.size(), len - sent);
+                if(send_all(s, buff.data(), n)) return;
+                srv_bytes += n;
+            }
+            s->cork(false);
+        }
+    }
+}
+
+// The attester is not thread safe, every thread has its own listener on the
+// port and runs the handshakes of its connections, the transfer runs on a
+// thread per connection
+static void accept_loop(seats_server_socket* srv, server_mode mode){
+    seats_socket* s;
+
+    while((s = srv->accept())){
+        if(s->accept()){
+            srv_failed++;
+            delete s;
+            continue;
+        }
+        srv_accepted++;
+        if(s->session_resumed()) srv_resumed++;
+        if(s->early_data_accepted()) srv_early++;
+        std::thread([s, mode]{
+            serve_connection(s, mode);
+            delete s;
+        }).detach();
+    }
+}
+
+static int run_server(options& o){
+    std::vector<std::unique_ptr<seats_server_socket>> servers;
+    std::vector<std::thread> threads;
+    sigset_t set;
+    int sig;
+
+    // Only the main thread takes the signal that stops the server
+    sigemptyset(&set);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    for(unsigned i = 0; i < o.threads; i++){
+        servers.emplace_back(new seats_server_socket(o.port, o.mock, o.threads > 1, o.sock));
+        if(servers.back()->get_status()){
+            fprintf(stderr, "Unable to listen on port %d\n", o.port);
+            return EXIT_FAILURE;
+        }
+        if(o.early) servers.back()->enable_early_data();
+    }
+    for(auto& s : servers)
+        threads.emplace_back(accept_loop, s.get(), o.smode);
+
+    printf("seats-loadgen %s server on port %d, %u thread(s)%s\n",
+        o.smode == server_mode::ECHO ? "echo" : o.smode == server_mode::SINK ? "sink" : "source",
+        o.port, o.threads, o.mock ? ", mock" : "");
+    sigwait(&set, &sig);
+
+    logger::set_level(SEATS_LOG_OFF);
+    for(auto& s : servers)
+        shutdown(s->get_fd(), SHUT_RDWR);
+    for(auto& t : threads)
+        t.join();
+    printf("accepted %lu (resumed %lu, early data %lu), failed handshakes %lu, payload bytes %lu\n",
+        (unsigned long)srv_accepted, (unsigned long)srv_resumed, (unsigned long)srv_early,
+        (unsigned long)srv_failed, (unsigned long)srv_bytes);
+    return EXIT_SUCCESS;
+}
+
+// CLIENT
+
+struct worker_stats{
+    hdr_histogram latency;
+    hdr_histogram service;
+    hdr_histogram failed;
+    std::map<seats_status, uint64_t> errors;
+    uint64_t bytes = 0;
+    uint64_t resumed = 0;
+    uint64_t early = 0;
+};
+
+struct schedule{
+    std::mutex lock;
+    std::condition_variable ready;
+    // Scheduled start times nobody picked up yet
+    std::deque<lg_clock::time_point> queue;
+    size_t max_backlog = 0;
+    bool done = false;
+};
+
+static seats_status operation(seats_client_socket& cl, options& o, std::vector<char>& buff, worker_stats* st){
+    uint64_t* bytes = &st->bytes;
+    seats_status r;
+    uint64_t len = o.size;
+    bool early = false;
+
+    // The first echo message rides on the handshake
+    if(o.early && o.cmode == client_mode::ECHO && o.messages)
+        r = cl.connect(o.host, o.port, buff.data(), o.size, &early);
+    else
+        r = cl.connect(o.host, o.port);
+    if(r) return r;
+    if(cl.session_resumed()) st->resumed++;
+    if(early) st->early++;
+
+    switch (o.cmode) {
+        case client_mode::HANDSHAKE:
+            break;
+        case client_mode::ECHO:
+            for(unsigned i = 0; i < o.messages && !r; i++){
+                if(i || !o.early) r = send_all(&cl, buff.data(), o.size);
+                if(!r) r = recv_all(&cl, buff.data(), o.size);
+                if(!r) *bytes += o.size;
+            }
+            break;
+        case client_mode::UPLOAD:
+            cl.cork();
+            r = send_all(&cl, (char*)&len, sizeof(len));
+            for(uint64_t sent = 0, n; sent < len && !r; sent += n){
+                n = std::min<uint64_t>(buff.size(), len - sent);
+                r = send_all(&cl, buff.data(), n);
+            }
+            cl.cork(false);
+            if(!r) r = recv_all(&cl, buff.data(), 1);
+            if(!r) *bytes += len;
+            break;
+        case client_mode::DOWNLOAD:
+            r = send_all(&cl, (char*)&len, sizeof(len));
+            for(uint64_t got = 0, n; got < len && !r; got += n){
+                n = std::min<uint64_t>(buff.size(), len - got);
+                r = recv_all(&cl, buff.data(), n);
+            }
+            if(!r) *bytes += len;
+            break;
+    }
+    cl.close();
+    return r;
+}
+
+static void worker(schedule* sch, options* o, worker_stats* st){
+    seats_client_socket cl(o->mock, o->sock);
+    if(o->resume) cl.enable_resumption();
+    std::vector<char> buff(std::max<size_t>(o->size, 1));
+
+    if(o->cmode == client_mode::UPLOAD || o->cmode == client_mode::DOWNLOAD)
+        buff.resize(std::min<size_t>(buff.size(), LOADGEN_CHUNK));
+
+    for(;;){
+        lg_clock::time_point scheduled;
+        {
+            std::unique_lock<std::mutex> lk(sch->lock);
+            sch->ready.wait(lk, [&]{ return sch->done || !sch->queue.empty(); });
+            if(sch->queue.empty()) return;
+            scheduled = sch->queue.front();
+            sch->queue.pop_front();
+        }
+
+        auto start = lg_clock::now();
+        seats_status r = operation(cl, *o, buff, st);
+        auto end = lg_clock::now();
+
+        if(r){
+            st->errors[r]++;
+            st->failed.record(std::chrono::duration_cast<std::chrono::microseconds>(end - scheduled).count());
+            continue;
+        }
+        st->latency.record(std::chrono::duration_cast<std::chrono::microseconds>(end - scheduled).count());
+        st->service.record(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+    }
+}
+
+static const double report_percentiles[] = {50, 90, 99, 99.9, 99.99};
+
+static void print_histogram(const char* name, const hdr_histogram& h){
+    printf("%-22s %9lu %9lu", name, (unsigned long)h.min(), (unsigned long)h.percentile(report_percentiles[0]));
+    for(size_t i = 1; i < sizeof(report_percentiles) / sizeof(report_percentiles[0]); i++)
+        printf(" %9lu", (unsigned long)h.percentile(report_percentiles[i]));
+    printf(" %9lu %9.0f\n", (unsigned long)h.max(), h.mean());
+}
+
+static void json_histogram(FILE* f, const char* name, const hdr_histogram& h){
+    fprintf(f, "  \"%s\": {\"count\": %lu, \"min\": %lu, \"mean\": %.1f, \"max\": %lu", name,
+        (unsigned long)h.count(), (unsigned long)h.min(), h.mean(), (unsigned long)h.max());
+    for(double p : report_percentiles)
+        fprintf(f, ", \"p%g\": %lu", p, (unsigned long)h.percentile(p));
+    fprintf(f, "}");
+}
+
+static const char* mode_name(client_mode m){
+    switch (m) {
+        case client_mode::HANDSHAKE: return "handshake";
+        case client_mode::ECHO: return "echo";
+        case client_mode::UPLOAD: return "upload";
+        case client_mode::DOWNLOAD: return "download";
+    }
+    return "";
+}
+
+static int run_client(options& o){
+    schedule sch;
+    std::vector<worker_stats> stats(o.workers);
+    std::vector<std::thread> workers;
+    uint64_t scheduled = 0;
+    size_t unsent;
+    hdr_histogram unsent_latency;
+
+    for(unsigned i = 0; i < o.workers; i++)
+        workers.emplace_back(worker, &sch, &o, &stats[i]);
+
+    auto interval = std::chrono::duration_cast<lg_clock::duration>(std::chrono::duration<double>(1 / o.rate));
+    auto start = lg_clock::now();
+    auto end = start + std::chrono::duration_cast<lg_clock::duration>(std::chrono::duration<double>(o.seconds));
+
+    for(auto next = start; next < end; next = start + interval * ++scheduled){
+        std::this_thread::sleep_until(next);
+        std::lock_guard<std::mutex> lk(sch.lock);
+        sch.queue.push_back(next);
+        sch.max_backlog = std::max(sch.max_backlog, sch.queue.size());
+        sch.ready.notify_one();
+    }
+
+    // Operations still queued after the grace period never started
+    auto grace = lg_clock::now() + std::chrono::duration_cast<lg_clock::duration>(std::chrono::duration<double>(o.grace));
+    {
+        std::unique_lock<std::mutex> lk(sch.lock);
+        while(!sch.queue.empty() && lg_clock::now() < grace){
+            lk.unlock();
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            lk.lock();
+        }
+        unsent = sch.queue.size();
+        auto now = lg_clock::now();
+        for(auto& t : sch.queue)
+            unsent_latency.record(std::chrono::duration_cast<std::chrono::microseconds>(now - t).count());
+        sch.queue.clear();
+        sch.done = true;
+        sch.ready.notify_all();
+    }
+    for(auto& t : workers)
+        t.join();
+    double elapsed = std::chrono::duration<double>(lg_clock::now() - start).count();
+
+    worker_stats total;
+    for(auto& s : stats){
+        total.latency.add(s.latency);
+        total.service.add(s.service);
+        total.failed.add(s.failed);
+        total.bytes += s.bytes;
+        total.resumed += s.resumed;
+        total.early += s.early;
+        for(auto& e : s.errors)
+            total.errors[e.first] += e.second;
+    }
+    uint64_t errors = 0;
+    for(auto& e : total.errors)
+        errors += e.second;
+    uint64_t completed = total.latency.count();
+    hdr_histogram all;
+    all.add(total.latency);
+    all.add(total.failed);
+    all.add(unsent_latency);
+
+    printf("%s to %s:%d, target %.1f/s for %.1f s, %u workers%s\n", mode_name(o.cmode),
+        o.host, o.port, o.rate, o.seconds, o.workers, o.mock ? ", mock" : "");
+    printf("scheduled %lu, completed %lu, failed %lu, unsent %lu, max backlog %lu\n",
+        (unsigned long)scheduled, (unsigned long)completed, (unsigned long)errors,
+        (unsigned long)unsent, (unsigned long)sch.max_backlog);
+    printf("achieved %.1f/s", completed / elapsed);
+    if(total.bytes)
+        printf(", %.2f MB/s payload", total.bytes / elapsed / (1 << 20));
+    if(o.resume)
+        printf(", resumed %lu, early data %lu", (unsigned long)total.resumed, (unsigned long)total.early);
+    printf("\n");
+    for(auto& e : total.errors)
+        printf("  %-36s %lu\n", seats_status_name(e.first), (unsigned long)e.second);
+
+    printf("%-22s %9s %9s %9s %9s %9s %9s %9s %9s\n", "us", "min", "p50", "p90", "p99",
+        "p99.9", "p99.99", "max", "mean");
+    print_histogram("latency (scheduled)", total.latency);
+    print_histogram("service (started)", total.service);
+    if(errors) print_histogram("latency (failed)", total.failed);
+    if(unsent) print_histogram("latency (unsent, >=)", unsent_latency);
+    if(errors || unsent) print_histogram("latency (all)", all);
+
+    if(o.json){
+        FILE* f = fopen(o.json, "w");
+        if(!f){
+            perror(o.json);
+            return EXIT_FAILURE;
+        }
+        fprintf(f, "{\n  \"mode\": \"%s\",\n  \"mock\": %s,\n  \"target_rate\": %.3f,\n  \"seconds\": %.3f,\n"
+            "  \"workers\": %u,\n  \"size\": %zu,\n  \"scheduled\": %lu,\n  \"completed\": %lu,\n"
+            "  \"failed\": %lu,\n  \"unsent\": %lu,\n  \"max_backlog\": %zu,\n  \"achieved_rate\": %.3f,\n"
+            "  \"payload_bytes\": %lu,\n  \"resumed\": %lu,\n  \"early_data\": %lu,\n  \"errors\": {",
+            mode_name(o.cmode), o.mock ? "true" : "false", o.rate, o.seconds, o.workers, o.size,
+            (unsigned long)scheduled, (unsigned long)completed, (unsigned long)errors,
+            (unsigned long)unsent, sch.max_backlog, completed / elapsed, (unsigned long)total.bytes,
+            (unsigned long)total.resumed, (unsigned long)total.early);
+        const char* sep = "";
+        for(auto& e : total.errors){
+            fprintf(f, "%s\"%s\": %lu", sep, seats_status_name(e.first), (unsigned long)e.second);
+            sep = ", ";
+        }
+        fprintf(f, "},\n");
+        json_histogram(f, "latency_us", total.latency);
+        fprintf(f, ",\n");
+        json_histogram(f, "service_us", total.service);
+        fprintf(f, ",\n");
+        json_histogram(f, "failed_latency_us", total.failed);
+        fprintf(f, ",\n");
+        json_histogram(f, "unsent_latency_us", unsent_latency);
+        fprintf(f, ",\n");
+        json_histogram(f, "all_latency_us", all);
+        fprintf(f, "\n}\n");
+        fclose(f);
+    }
+    return errors || unsent ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv){
+    options o;
+    int opt;
+
+    while((opt = getopt(argc, argv, "mFR0M:r:d:w:s:n:g:o:S:t:")) != -1){
+        switch (opt) {
+            case 'm': o.mock = true; break;
+            case 'F': o.sock.fastopen = true; break;
+            case 'R': o.resume = true; break;
+            case '0': o.resume = o.early = true; break;
+            case 'M':
+                if(!strcmp(optarg, "handshake")) o.cmode = client_mode::HANDSHAKE;
+                else if(!strcmp(optarg, "echo")) o.cmode = client_mode::ECHO;
+                else if(!strcmp(optarg, "upload")) o.cmode = client_mode::UPLOAD;
+                else if(!strcmp(optarg, "download")) o.cmode = client_mode::DOWNLOAD;
+                else usage();
+                break;
+            case 'S':
+                o.server = true;
+                if(!strcmp(optarg, "echo")) o.smode = server_mode::ECHO;
+                else if(!strcmp(optarg, "sink")) o.smode = server_mode::SINK;
+                else if(!strcmp(optarg, "source")) o.smode = server_mode::SOURCE;
+                else usage();
+                break;
+            case 'r': o.rate = atof(optarg); break;
+            case 'd': o.seconds = atof(optarg); break;
+            case 'g': o.grace = atof(optarg); break;
+            case 'w': o.workers = std::max(1, atoi(optarg)); break;
+            case 't': o.threads = std::max(1, atoi(optarg)); break;
+            case 's': o.size = strtoul(optarg, NULL, 10); break;
+            case 'n': o.messages = strtoul(optarg, NULL, 10); break;
+            case 'o': o.json = optarg; break;
+            default: usage();
+        }
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    if(o.server){
+        if(argc - optind != 1) usage();
+        o.port = atoi(argv[optind]);
+        return run_server(o);
+    }
+
+    if(argc - optind != 2 || o.rate <= 0) usage();
+    o.host = argv[optind];
+    o.port = atoi(argv[optind + 1]);
+    if(!o.size && o.cmode != client_mode::HANDSHAKE)
+        o.size = o.cmode == client_mode::ECHO ? 64 : 1 << 20;
+    return run_client(o);
+}
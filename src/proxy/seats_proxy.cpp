@@ -0,0 +1,467 @@
+// seats-proxy: terminates attested TLS and forwards the plaintext to a
+// local backend, so existing services get attestation without linking
+// libseats.
+//
+//   seats-proxy [-m] [-k] [-t loops] <port> <host:port | unix:path>
+//
+// -m uses the mock attester, -k asks for kTLS. Every loop is a thread with
+// its own listening socket (SO_REUSEPORT), attester and epoll instance,
+// handshakes run non-blocking inside the loop. When kTLS is active in both
+// directions payload is moved with splice() through a pipe and never
+// reaches user space, otherwise it goes through SSL_read/SSL_write.
+#include "seats/seats_server_socket.hpp"
+#include "ssl_ext/log.hpp"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace seats;
+
+#define PROXY_BUFFER (64 * 1024)
+#define PROXY_MAX_EVENTS 256
+
+struct backend_addr{
+    struct sockaddr_storage addr;
+    socklen_t len;
+};
+
+// One direction of a connection, bytes wait either in buf or in the pipe
+struct flow{
+    std::unique_ptr<char[]> buf = std::make_unique<char[]>(PROXY_BUFFER);
+    size_t pos = 0;
+    size_t len = 0;
+    int pipe[2] = {-1, -1};
+    size_t piped = 0;
+    // Source finished, done once the destination is shut down too
+    bool src_eof = false;
+    bool done = false;
+
+    bool pending(){ return piped || pos < len; }
+};
+
+struct connection;
+
+// epoll data of either side
+struct side{
+    connection* c;
+    bool backend;
+};
+
+struct connection{
+    side cside{this, false};
+    side bside{this, true};
+    std::unique_ptr<seats_socket> tls;
+    SSL* ssl;
+    int cfd;
+    int bfd = -1;
+    bool established = false;
+    bool splice = false;
+    bool closed = false;
+    // Backend shut down both ways, reads on it no longer block
+    bool bhup = false;
+    // Handshake or record layer blocked on the client socket
+    uint32_t ssl_wants = 0;
+    uint32_t cev = 0;
+    uint32_t bev = 0;
+    // client -> backend and backend -> client
+    flow up;
+    flow down;
+
+    ~connection(){
+        if(bfd >= 0) ::close(bfd);
+        for(int fd : {up.pipe[0], up.pipe[1], down.pipe[0], down.pipe[1]})
+            if(fd >= 0) ::close(fd);
+    }
+};
+
+static void set_nodelay(int fd){
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+static uint32_t ssl_events(SSL* ssl, int ret){
+    switch (SSL_get_error(ssl, ret)) {
+        case SSL_ERROR_WANT_READ: return EPOLLIN;
+        case SSL_ERROR_WANT_WRITE: return EPOLLOUT;
+        default: return 0;
+    }
+}
+
+class proxy_loop{
+public:
+    proxy_loop(uint port, bool mock, bool ktls, const backend_addr& backend):
+        srv(port, mock, true), backend(backend){
+        if(srv.get_status()) return;
+        srv.enable_ktls(ktls);
+        fcntl(srv.get_fd(), F_SETFL, fcntl(srv.get_fd(), F_GETFL) | O_NONBLOCK);
+
+        struct epoll_event ev = {EPOLLIN, {NULL}};
+        epfd = epoll_create1(EPOLL_CLOEXEC);
+        if(epfd < 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, srv.get_fd(), &ev)){
+            seats_log_error("Unable to set up the event loop: %s", strerror(errno));
+            epfd = -1;
+        }
+    }
+
+    ~proxy_loop(){
+        if(epfd >= 0) ::close(epfd);
+    }
+
+    bool ready(){ return !srv.get_status() && epfd >= 0; }
+
+    void run(){
+        struct epoll_event events[PROXY_MAX_EVENTS];
+        std::vector<connection*> dead;
+
+        for(;;){
+            int n = epoll_wait(epfd, events, PROXY_MAX_EVENTS, -1);
+            if(n < 0){
+                if(errno == EINTR) continue;
+                seats_log_error("epoll_wait failed: %s", strerror(errno));
+                return;
+            }
+
+            for(int i = 0; i < n; i++){
+                side* sd = (side*)events[i].data.ptr;
+                uint32_t e = events[i].events;
+                if(!sd){
+                    accept_all();
+                    continue;
+                }
+
+                connection* c = sd->c;
+                if(c->closed) continue;
+                if(e & EPOLLERR || (e & EPOLLHUP && !sd->backend)) drop(c);
+                else{
+                    // HUP is reported whatever the interest is, stop watching
+                    // so the loop does not spin while the client drains
+                    if(e & EPOLLHUP && !(e & EPOLLIN)){
+                        epoll_ctl(epfd, EPOLL_CTL_DEL, c->bfd, NULL);
+                        c->bhup = true;
+                    }
+                    handle(c);
+                }
+                if(c->closed) dead.push_back(c);
+            }
+
+            // Later events of the same batch may still point at them
+            for(connection* c : dead) delete c;
+            dead.clear();
+        }
+    }
+
+private:
+    void accept_all(){
+        seats_socket* s;
+
+        while((s = srv.accept())){
+            if(s->get_status()){
+                delete s;
+                continue;
+            }
+
+            connection* c = new connection();
+            c->tls.reset(s);
+            c->ssl = s->get_ssl_session();
+            c->cfd = s->get_fd();
+            fcntl(c->cfd, F_SETFL, fcntl(c->cfd, F_GETFL) | O_NONBLOCK);
+            set_nodelay(c->cfd);
+            SSL_set_accept_state(c->ssl);
+            SSL_set_mode(c->ssl, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
+            struct epoll_event ev = {0, {&c->cside}};
+            if(epoll_ctl(epfd, EPOLL_CTL_ADD, c->cfd, &ev)){
+                seats_log_error("Unable to watch connection: %s", strerror(errno));
+                delete c;
+                continue;
+            }
+            handle(c);
+            if(c->closed) delete c;
+        }
+    }
+
+    int connect_backend(){
+        int fd = socket(backend.addr.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+        if(fd < 0){
+            seats_log_error("Unable to create backend socket: %s", strerror(errno));
+            return -1;
+        }
+        // The backend is local, the connect does not wait for a round trip
+        if(::connect(fd, (struct sockaddr*)&backend.addr, backend.len)){
+            seats_log_error("Unable to connect to the backend: %s", strerror(errno));
+            ::close(fd);
+            return -1;
+        }
+        if(backend.addr.ss_family != AF_UNIX) set_nodelay(fd);
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        return fd;
+    }
+
+    bool establish(connection* c){
+        struct epoll_event ev = {0, {&c->bside}};
+
+        if((c->bfd = connect_backend()) < 0) return false;
+        if(epoll_ctl(epfd, EPOLL_CTL_ADD, c->bfd, &ev)){
+            seats_log_error("Unable to watch backend: %s", strerror(errno));
+            return false;
+        }
+
+        if(c->tls->ktls_send_active() && c->tls->ktls_recv_active()){
+            c->splice = !pipe2(c->up.pipe, O_NONBLOCK | O_CLOEXEC) && !pipe2(c->down.pipe, O_NONBLOCK | O_CLOEXEC);
+            if(!c->splice) seats_log_warn("No pipes for splice, copying instead: %s", strerror(errno));
+        }
+        c->established = true;
+        seats_log_debug("Connection %d established, splice %d", c->cfd, c->splice);
+        return true;
+    }
+
+    // Plaintext from the client to the backend
+    bool pump_up(connection* c){
+        flow& f = c->up;
+
+        for(;;){
+            while(f.piped){
+                ssize_t n = splice(f.pipe[0], NULL, c->bfd, NULL, f.piped, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+                if(n < 0) return errno == EAGAIN;
+                f.piped -= n;
+            }
+            while(f.pos < f.len){
+                ssize_t n = ::write(c->bfd, f.buf.get() + f.pos, f.len - f.pos);
+                if(n < 0) return errno == EAGAIN || errno == EINTR;
+                f.pos += n;
+            }
+            if(f.src_eof){
+                if(!f.done) shutdown(c->bfd, SHUT_WR);
+                f.done = true;
+                return true;
+            }
+
+            if(c->splice){
+                ssize_t n = splice(c->cfd, NULL, f.pipe[1], NULL, PROXY_BUFFER, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+                if(n > 0){
+                    f.piped = n;
+                    continue;
+                }
+                if(!n){
+                    f.src_eof = true;
+                    continue;
+                }
+                if(errno == EAGAIN) return true;
+                // A non-data record (alert, ticket, key update), the record
+                // layer handles it below
+                if(errno != EIO) return false;
+            }
+
+            size_t n;
+            if(SSL_read_ex(c->ssl, f.buf.get(), PROXY_BUFFER, &n)){
+                f.pos = 0;
+                f.len = n;
+                continue;
+            }
+            if(SSL_get_error(c->ssl, 0) == SSL_ERROR_ZERO_RETURN){
+                f.src_eof = true;
+                continue;
+            }
+            c->ssl_wants |= ssl_events(c->ssl, 0);
+            return ssl_events(c->ssl, 0);
+        }
+    }
+
+    // Backend response to the client
+    bool pump_down(connection* c){
+        flow& f = c->down;
+
+        for(;;){
+            while(f.piped){
+                ssize_t n = splice(f.pipe[0], NULL, c->cfd, NULL, f.piped, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+                if(n < 0) return errno == EAGAIN;
+                f.piped -= n;
+            }
+            while(f.pos < f.len){
+                size_t n;
+                if(!SSL_write_ex(c->ssl, f.buf.get() + f.pos, f.len - f.pos, &n)){
+                    c->ssl_wants |= ssl_events(c->ssl, 0);
+                    return ssl_events(c->ssl, 0);
+                }
+                f.pos += n;
+            }
+            if(f.src_eof){
+                // Best effort close_notify, the peer may be gone already
+                if(!f.done) SSL_shutdown(c->ssl);
+                f.done = true;
+                return true;
+            }
+
+            ssize_t n = c->splice ?
+                splice(c->bfd, NULL, f.pipe[1], NULL, PROXY_BUFFER, SPLICE_F_MOVE | SPLICE_F_NONBLOCK) :
+                ::read(c->bfd, f.buf.get(), PROXY_BUFFER);
+            if(n < 0) return errno == EAGAIN || errno == EINTR;
+            if(!n){
+                f.src_eof = true;
+                continue;
+            }
+            if(c->splice) f.piped = n;
+            else{
+                f.pos = 0;
+                f.len = n;
+            }
+        }
+    }
+
+    void handle(connection* c){
+        c->ssl_wants = 0;
+
+        if(!c->established){
+            int r = SSL_do_handshake(c->ssl);
+            if(r != 1){
+                if(!(c->ssl_wants = ssl_events(c->ssl, r))){
+                    seats_log_warn("Attested handshake failed");
+                    seats_log_ssl_errors();
+                    ERR_clear_error();
+                    drop(c);
+                    return;
+                }
+                watch(c);
+                return;
+            }
+            if(!establish(c)){
+                drop(c);
+                return;
+            }
+        }
+
+        if(!pump_up(c) || !pump_down(c)){
+            ERR_clear_error();
+            drop(c);
+            return;
+        }
+        if(c->up.done && c->down.done){
+            drop(c);
+            return;
+        }
+        watch(c);
+    }
+
+    // Level triggered, a side is read only while the data read before is
+    // written out, which is all the backpressure needed
+    void watch(connection* c){
+        uint32_t cev = c->ssl_wants;
+        uint32_t bev = 0;
+
+        if(c->established){
+            if(!c->up.pending() && !c->up.src_eof) cev |= EPOLLIN;
+            if(c->down.pending()) cev |= EPOLLOUT;
+            if(!c->down.pending() && !c->down.src_eof) bev |= EPOLLIN;
+            if(c->up.pending()) bev |= EPOLLOUT;
+        }
+
+        if(cev != c->cev){
+            struct epoll_event ev = {cev, {&c->cside}};
+            epoll_ctl(epfd, EPOLL_CTL_MOD, c->cfd, &ev);
+            c->cev = cev;
+        }
+        if(c->bfd >= 0 && !c->bhup && bev != c->bev){
+            struct epoll_event ev = {bev, {&c->bside}};
+            epoll_ctl(epfd, EPOLL_CTL_MOD, c->bfd, &ev);
+            c->bev = bev;
+        }
+    }
+
+    void drop(connection* c){
+        if(c->closed) return;
+        c->closed = true;
+        epoll_ctl(epfd, EPOLL_CTL_DEL, c->cfd, NULL);
+        if(c->bfd >= 0 && !c->bhup) epoll_ctl(epfd, EPOLL_CTL_DEL, c->bfd, NULL);
+        // Closes the client socket, the rest goes with the connection
+        c->tls.reset();
+    }
+
+    seats_server_socket srv;
+    backend_addr backend;
+    int epfd = -1;
+};
+
+static bool parse_backend(const char* spec, backend_addr* b){
+    memset(b, 0, sizeof(*b));
+
+    if(!strncmp(spec, "unix:", 5)){
+        struct sockaddr_un* un = (struct sockaddr_un*)&b->addr;
+        if(strlen(spec + 5) >= sizeof(un->sun_path)) return false;
+        un->sun_family = AF_UNIX;
+        strcpy(un->sun_path, spec + 5);
+        b->len = sizeof(*un);
+        return true;
+    }
+
+    const char* colon = strrchr(spec, ':');
+    struct sockaddr_in* in = (struct sockaddr_in*)&b->addr;
+    if(!colon) return false;
+    std::string host(spec, colon - spec);
+    in->sin_family = AF_INET;
+    in->sin_port = htons(atoi(colon + 1));
+    b->len = sizeof(*in);
+    return inet_pton(AF_INET, host.c_str(), &in->sin_addr) == 1;
+}
+
+static void usage(){
+    fprintf(stderr, "Usage: seats-proxy [-m] [-k] [-t loops] <port> <host:port | unix:path>\n");
+    fprintf(stderr, "       -m mock attestation, -k kTLS, -t event loops (default: one per core)\n");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char** argv){
+    bool mock = false;
+    bool ktls = false;
+    unsigned loops = std::thread::hardware_concurrency();
+    backend_addr backend;
+    int opt;
+
+    while((opt = getopt(argc, argv, "mkt:")) != -1){
+        switch (opt) {
+            case 'm': mock = true; break;
+            case 'k': ktls = true; break;
+            case 't': loops = atoi(optarg); break;
+            default: usage();
+        }
+    }
+    if(argc - optind != 2 || !parse_backend(argv[optind + 1], &backend)) usage();
+    if(!loops) loops = 1;
+
+    signal(SIGPIPE, SIG_IGN);
+
+    // Created one after another, the first attester generates the identity key
+    std::vector<std::unique_ptr<proxy_loop>> servers;
+    for(unsigned i = 0; i < loops; i++){
+        servers.emplace_back(new proxy_loop(atoi(argv[optind]), mock, ktls, backend));
+        if(!servers.back()->ready()){
+            seats_log_error("Unable to listen on port %s", argv[optind]);
+            logger::flush();
+            return EXIT_FAILURE;
+        }
+    }
+    seats_log_info("seats-proxy on port %s -> %s, %u loops", argv[optind], argv[optind + 1], loops);
+
+    std::vector<std::thread> threads;
+    for(auto& s : servers)
+        threads.emplace_back(&proxy_loop::run, s.get());
+    for(auto& t : threads)
+        t.join();
+    return EXIT_SUCCESS;
+}